@@ -0,0 +1,94 @@
+#include <benchmark/benchmark.h>
+#include <cdfpp/cdf-io/endianness.hpp>
+#include <cdfpp/no_init_vector.hpp>
+#include <cstdint>
+#include <numeric>
+#include <string>
+
+/*
+ * Byte swap throughput of big endian values decoding, for each instruction set the CPU supports
+ * and for the scalar loop. Small buffers stay in cache, the largest ones show whether decoding
+ * reaches memory bandwidth.
+ */
+
+using cdf::endianness::simd::instruction_set;
+namespace simd = cdf::endianness::simd;
+
+inline constexpr std::size_t kilo(std::size_t n)
+{
+    return n * 1024;
+}
+
+inline constexpr std::size_t mega(std::size_t n)
+{
+    return kilo(n) * 1024;
+}
+
+inline constexpr const char* instruction_set_name(instruction_set isa)
+{
+    switch (isa)
+    {
+        case instruction_set::ssse3:
+            return "ssse3";
+        case instruction_set::avx2:
+            return "avx2";
+        case instruction_set::avx512:
+            return "avx512";
+        default:
+            break;
+    }
+    return "scalar";
+}
+
+template <typename T>
+static void BM_byte_swap(benchmark::State& state, instruction_set isa)
+{
+    const auto size = static_cast<std::size_t>(state.range(0));
+    no_init_vector<T> values(size / sizeof(T));
+    std::iota(std::begin(values), std::end(values), T { 0 });
+    for (auto _ : state)
+    {
+        auto* data = reinterpret_cast<char*>(values.data());
+        const auto swapped = simd::byte_swap<sizeof(T)>(data, std::size(values), isa);
+        for (auto i = swapped; i < std::size(values); i++)
+            values[i] = cdf::endianness::decode<cdf::endianness::big_endian_t, T>(&values[i]);
+        benchmark::DoNotOptimize(values.data());
+        benchmark::ClobberMemory();
+    }
+    state.counters["Bytes"] = static_cast<double>(size);
+    state.counters["Swap Speed"] = benchmark::Counter(static_cast<double>(size),
+        benchmark::Counter::kIsIterationInvariantRate, benchmark::Counter::OneK::kIs1000);
+}
+
+static void buffer_sizes(benchmark::internal::Benchmark* bench)
+{
+    for (auto size = kilo(16); size <= mega(256); size *= 16)
+        bench->Arg(static_cast<int64_t>(size));
+    bench->Unit(benchmark::kMicrosecond);
+}
+
+template <typename T>
+void register_value_type(const std::string& type_name)
+{
+    const auto detected = simd::detected_instruction_set();
+    for (auto isa : { instruction_set::scalar, instruction_set::ssse3, instruction_set::avx2,
+             instruction_set::avx512 })
+    {
+        if (static_cast<int>(isa) > static_cast<int>(detected))
+            break;
+        benchmark::RegisterBenchmark(
+            (std::string { instruction_set_name(isa) } + "/" + type_name).c_str(),
+            BM_byte_swap<T>, isa)
+            ->Apply(buffer_sizes);
+    }
+}
+
+static const bool registered = []()
+{
+    register_value_type<uint16_t>("int16");
+    register_value_type<uint32_t>("float");
+    register_value_type<uint64_t>("double");
+    return true;
+}();
+
+BENCHMARK_MAIN();
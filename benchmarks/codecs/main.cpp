@@ -0,0 +1,239 @@
+#include <benchmark/benchmark.h>
+#include <cdfpp/cdf-io/compression.hpp>
+#include <cdfpp/cdf-io/decompression.hpp>
+#include <cdfpp/no_init_vector.hpp>
+#include <cdfpp_config.h>
+#include <cmath>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <string>
+
+/*
+ * Codec throughput for the payloads we usually find in CDF variables. The gzip backend is chosen
+ * at build time (use_libdeflate option), every benchmark is labeled with it so that results from
+ * a zlib and a libdeflate build can be compared side by side. The largest blocks need about three
+ * times their size in memory (input, compressed and inflated copies).
+ */
+
+using cdf::cdf_compression_type;
+
+inline constexpr std::size_t kilo(std::size_t n)
+{
+    return n * 1024;
+}
+
+inline constexpr std::size_t mega(std::size_t n)
+{
+    return kilo(n) * 1024;
+}
+
+inline constexpr std::size_t giga(std::size_t n)
+{
+    return mega(n) * 1024;
+}
+
+#ifdef CDFpp_USE_LIBDEFLATE
+inline constexpr const char* gzip_backend = "libdeflate";
+#else
+inline constexpr const char* gzip_backend = "zlib";
+#endif
+
+enum class payload_kind
+{
+    smooth_doubles,
+    tt2000_ramp,
+    sparse_flags,
+    strings
+};
+
+template <typename T>
+void fill_values(no_init_vector<char>& data, T (*value)(std::size_t))
+{
+    const auto count = std::size(data) / sizeof(T);
+    for (auto i = 0UL; i < count; i++)
+    {
+        const T v = value(i);
+        std::memcpy(data.data() + i * sizeof(T), &v, sizeof(T));
+    }
+    std::fill(data.data() + count * sizeof(T), data.data() + std::size(data), char { 0 });
+}
+
+// slowly varying physical quantity rounded like most instrument products
+double smooth_double(std::size_t i)
+{
+    return std::round(std::cos(static_cast<double>(i) / 100.) * 1000.) / 1000.;
+}
+
+// 32 samples per second time tags with a small jitter
+int64_t tt2000_sample(std::size_t i)
+{
+    constexpr int64_t start = 631108869184000000;
+    return start + static_cast<int64_t>(i) * 31250000 + static_cast<int64_t>((i * 7919) % 13);
+}
+
+// housekeeping like flags, mostly zero with a few small values
+no_init_vector<char> make_sparse_flags(std::size_t size)
+{
+    no_init_vector<char> data(size);
+    uint32_t state = 1;
+    for (auto& v : data)
+    {
+        state = state * 1664525u + 1013904223u;
+        v = ((state >> 28) < 6) ? static_cast<char>(state >> 20) : char { 0 };
+    }
+    return data;
+}
+
+// fixed width labels padded with spaces, as stored in CDF_CHAR variables
+no_init_vector<char> make_strings(std::size_t size)
+{
+    constexpr std::size_t width = 32;
+    no_init_vector<char> data(size);
+    std::fill(std::begin(data), std::end(data), ' ');
+    char label[width + 1];
+    for (auto offset = 0UL; offset + width <= size; offset += width)
+    {
+        const auto len = std::snprintf(
+            label, sizeof(label), "PSP_FLD_L2_MAG_RTN_%06zu", (offset / width) % 4096);
+        std::memcpy(data.data() + offset, label, static_cast<std::size_t>(len));
+    }
+    return data;
+}
+
+no_init_vector<char> make_payload(payload_kind kind, std::size_t size)
+{
+    switch (kind)
+    {
+        case payload_kind::smooth_doubles:
+        {
+            no_init_vector<char> data(size);
+            fill_values(data, smooth_double);
+            return data;
+        }
+        case payload_kind::tt2000_ramp:
+        {
+            no_init_vector<char> data(size);
+            fill_values(data, tt2000_sample);
+            return data;
+        }
+        case payload_kind::sparse_flags:
+            return make_sparse_flags(size);
+        case payload_kind::strings:
+            return make_strings(size);
+    }
+    return {};
+}
+
+template <cdf_compression_type type>
+constexpr const char* codec_name()
+{
+    if constexpr (type == cdf_compression_type::gzip_compression)
+        return gzip_backend;
+    else
+        return "rle";
+}
+
+void report(benchmark::State& state, const char* speed_name, std::size_t size,
+    std::size_t compressed_size, const char* codec)
+{
+    state.SetLabel(codec);
+    state.counters["Bytes"] = static_cast<double>(size);
+    state.counters["Ratio"] = static_cast<double>(size) / static_cast<double>(compressed_size);
+    state.counters[speed_name] = benchmark::Counter(static_cast<double>(size),
+        benchmark::Counter::kIsIterationInvariantRate, benchmark::Counter::OneK::kIs1000);
+}
+
+template <cdf_compression_type type>
+static void BM_inflate(benchmark::State& state, payload_kind kind)
+{
+    const auto size = static_cast<std::size_t>(state.range(0));
+    const auto compressed = cdf::io::compression::deflate<type>(make_payload(kind, size));
+    no_init_vector<char> output(size);
+    for (auto _ : state)
+    {
+        benchmark::DoNotOptimize(
+            cdf::io::decompression::inflate<type>(compressed, output.data(), size));
+    }
+    report(state, "Inflate Speed", size, std::size(compressed), codec_name<type>());
+}
+
+template <cdf_compression_type type>
+static void BM_deflate(benchmark::State& state, payload_kind kind)
+{
+    const auto size = static_cast<std::size_t>(state.range(0));
+    const auto input = make_payload(kind, size);
+    std::size_t compressed_size = 1;
+    for (auto _ : state)
+    {
+        auto compressed = cdf::io::compression::deflate<type>(input);
+        compressed_size = std::size(compressed);
+        benchmark::DoNotOptimize(compressed);
+    }
+    report(state, "Deflate Speed", size, compressed_size, codec_name<type>());
+}
+
+// small CVVR sized blocks where the per call setup cost dominates, then whole variables
+static void block_sizes(benchmark::internal::Benchmark* bench)
+{
+    for (auto size = kilo(4); size <= kilo(64); size *= 2)
+        bench->Arg(static_cast<int64_t>(size));
+    for (auto size = mega(1); size <= giga(1); size *= 16)
+        bench->Arg(static_cast<int64_t>(size));
+    bench->Arg(static_cast<int64_t>(giga(1)));
+    bench->Unit(benchmark::kMillisecond);
+}
+
+template <cdf_compression_type type>
+void register_codec(const std::string& payload_name, payload_kind kind)
+{
+    const auto prefix = std::string { codec_name<type>() } + "/";
+    benchmark::RegisterBenchmark(
+        (prefix + "inflate/" + payload_name).c_str(), BM_inflate<type>, kind)
+        ->Apply(block_sizes);
+    benchmark::RegisterBenchmark(
+        (prefix + "deflate/" + payload_name).c_str(), BM_deflate<type>, kind)
+        ->Apply(block_sizes);
+}
+
+// level/throughput trade-off of the gzip backend on a whole variable
+static void BM_gzdeflate_level(benchmark::State& state, payload_kind kind)
+{
+    const auto level = static_cast<int>(state.range(0));
+    const auto size = mega(16);
+    const auto input = make_payload(kind, size);
+    std::size_t compressed_size = 1;
+    for (auto _ : state)
+    {
+        auto compressed = cdf::io::compression::gzdeflate(input, level);
+        compressed_size = std::size(compressed);
+        benchmark::DoNotOptimize(compressed);
+    }
+    report(state, "Deflate Speed", size, compressed_size, gzip_backend);
+}
+
+#ifdef CDFpp_USE_LIBDEFLATE
+inline constexpr int gzip_max_level = 12;
+#else
+inline constexpr int gzip_max_level = 9;
+#endif
+
+static const bool registered = []()
+{
+    for (const auto& [name, kind] : { std::pair { "smooth doubles", payload_kind::smooth_doubles },
+             std::pair { "tt2000 ramp", payload_kind::tt2000_ramp },
+             std::pair { "sparse int8 flags", payload_kind::sparse_flags },
+             std::pair { "strings", payload_kind::strings } })
+    {
+        register_codec<cdf_compression_type::gzip_compression>(name, kind);
+        register_codec<cdf_compression_type::rle_compression>(name, kind);
+        benchmark::RegisterBenchmark(
+            (std::string { gzip_backend } + "/deflate level/" + name).c_str(),
+            BM_gzdeflate_level, kind)
+            ->DenseRange(1, gzip_max_level)
+            ->Unit(benchmark::kMillisecond);
+    }
+    return true;
+}();
+
+BENCHMARK_MAIN();
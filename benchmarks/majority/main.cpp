@@ -0,0 +1,91 @@
+#include <benchmark/benchmark.h>
+#include <cdfpp/cdf-io/majority-swap.hpp>
+#include <cdfpp/no_init_vector.hpp>
+#include <cstdint>
+#include <cstring>
+#include <functional>
+#include <numeric>
+#include <string>
+#include <vector>
+
+/*
+ * Column to row major swap of whole variables, the tiled kernels against the flat access
+ * pattern gather they replaced (kept below as reference). Variables are 16MB so both run on a
+ * single thread and only the kernels are compared.
+ */
+
+inline constexpr std::size_t variable_size = 16 * 1024 * 1024;
+
+template <typename T>
+void flat_access_pattern_swap(no_init_vector<T>& data, const std::vector<std::size_t>& shape)
+{
+    const std::vector<std::size_t> record_shape(std::cbegin(shape) + 1, std::cend(shape));
+    const auto access_patern = cdf::_private::generate_access_pattern(record_shape);
+    std::vector<T> temporary_record(std::size(access_patern));
+    for (auto record = 0UL; record < shape[0]; record++)
+    {
+        auto offset = record * std::size(access_patern);
+        for (const auto& swap_pair : access_patern)
+            temporary_record[swap_pair.src] = data[offset + swap_pair.dest];
+        std::memcpy(data.data() + offset, temporary_record.data(),
+            sizeof(T) * std::size(access_patern));
+    }
+}
+
+template <typename T>
+std::vector<std::size_t> variable_shape(const std::vector<std::size_t>& record_shape)
+{
+    const auto record_size = std::accumulate(std::cbegin(record_shape), std::cend(record_shape),
+        std::size_t { 1 }, std::multiplies<std::size_t>());
+    std::vector<std::size_t> shape { variable_size / (record_size * sizeof(T)) };
+    shape.insert(std::end(shape), std::cbegin(record_shape), std::cend(record_shape));
+    return shape;
+}
+
+template <typename T, bool tiled>
+static void BM_swap(benchmark::State& state, std::vector<std::size_t> record_shape)
+{
+    const auto shape = variable_shape<T>(record_shape);
+    no_init_vector<T> values(variable_size / sizeof(T));
+    std::iota(std::begin(values), std::end(values), T { 0 });
+    for (auto _ : state)
+    {
+        if constexpr (tiled)
+            cdf::majority::swap(values, shape);
+        else
+            flat_access_pattern_swap(values, shape);
+        benchmark::DoNotOptimize(values.data());
+        benchmark::ClobberMemory();
+    }
+    state.counters["Swap Speed"] = benchmark::Counter(static_cast<double>(variable_size),
+        benchmark::Counter::kIsIterationInvariantRate, benchmark::Counter::OneK::kIs1000);
+}
+
+template <typename T>
+void register_type(const std::string& type_name)
+{
+    for (const auto& [shape_name, record_shape] :
+        { std::pair { "32x32", std::vector<std::size_t> { 32, 32 } },
+            std::pair { "3x3", std::vector<std::size_t> { 3, 3 } },
+            std::pair { "100x7", std::vector<std::size_t> { 100, 7 } },
+            std::pair { "32x32x16", std::vector<std::size_t> { 32, 32, 16 } },
+            std::pair { "8x8x8x8", std::vector<std::size_t> { 8, 8, 8, 8 } } })
+    {
+        const auto name = type_name + "/" + shape_name;
+        benchmark::RegisterBenchmark(
+            ("flat pattern/" + name).c_str(), BM_swap<T, false>, record_shape)
+            ->Unit(benchmark::kMillisecond);
+        benchmark::RegisterBenchmark(("tiled/" + name).c_str(), BM_swap<T, true>, record_shape)
+            ->Unit(benchmark::kMillisecond);
+    }
+}
+
+static const bool registered = []()
+{
+    register_type<uint16_t>("uint16");
+    register_type<float>("float");
+    register_type<double>("double");
+    return true;
+}();
+
+BENCHMARK_MAIN();
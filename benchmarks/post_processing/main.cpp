@@ -0,0 +1,99 @@
+#include <benchmark/benchmark.h>
+#include <cdfpp/cdf-data.hpp>
+#include <cdfpp/cdf-io/endianness.hpp>
+#include <cdfpp/cdf-io/majority-swap.hpp>
+#include <cdfpp/cdf-io/parallel.hpp>
+#include <cdfpp/no_init_vector.hpp>
+#include <array>
+#include <cstdint>
+#include <numeric>
+#include <thread>
+
+/*
+ * Passes run on the values once they are read: big endian decoding, latin1 to utf8 conversion
+ * and column to row major swap. Buffers below cdf::io::parallel::min_parallel_bytes run on the
+ * calling thread, the bigger ones are split in chunks over all the cores, the per byte speed of
+ * both sides of the threshold shows what the chunked path brings. The 1GB runs need about twice
+ * their size in memory.
+ */
+
+inline constexpr std::size_t mega(std::size_t n)
+{
+    return n * 1024 * 1024;
+}
+
+inline constexpr std::size_t giga(std::size_t n)
+{
+    return mega(n) * 1024;
+}
+
+void report(benchmark::State& state, const char* speed_name, std::size_t size)
+{
+    const bool parallel = size >= cdf::io::parallel::min_parallel_bytes;
+    state.counters["Bytes"] = static_cast<double>(size);
+    state.counters["Threads"]
+        = parallel ? static_cast<double>(std::thread::hardware_concurrency()) : 1.;
+    state.counters[speed_name] = benchmark::Counter(static_cast<double>(size),
+        benchmark::Counter::kIsIterationInvariantRate, benchmark::Counter::OneK::kIs1000);
+}
+
+static void BM_decode_v(benchmark::State& state)
+{
+    const auto size = static_cast<std::size_t>(state.range(0));
+    no_init_vector<double> values(size / sizeof(double));
+    std::iota(std::begin(values), std::end(values), 0.);
+    for (auto _ : state)
+    {
+        cdf::endianness::decode_v<cdf::endianness::big_endian_t>(values.data(), std::size(values));
+        benchmark::DoNotOptimize(values.data());
+        benchmark::ClobberMemory();
+    }
+    report(state, "Decode Speed", size);
+}
+
+static void BM_iso_8859_1_to_utf8(benchmark::State& state)
+{
+    const auto size = static_cast<std::size_t>(state.range(0));
+    no_init_vector<char> latin1(size);
+    // mostly ascii labels with a few accented characters
+    for (auto i = 0UL; i < size; i++)
+        latin1[i] = static_cast<char>((i % 31 == 0) ? 0xe9 : 'a' + i % 26);
+    for (auto _ : state)
+    {
+        benchmark::DoNotOptimize(cdf::iso_8859_1_to_utf8<char>(latin1.data(), size));
+    }
+    report(state, "Conversion Speed", size);
+}
+
+// records of 16x16 doubles, like a spectrogram or a pressure tensor time series
+static void BM_majority_swap(benchmark::State& state)
+{
+    const auto size = static_cast<std::size_t>(state.range(0));
+    const auto records = size / (sizeof(double) * 16 * 16);
+    no_init_vector<double> values(records * 16 * 16);
+    std::iota(std::begin(values), std::end(values), 0.);
+    const auto shape = std::array<std::size_t, 3> { records, 16, 16 };
+    for (auto _ : state)
+    {
+        cdf::majority::swap(values, shape);
+        benchmark::DoNotOptimize(values.data());
+        benchmark::ClobberMemory();
+    }
+    report(state, "Swap Speed", size);
+}
+
+static void buffer_sizes(benchmark::internal::Benchmark* bench)
+{
+    bench->Arg(static_cast<int64_t>(mega(16)));
+    bench->Arg(static_cast<int64_t>(cdf::io::parallel::min_parallel_bytes));
+    bench->Arg(static_cast<int64_t>(mega(256)));
+    bench->Arg(static_cast<int64_t>(giga(1)));
+    bench->Arg(static_cast<int64_t>(giga(2)));
+    bench->Unit(benchmark::kMillisecond);
+}
+
+BENCHMARK(BM_decode_v)->Apply(buffer_sizes);
+BENCHMARK(BM_iso_8859_1_to_utf8)->Apply(buffer_sizes);
+BENCHMARK(BM_majority_swap)->Apply(buffer_sizes);
+
+BENCHMARK_MAIN();
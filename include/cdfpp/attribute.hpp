@@ -31,6 +31,7 @@ namespace cdf
 struct Attribute
 {
     using attr_data_t = std::vector<data_t>;
+    using lazy_attr_data_t = std::vector<lazy_data>;
     using iterator = attr_data_t::iterator;
     using value_type = attr_data_t::value_type;
     using const_iterator = attr_data_t::const_iterator;
@@ -52,12 +53,17 @@ struct Attribute
     Attribute& operator=(const Attribute&) = default;
     Attribute(const std::string& name, attr_data_t&& data) : name { name }
     {
-        this->data = std::move(data);
+        this->p_data = std::move(data);
+    }
+
+    Attribute(const std::string& name, lazy_attr_data_t&& data) : name { name }
+    {
+        this->p_data = std::move(data);
     }
 
     inline bool operator==(const Attribute& other) const
     {
-        return other.name == name && other.data == data;
+        return other.name == name && other._data() == _data();
     }
 
     inline bool operator!=(const Attribute& other) const { return !(*this == other); }
@@ -65,52 +71,76 @@ struct Attribute
     template <CDF_Types type>
     [[nodiscard]] inline decltype(auto) get(std::size_t index)
     {
-        return data[index].get<type>();
+        return _data()[index].get<type>();
     }
 
     template <CDF_Types type>
     [[nodiscard]] inline decltype(auto) get(std::size_t index) const
     {
-        return data[index].get<type>();
+        return _data()[index].get<type>();
     }
 
     template <typename type>
     [[nodiscard]] inline decltype(auto) get(std::size_t index)
     {
-        return data[index].get<type>();
+        return _data()[index].get<type>();
     }
 
     template <typename type>
     [[nodiscard]] inline decltype(auto) get(std::size_t index) const
     {
-        return data[index].get<type>();
+        return _data()[index].get<type>();
     }
 
-    inline void swap(attr_data_t& new_data) { std::swap(data, new_data); }
+    inline void swap(attr_data_t& new_data) { std::swap(_data(), new_data); }
 
     inline Attribute& operator=(attr_data_t& new_data)
     {
-        data = new_data;
+        p_data = new_data;
         return *this;
     }
 
     inline Attribute& operator=(attr_data_t&& new_data)
     {
-        data = new_data;
+        p_data = std::move(new_data);
         return *this;
     }
-    [[nodiscard]] inline std::size_t size() const noexcept { return std::size(data); }
-    [[nodiscard]] inline data_t& operator[](std::size_t index) { return data[index]; }
-    [[nodiscard]] inline const data_t& operator[](std::size_t index) const { return data[index]; }
+    [[nodiscard]] inline std::size_t size() const noexcept
+    {
+        return std::visit([](const auto& entries) { return std::size(entries); }, p_data);
+    }
+    [[nodiscard]] inline data_t& operator[](std::size_t index) { return _data()[index]; }
+    [[nodiscard]] inline const data_t& operator[](std::size_t index) const
+    {
+        return _data()[index];
+    }
 
-    inline void push_back(const data_t& value) { data.push_back(value); }
+    inline void push_back(const data_t& value) { _data().push_back(value); }
 
-    inline void push_back(data_t&& value) { data.push_back(std::move(value)); }
+    inline void push_back(data_t&& value) { _data().push_back(std::move(value)); }
 
     template <class... Args>
     auto emplace_back(Args&&... args)
     {
-        return data.emplace_back(std::forward<Args>(args)...);
+        return _data().emplace_back(std::forward<Args>(args)...);
+    }
+
+    [[nodiscard]] inline bool values_loaded() const noexcept
+    {
+        return std::holds_alternative<attr_data_t>(p_data);
+    }
+
+    inline void load_values() const
+    {
+        if (not values_loaded())
+        {
+            auto& lazy_entries = std::get<lazy_attr_data_t>(p_data);
+            attr_data_t entries;
+            entries.reserve(std::size(lazy_entries));
+            for (auto& entry : lazy_entries)
+                entries.emplace_back(entry.load());
+            p_data = std::move(entries);
+        }
     }
 
     template <typename... Ts>
@@ -119,20 +149,20 @@ struct Attribute
     template <typename... Ts>
     friend void visit(const Attribute& attr, Ts... lambdas);
 
-    [[nodiscard]] inline auto begin() { return data.begin(); }
-    [[nodiscard]] inline auto end() { return data.end(); }
+    [[nodiscard]] inline auto begin() { return _data().begin(); }
+    [[nodiscard]] inline auto end() { return _data().end(); }
 
-    [[nodiscard]] inline auto begin() const { return data.begin(); }
-    [[nodiscard]] inline auto end() const { return data.end(); }
+    [[nodiscard]] inline auto begin() const { return _data().begin(); }
+    [[nodiscard]] inline auto end() const { return _data().end(); }
 
-    [[nodiscard]] inline auto cbegin() const { return data.cbegin(); }
-    [[nodiscard]] inline auto cend() const { return data.cend(); }
+    [[nodiscard]] inline auto cbegin() const { return _data().cbegin(); }
+    [[nodiscard]] inline auto cend() const { return _data().cend(); }
 
-    [[nodiscard]] inline data_t& back() { return data.back(); }
-    [[nodiscard]] inline const data_t& back() const { return data.back(); }
+    [[nodiscard]] inline data_t& back() { return _data().back(); }
+    [[nodiscard]] inline const data_t& back() const { return _data().back(); }
 
-    [[nodiscard]] inline data_t& front() { return data.front(); }
-    [[nodiscard]] inline const data_t& front() const { return data.front(); }
+    [[nodiscard]] inline data_t& front() { return _data().front(); }
+    [[nodiscard]] inline const data_t& front() const { return _data().front(); }
 
     template <class stream_t>
     inline stream_t& __repr__(stream_t& os, indent_t indent = {}) const
@@ -153,19 +183,31 @@ struct Attribute
     }
 
 private:
-    attr_data_t data;
+    [[nodiscard]] attr_data_t& _data()
+    {
+        load_values();
+        return std::get<attr_data_t>(p_data);
+    }
+
+    [[nodiscard]] const attr_data_t& _data() const
+    {
+        load_values();
+        return std::get<attr_data_t>(p_data);
+    }
+
+    mutable std::variant<attr_data_t, lazy_attr_data_t> p_data;
 };
 template <typename... Ts>
 void visit(Attribute& attr, Ts... lambdas)
 {
-    std::for_each(std::cbegin(attr.data), std::cend(attr.data),
+    std::for_each(std::cbegin(attr._data()), std::cend(attr._data()),
         [lambdas...](const auto& element) { visit(element, lambdas...); });
 }
 
 template <typename... Ts>
 void visit(const Attribute& attr, Ts... lambdas)
 {
-    std::for_each(std::cbegin(attr.data), std::cend(attr.data),
+    std::for_each(std::cbegin(attr._data()), std::cend(attr._data()),
         [lambdas...](const auto& element) { visit(element, lambdas...); });
 }
 } // namespace cdf
@@ -24,10 +24,13 @@
 #include "cdf-enums.hpp"
 #include "cdf-helpers.hpp"
 #include "cdf-io/endianness.hpp"
+#include "cdf-io/parallel.hpp"
 #include "no_init_vector.hpp"
 #include <algorithm>
 #include <cstdint>
 #include <functional>
+#include <numeric>
+#include <optional>
 #include <stdint.h>
 #include <string>
 #include <variant>
@@ -115,6 +118,31 @@ private:
     CDF_Types p_type;
 };
 
+// values block as stored in a file, data points to VVR values or to a CVVR compressed payload
+struct raw_data_block
+{
+    std::size_t first_record;
+    std::size_t last_record;
+    bool compressed;
+    const char* data;
+    std::size_t size;
+};
+
+/*
+ * Values of a variable exactly as stored in its source file, blocks are contiguous and cover
+ * every record. Block pointers reference the source buffer, they stay valid as long as the
+ * lazy_data they come from.
+ */
+struct raw_data
+{
+    cdf_encoding encoding;
+    cdf_majority majority;
+    cdf_compression_type compression;
+    // gzip level from the CPR, 0 for other codecs
+    int compression_level;
+    std::vector<raw_data_block> blocks;
+};
+
 struct lazy_data
 {
     lazy_data() = default;
@@ -122,6 +150,13 @@ struct lazy_data
             : p_loader { std::move(loader) }, p_type { type }
     {
     }
+    lazy_data(std::function<data_t(void)>&& loader,
+        std::function<std::optional<raw_data>(void)>&& raw_loader, CDF_Types type)
+            : p_loader { std::move(loader) }
+            , p_raw_loader { std::move(raw_loader) }
+            , p_type { type }
+    {
+    }
     lazy_data(const lazy_data&) = default;
     lazy_data(lazy_data&&) = default;
     lazy_data& operator=(const lazy_data&) = default;
@@ -129,10 +164,19 @@ struct lazy_data
 
     [[nodiscard]] inline data_t load() { return p_loader(); }
 
+    // nullopt when the source values can't be copied as is
+    [[nodiscard]] inline std::optional<raw_data> raw() const
+    {
+        if (p_raw_loader)
+            return p_raw_loader();
+        return std::nullopt;
+    }
+
     [[nodiscard]] inline CDF_Types type() const noexcept { return p_type; }
 
 private:
     std::function<data_t(void)> p_loader;
+    std::function<std::optional<raw_data>(void)> p_raw_loader;
     CDF_Types p_type;
 };
 
@@ -204,10 +248,60 @@ inline data_t& data_t::operator=(const data_t& other)
     return *this;
 }
 
+namespace _private
+{
+    /*
+     * Every byte above 0x7f takes two bytes once converted, so the output offset of each chunk is
+     * known after a first counting pass and the chunks can then be converted independently.
+     */
+    template <typename T>
+    [[nodiscard]] no_init_vector<T> parallel_iso_8859_1_to_utf8(
+        const char* buffer, std::size_t buffer_size)
+    {
+        const auto chunk_size = io::parallel::chunk_bytes;
+        const auto chunks = (buffer_size + chunk_size - 1) / chunk_size;
+        std::vector<std::size_t> offsets(chunks + 1, 0UL);
+        io::parallel::parallel_for(chunks,
+            [&](std::size_t chunk)
+            {
+                const auto begin = reinterpret_cast<const uint8_t*>(buffer) + chunk * chunk_size;
+                const auto end = begin + std::min(chunk_size, buffer_size - chunk * chunk_size);
+                offsets[chunk + 1] = static_cast<std::size_t>(end - begin)
+                    + static_cast<std::size_t>(
+                        std::count_if(begin, end, [](const uint8_t c) { return c >= 0x80; }));
+            });
+        std::partial_sum(std::cbegin(offsets), std::cend(offsets), std::begin(offsets));
+        no_init_vector<T> out(offsets.back());
+        io::parallel::parallel_for(chunks,
+            [&](std::size_t chunk)
+            {
+                const auto begin = reinterpret_cast<const uint8_t*>(buffer) + chunk * chunk_size;
+                const auto end = begin + std::min(chunk_size, buffer_size - chunk * chunk_size);
+                auto output = out.data() + offsets[chunk];
+                std::for_each(begin, end,
+                    [&output](const uint8_t c)
+                    {
+                        if (c < 0x80)
+                        {
+                            *output++ = c;
+                        }
+                        else
+                        {
+                            *output++ = 0xc0 | c >> 6;
+                            *output++ = 0x80 | (c & 0x3f);
+                        }
+                    });
+            });
+        return out;
+    }
+}
+
 // https://stackoverflow.com/questions/4059775/convert-iso-8859-1-strings-to-utf-8-in-c-c
 template <typename T>
 [[nodiscard]] no_init_vector<T> iso_8859_1_to_utf8(const char* buffer, std::size_t buffer_size)
 {
+    if (buffer_size >= io::parallel::min_parallel_bytes)
+        return _private::parallel_iso_8859_1_to_utf8<T>(buffer, buffer_size);
     no_init_vector<T> out;
     out.reserve(buffer_size);
     std::for_each(buffer, buffer + buffer_size,
@@ -292,19 +386,23 @@ template <bool iso_8859_1_to_utf8>
 }
 
 template <CDF_Types type>
-[[nodiscard]] cdf_values_t new_cdf_values_container(std::size_t len)
+[[nodiscard]] cdf_values_t new_cdf_values_container(
+    std::size_t len, const std::shared_ptr<monotonic_arena>& arena = nullptr)
 {
     using raw_type = from_cdf_type_t<type>;
     std::size_t size = len / sizeof(raw_type);
-    return cdf_values_t { no_init_vector<raw_type>(size) };
+    return cdf_values_t { no_init_vector<raw_type>(
+        size, default_init_allocator<raw_type> { arena }) };
 }
 
 
-[[nodiscard]] inline data_t new_data_container(std::size_t bytes_len, CDF_Types type)
+[[nodiscard]] inline data_t new_data_container(
+    std::size_t bytes_len, CDF_Types type, const std::shared_ptr<monotonic_arena>& arena = nullptr)
 {
 #define DC_FROM_T(type)                                                                            \
     case CDF_Types::type:                                                                          \
-        return data_t { new_cdf_values_container<CDF_Types::type>(bytes_len), CDF_Types::type };
+        return data_t { new_cdf_values_container<CDF_Types::type>(bytes_len, arena),               \
+            CDF_Types::type };
 
     switch (type)
     {
@@ -55,6 +55,14 @@ enum class cdf_majority
     return "Unknown";
 }
 
+// order of the records in saved files, metadata_first keeps every descriptor record ahead of
+// the values records so that opening a file only touches its first bytes
+enum class cdf_layout
+{
+    interleaved = 0,
+    metadata_first = 1
+};
+
 
 enum class cdf_record_type : int32_t
 {
@@ -85,6 +93,8 @@ enum class cdf_attr_scope : int32_t
 
 enum class cdf_compression_type : int32_t
 {
+    // resolved to one of the others when saving, per variable or once for the whole file
+    auto_compression = -1,
     no_compression = 0,
     rle_compression = 1,
     huff_compression = 2,
@@ -96,6 +106,9 @@ enum class cdf_compression_type : int32_t
 {
     switch (type)
     {
+        case cdf_compression_type::auto_compression:
+            return "Automatic";
+            break;
         case cdf_compression_type::no_compression:
             return "None";
             break;
@@ -117,6 +130,25 @@ enum class cdf_compression_type : int32_t
     return "Unknown";
 }
 
+/*
+ * gzip compression levels, from 0 (stored) and 1 (fastest) to 9 for zlib and 12 for libdeflate.
+ * Levels above what the backend supports are clamped.
+ */
+inline constexpr int default_compression_level = 6;
+inline constexpr int max_compression_level = 12;
+
+/*
+ * Trade-off used to resolve automatic compression: a codec is only used when it saves at least
+ * min_saving of the size while compressing at min_throughput bytes per second or more. Among
+ * those, the fastest one whose saving is within saving_tolerance of the best is picked.
+ */
+struct compression_objective
+{
+    double min_saving = 0.1;
+    double min_throughput = 0.;
+    double saving_tolerance = 0.05;
+};
+
 enum class cdf_encoding : int32_t
 {
     network = 1,
@@ -27,6 +27,7 @@
 #include "chrono/cdf-leap-seconds.h"
 #include "variable.hpp"
 
+#include <memory>
 #include <string>
 
 template <class stream_t>
@@ -42,11 +43,22 @@ struct CDF
 {
     cdf_majority majority = cdf_majority::row;
     cdf_compression_type compression = cdf_compression_type::no_compression;
+    // used for the whole file and for variables without their own level
+    int compression_level = default_compression_level;
+    // used to resolve variables set to auto_compression
+    cdf::compression_objective compression_objective {};
+    // default VVR/CVVR chunking for variables without their own chunk size
+    chunk_size_t chunk_size {};
+    // record ordering used on save, doesn't change the file content
+    cdf_layout layout = cdf_layout::interleaved;
     std::tuple<uint32_t, uint32_t, uint32_t> distribution_version = { 3, 9, 0 };
     cdf_map<std::string, Variable> variables;
     cdf_map<std::string, Attribute> attributes;
     uint32_t leap_second_last_updated = chrono::leap_seconds::last_updated;
     bool lazy_loaded = false;
+    // backs small values (attributes, shapes, small variables) loaded from a file, shared with
+    // the values and lazy loaders taken from it, copies are allocated from the heap
+    std::shared_ptr<monotonic_arena> arena;
 
     CDF() = default;
     CDF(const CDF&) = default;
@@ -22,3 +22,8 @@
 ----------------------------------------------------------------------------*/
 #include "loading/loading.hpp"
 #include "saving/saving.hpp"
+#include "saving/stream_writer.hpp"
+#include "editing/update.hpp"
+#include "editing/append.hpp"
+#include "editing/metadata.hpp"
+#include "editing/optimize.hpp"
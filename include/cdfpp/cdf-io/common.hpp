@@ -28,6 +28,7 @@
 #include "cdfpp/variable.hpp"
 #include <assert.h>
 #include <functional>
+#include <memory>
 #include <tuple>
 #include <type_traits>
 #include <vector>
@@ -114,26 +115,33 @@ struct cdf_repr
     cdf_majority majority;
     cdf_compression_type compression_type;
     bool lazy;
-    cdf_repr(std::size_t var_count) : var_attributes(var_count) { }
+    std::shared_ptr<monotonic_arena> arena;
+    cdf_repr(std::size_t var_count)
+            : var_attributes(var_count), arena { std::make_shared<monotonic_arena>() }
+    {
+    }
     cdf_repr(cdf_repr&&) = default;
     cdf_repr(const cdf_repr&) = delete;
     cdf_repr& operator=(const cdf_repr&) = delete;
     cdf_repr& operator=(cdf_repr&&) = default;
 };
 
-void add_global_attribute(cdf_repr& repr, const std::string& name, Attribute::attr_data_t&& data)
+template <typename entry_t>
+void add_global_attribute(
+    cdf_repr& repr, const std::string& name, std::vector<entry_t>&& data)
 {
     repr.attributes[name] = Attribute { name, std::move(data) };
 }
 
+template <typename entry_t>
 void add_var_attribute(cdf_repr& repr, const std::vector<uint32_t>& variable_indexes,
-    const std::string& name, Attribute::attr_data_t&& data)
+    const std::string& name, std::vector<entry_t>&& data)
 {
     assert(std::size(data) == std::size(variable_indexes));
-    cdf_map<uint32_t, cdf_map<std::string, Attribute::attr_data_t>> storage;
+    cdf_map<uint32_t, cdf_map<std::string, std::vector<entry_t>>> storage;
     for (auto index = 0UL; index < std::size(data); index++)
     {
-        storage[variable_indexes[index]][name].push_back(data[index]);
+        storage[variable_indexes[index]][name].push_back(std::move(data[index]));
     }
     for (auto& [v_index, attr] : storage)
     {
@@ -144,8 +152,9 @@ void add_var_attribute(cdf_repr& repr, const std::vector<uint32_t>& variable_ind
     }
 }
 
+template <typename entry_t>
 void add_attribute(cdf_repr& repr, cdf_attr_scope scope, const std::string& name,
-    Attribute::attr_data_t&& data, const std::vector<uint32_t>& variable_indexes)
+    std::vector<entry_t>&& data, const std::vector<uint32_t>& variable_indexes)
 {
     if (scope == cdf_attr_scope::global || scope == cdf_attr_scope::global_assumed)
         add_global_attribute(repr, name, std::move(data));
@@ -0,0 +1,200 @@
+#pragma once
+/*------------------------------------------------------------------------------
+-- This file is a part of the CDFpp library
+-- Copyright (C) 2022, Plasma Physics Laboratory - CNRS
+--
+-- This program is free software; you can redistribute it and/or modify
+-- it under the terms of the GNU General Public License as published by
+-- the Free Software Foundation; either version 2 of the License, or
+-- (at your option) any later version.
+--
+-- This program is distributed in the hope that it will be useful,
+-- but WITHOUT ANY WARRANTY; without even the implied warranty of
+-- MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+-- GNU General Public License for more details.
+--
+-- You should have received a copy of the GNU General Public License
+-- along with this program; if not, write to the Free Software
+-- Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA 02111-1307 USA
+-------------------------------------------------------------------------------*/
+/*-- Author : Alexis Jeandet
+-- Mail : alexis.jeandet@member.fsf.org
+----------------------------------------------------------------------------*/
+#include "./compression.hpp"
+#include "cdfpp/cdf-enums.hpp"
+#include "cdfpp/cdf-file.hpp"
+#include "cdfpp/variable.hpp"
+#include <algorithm>
+#include <array>
+#include <chrono>
+#include <string>
+#include <string_view>
+#include <utility>
+#include <vector>
+
+namespace cdf::io
+{
+
+struct compression_decision
+{
+    std::string variable;
+    cdf_compression_type type;
+    // estimated uncompressed/compressed size ratio and compression speed in bytes per second
+    double ratio;
+    double throughput;
+};
+
+namespace _internal
+{
+    inline constexpr std::size_t sample_block_size = 1 << 16;
+    inline constexpr std::size_t sample_blocks_count = 4;
+
+    struct codec_estimate
+    {
+        cdf_compression_type type;
+        double ratio;
+        double throughput;
+
+        [[nodiscard]] double saving() const noexcept { return 1. - 1. / ratio; }
+    };
+
+    // a few blocks evenly spread over the values, the whole values when they are small
+    [[nodiscard]] inline std::vector<std::string_view> sample_blocks(
+        const char* data, std::size_t size)
+    {
+        std::vector<std::string_view> blocks;
+        if (size <= sample_block_size * sample_blocks_count)
+        {
+            blocks.emplace_back(data, size);
+        }
+        else
+        {
+            const auto stride = (size - sample_block_size) / (sample_blocks_count - 1);
+            for (auto i = 0UL; i < sample_blocks_count; i++)
+                blocks.emplace_back(data + i * stride, sample_block_size);
+        }
+        return blocks;
+    }
+
+    [[nodiscard]] inline codec_estimate estimate(
+        cdf_compression_type type, const std::vector<std::string_view>& blocks, int level)
+    {
+        std::size_t input_size = 0UL;
+        std::size_t output_size = 0UL;
+        const auto start = std::chrono::steady_clock::now();
+        for (const auto& block : blocks)
+        {
+            input_size += std::size(block);
+            output_size += std::size(compression::deflate(type, block, level));
+        }
+        const std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+        return { type,
+            static_cast<double>(input_size) / static_cast<double>(std::max(output_size, 1UL)),
+            static_cast<double>(input_size) / std::max(elapsed.count(), 1e-9) };
+    }
+
+    // the fastest codec fitting the objective, no compression when none does
+    [[nodiscard]] inline compression_decision pick(std::string name,
+        const std::vector<std::string_view>& blocks, int level,
+        const compression_objective& objective)
+    {
+        compression_decision decision { std::move(name), cdf_compression_type::no_compression,
+            1., 0. };
+        if (std::empty(blocks))
+            return decision;
+        // ordered from the fastest to the slowest codec
+        const std::array<codec_estimate, 2> estimates {
+            estimate(cdf_compression_type::rle_compression, blocks, level),
+            estimate(cdf_compression_type::gzip_compression, blocks, level)
+        };
+        double best_saving = 0.;
+        for (const auto& estimate : estimates)
+        {
+            if (estimate.saving() >= objective.min_saving
+                and estimate.throughput >= objective.min_throughput)
+                best_saving = std::max(best_saving, estimate.saving());
+        }
+        for (const auto& estimate : estimates)
+        {
+            if (estimate.saving() >= objective.min_saving
+                and estimate.throughput >= objective.min_throughput
+                and estimate.saving() >= best_saving - objective.saving_tolerance)
+            {
+                decision.type = estimate.type;
+                decision.ratio = estimate.ratio;
+                decision.throughput = estimate.throughput;
+                break;
+            }
+        }
+        return decision;
+    }
+}
+
+/*
+ * Samples the variable values and picks the codec fitting the objective, see
+ * compression_objective. Throughput is measured on this machine, so close calls may resolve
+ * differently from one run to another; use resolve_compression to pin the decisions.
+ */
+[[nodiscard]] inline compression_decision choose_compression(
+    const Variable& variable, int level, const compression_objective& objective)
+{
+    if (variable.bytes() == 0UL)
+        return _internal::pick(variable.name(), {}, level, objective);
+    return _internal::pick(variable.name(),
+        _internal::sample_blocks(variable.bytes_ptr(), variable.bytes()), level, objective);
+}
+
+/*
+ * Same as above for a whole file compression, the values dominate the file size so one block is
+ * sampled from the middle of each of the sample_blocks_count largest variables.
+ */
+[[nodiscard]] inline compression_decision choose_compression(const CDF& cdf)
+{
+    std::vector<const Variable*> variables;
+    for (const auto& [name, variable] : cdf.variables)
+        variables.push_back(&variable);
+    const auto largest = std::min(std::size(variables), _internal::sample_blocks_count);
+    std::partial_sort(std::begin(variables), std::begin(variables) + largest, std::end(variables),
+        [](const Variable* left, const Variable* right) { return left->bytes() > right->bytes(); });
+    std::vector<std::string_view> blocks;
+    for (auto i = 0UL; i < largest; i++)
+    {
+        const auto size = variables[i]->bytes();
+        if (size == 0UL)
+            break;
+        const auto block_size = std::min(size, _internal::sample_block_size);
+        blocks.emplace_back(variables[i]->bytes_ptr() + (size - block_size) / 2, block_size);
+    }
+    return _internal::pick({}, blocks, cdf.compression_level, cdf.compression_objective);
+}
+
+// the variable level falls back to the file one, like when saving
+[[nodiscard]] inline compression_decision choose_compression(
+    const CDF& cdf, const Variable& variable)
+{
+    return choose_compression(variable, variable.compression_level().value_or(cdf.compression_level),
+        cdf.compression_objective);
+}
+
+/*
+ * Replaces automatic compression with the chosen codec on the file and on every variable and
+ * reports the decisions taken, the file one has an empty variable name. Other settings are left
+ * untouched.
+ */
+inline std::vector<compression_decision> resolve_compression(CDF& cdf)
+{
+    std::vector<compression_decision> decisions;
+    if (cdf.compression == cdf_compression_type::auto_compression)
+        cdf.compression = decisions.emplace_back(choose_compression(cdf)).type;
+    for (auto& [name, variable] : cdf.variables)
+    {
+        if (variable.compression_type() == cdf_compression_type::auto_compression)
+        {
+            variable.set_compression_type(
+                decisions.emplace_back(choose_compression(cdf, variable)).type);
+        }
+    }
+    return decisions;
+}
+
+}
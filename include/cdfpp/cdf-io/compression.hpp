@@ -40,30 +40,31 @@ inline no_init_vector<char> rledeflate(const T& input)
 }
 
 template <typename T>
-no_init_vector<char> gzdeflate(const T& input)
+no_init_vector<char> gzdeflate(const T& input, int level = default_compression_level)
 {
 #ifdef CDFpp_USE_LIBDEFLATE
-    return libdeflate::gzdeflate(input);
+    return libdeflate::gzdeflate(input, level);
 #else
-    return zlib::gzdeflate(input);
+    return zlib::gzdeflate(input, level);
 #endif
 }
 
+// level only applies to gzip, RLE has no tuning knob
 template <cdf_compression_type type, typename T>
-no_init_vector<char> deflate(const T& input)
+no_init_vector<char> deflate(const T& input, int level = default_compression_level)
 {
     if constexpr (type == cdf_compression_type::gzip_compression)
-        return gzdeflate(input);
+        return gzdeflate(input, level);
     if constexpr (type == cdf_compression_type::rle_compression)
         return rledeflate(input);
 }
 
 template <typename T>
 no_init_vector<char> deflate(
-    cdf_compression_type type, const T& input)
+    cdf_compression_type type, const T& input, int level = default_compression_level)
 {
     if (type == cdf_compression_type::gzip_compression)
-        return gzdeflate(input);
+        return gzdeflate(input, level);
     if (type == cdf_compression_type::rle_compression)
         return rledeflate(input);
     return {};
@@ -243,14 +243,18 @@ struct cdf_rVDR_t
     cdf_string_field_t<version_t, 256, 64> Name;
 
     table_field<int32_t, 0> DimVarys;
-    table_field<int32_t, 1> PadValues;
+    // one value in the file encoding, only present when bit 1 of Flags is set
+    table_field<char, 1> PadValues;
 
     std::size_t size(const table_field<int32_t, 0>&, int32_t rNumDims = 0) const
     {
         return rNumDims * sizeof(int32_t);
     }
 
-    std::size_t size(const table_field<int32_t, 1>&) const { return 0; }
+    std::size_t size(const table_field<char, 1>&) const
+    {
+        return (Flags & 2) ? static_cast<std::size_t>(NumElems) * cdf_type_size(DataType) : 0;
+    }
 };
 
 template <typename version_t>
@@ -277,7 +281,8 @@ struct cdf_zVDR_t
     int32_t zNumDims;
     table_field<int32_t, 0> zDimSizes;
     table_field<int32_t, 1> DimVarys;
-    table_field<int32_t, 2> PadValues;
+    // one value in the file encoding, only present when bit 1 of Flags is set
+    table_field<char, 2> PadValues;
 
     std::size_t size(const table_field<int32_t, 0>&) const
     {
@@ -288,7 +293,10 @@ struct cdf_zVDR_t
         return this->zNumDims * sizeof(int32_t);
     }
 
-    std::size_t size(const table_field<int32_t, 2>&) const { return 0; }
+    std::size_t size(const table_field<char, 2>&) const
+    {
+        return (Flags & 2) ? static_cast<std::size_t>(NumElems) * cdf_type_size(DataType) : 0;
+    }
 };
 
 template <cdf_r_z type, typename version_t>
@@ -335,7 +343,8 @@ struct cdf_VVR_t
     }
 };
 
-template <typename version_t>
+// compressed records payloads can either be owned (saving) or viewed from the file (loading)
+template <typename version_t, template <typename, std::size_t> typename payload_field_t = table_field>
 struct cdf_CVVR_t
 {
     using cdf_version_t = version_t;
@@ -343,11 +352,11 @@ struct cdf_CVVR_t
     cdf_DR_header<version_t, cdf_record_type::CVVR> header;
     uint32_t rfuA;
     cdf_offset_field_t<version_t> cSize;
-    table_field<char, 0> data;
-    std::size_t size(const table_field<char, 0>&) const { return this->cSize; }
+    payload_field_t<char, 0> data;
+    std::size_t size(const payload_field_t<char, 0>&) const { return this->cSize; }
 };
 
-template <typename version_t>
+template <typename version_t, template <typename, std::size_t> typename payload_field_t = table_field>
 struct cdf_CCR_t
 {
     using cdf_version_t = version_t;
@@ -356,8 +365,8 @@ struct cdf_CCR_t
     cdf_offset_field_t<version_t> CPRoffset;
     cdf_offset_field_t<version_t> uSize;
     uint32_t rfuA;
-    table_field<char, 0> data;
-    std::size_t size(const table_field<char, 0>&) const
+    payload_field_t<char, 0> data;
+    std::size_t size(const payload_field_t<char, 0>&) const
     {
         return this->header.record_size - sizeof(header.record_size) - sizeof(header.record_type)
             - sizeof(CPRoffset) - sizeof(uSize) - sizeof(rfuA);
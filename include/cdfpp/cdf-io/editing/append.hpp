@@ -0,0 +1,187 @@
+#pragma once
+/*------------------------------------------------------------------------------
+-- This file is a part of the CDFpp library
+-- Copyright (C) 2022, Plasma Physics Laboratory - CNRS
+--
+-- This program is free software; you can redistribute it and/or modify
+-- it under the terms of the GNU General Public License as published by
+-- the Free Software Foundation; either version 2 of the License, or
+-- (at your option) any later version.
+--
+-- This program is distributed in the hope that it will be useful,
+-- but WITHOUT ANY WARRANTY; without even the implied warranty of
+-- MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+-- GNU General Public License for more details.
+--
+-- You should have received a copy of the GNU General Public License
+-- along with this program; if not, write to the Free Software
+-- Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA 02111-1307 USA
+-------------------------------------------------------------------------------*/
+/*-- Author : Alexis Jeandet
+-- Mail : alexis.jeandet@member.fsf.org
+----------------------------------------------------------------------------*/
+
+#include "../desc-records.hpp"
+#include "../saving/buffers.hpp"
+#include "../saving/create_records.hpp"
+#include "../saving/records-appending.hpp"
+#include "../saving/saving.hpp"
+#include "./records-editing.hpp"
+#include "cdfpp/cdf-data.hpp"
+#include "cdfpp/cdf-enums.hpp"
+#include <algorithm>
+#include <stdexcept>
+#include <string>
+#include <type_traits>
+#include <variant>
+
+namespace cdf::io
+{
+
+namespace editing
+{
+    /*
+     * The CDF library preallocates records in the last VVR of a variable, the records between
+     * MaxRec and the end of that block must be filled before any new block is written.
+     */
+    template <typename vdr_t>
+    struct appending_target
+    {
+        saving::appending_context<vdr_t> appending;
+        std::size_t preallocated_offset;
+        std::size_t preallocated_records;
+    };
+
+    template <typename vdr_t>
+    [[nodiscard]] inline appending_target<vdr_t> make_appending_target(
+        editing_context_t& context, std::size_t vdr_offset, const vdr_t& vdr,
+        std::size_t record_size)
+    {
+        const auto records = static_cast<std::size_t>(vdr.MaxRec + 1);
+        appending_target<vdr_t> target { { cdf_compression_type::no_compression,
+                                             default_compression_level, record_size, 0UL, records,
+                                             record_wrapper<vdr_t> { vdr_t { vdr } },
+                                             record_wrapper<cdf_VXR_t<v3x_tag>> {
+                                                 cdf_VXR_t<v3x_tag> { {}, 0, 0, 0, {}, {}, {} } } },
+            0UL, 0UL };
+        auto& appending = target.appending;
+        appending.vdr.offset = vdr_offset;
+        appending.vdr.size = vdr.header.record_size;
+        if (common::is_compressed(vdr))
+        {
+            cdf_CPR_t<v3x_tag> cpr;
+            load_record(cpr, context, vdr.CPRorSPRoffset);
+            appending.compression = cpr.cType;
+            if (cpr.pCount != 0)
+                appending.compression_level = static_cast<int>(cpr.cParms.values[0]);
+        }
+        // same 1GB limit as when saving, the blocking factor is honored when set
+        const auto max_records = std::max(std::size_t { 1 }, (std::size_t { 1 } << 30) / record_size);
+        appending.records_per_values_record = (vdr.BlockingFactor > 0)
+            ? std::min(max_records, static_cast<std::size_t>(vdr.BlockingFactor))
+            : max_records;
+        // only the tail of the top level VXR chain gets new entries, a VXR less variable gets one
+        if (vdr.VXRhead != 0)
+        {
+            auto& vxr = appending.vxr;
+            load_record(vxr.record, context, vdr.VXRtail);
+            vxr.offset = vdr.VXRtail;
+            vxr.size = vxr.record.header.record_size;
+            if (vxr.record.NusedEntries != 0
+                and vxr.record.Last.values[vxr.record.NusedEntries - 1] >= records)
+            {
+                const auto block = last_values_block(context, vdr.VXRtail);
+                if (not block or block->first_record > records
+                    or block->last_record != vxr.record.Last.values[vxr.record.NusedEntries - 1])
+                    throw std::invalid_argument { "Unsupported preallocated records layout" };
+                target.preallocated_offset
+                    = block->data_offset + (records - block->first_record) * record_size;
+                target.preallocated_records = block->last_record + 1 - records;
+            }
+        }
+        return target;
+    }
+} // namespace
+
+/*
+ * Appends records to a record varying variable of an existing file, the new values records are
+ * written at the end of the file and indexed in the last VXR of the variable, or in a new VXR
+ * chained to it when full. Only the new data, the VDR, the tail VXRs and the GDR are written so
+ * the cost doesn't depend on the file size. values must have the variable type and hold whole
+ * records. Returns false when the file can't be edited in place or the writes fail, invalid
+ * requests throw.
+ */
+[[nodiscard]] inline bool append_records(
+    const std::string& path, const std::string& name, const data_t& values)
+{
+    std::variant<std::monostate, editing::appending_target<cdf_rVDR_t<v3x_tag>>,
+        editing::appending_target<cdf_zVDR_t<v3x_tag>>>
+        target;
+    data_t encoded;
+    std::size_t records = 0UL;
+    record_wrapper<cdf_GDR_t<v3x_tag>> gdr;
+    {
+        auto context = editing::open_for_edition(path);
+        if (not context)
+            return false;
+        const bool found = editing::visit_variable(*context, name,
+            [&](std::size_t offset, const auto& vdr, const auto& record_shape)
+            {
+                if (common::is_nrv(vdr))
+                    throw std::invalid_argument { "Can't append records to NRV variable: " + name };
+                if (vdr.DataType != values.type())
+                    throw std::invalid_argument { "Type mismatch while appending to variable: "
+                        + name };
+                const auto record_size = variable::var_record_size(record_shape, vdr.DataType);
+                if (values.bytes() % record_size != 0)
+                    throw std::invalid_argument { "Appending a partial record to variable: "
+                        + name };
+                records = values.bytes() / record_size;
+                encoded = editing::encode_values(values, *context, record_shape, records);
+                target = editing::make_appending_target(*context, offset, vdr, record_size);
+            });
+        if (not found)
+            throw std::invalid_argument { "Unknown variable: " + name };
+        gdr.record = context->gdr;
+        gdr.offset = context->cdr.GDRoffset;
+    }
+    if (records == 0)
+        return true;
+    buffers::file_writer writer { path, buffers::file_writer::open_mode::update };
+    if (not writer.is_open())
+        return false;
+    std::visit(
+        [&](auto& target)
+        {
+            if constexpr (not std::is_same_v<std::decay_t<decltype(target)>, std::monostate>)
+            {
+                auto& appending = target.appending;
+                const auto preallocated = std::min(records, target.preallocated_records);
+                if (preallocated != 0)
+                    writer.write_at(target.preallocated_offset, encoded.bytes_ptr(),
+                        preallocated * appending.record_size);
+                appending.records += preallocated;
+                appending.vdr.record.MaxRec = static_cast<int32_t>(appending.records) - 1;
+                saving::append_records(appending,
+                    encoded.bytes_ptr() + preallocated * appending.record_size,
+                    records - preallocated, writer);
+                if (appending.vxr.offset != 0)
+                    saving::rewrite_record(appending.vxr.record, appending.vxr.offset, writer);
+                saving::rewrite_record(appending.vdr.record, appending.vdr.offset, writer);
+                if constexpr (std::is_same_v<std::decay_t<decltype(appending.vdr.record)>,
+                                  cdf_rVDR_t<v3x_tag>>)
+                {
+                    gdr.record.rMaxRec = static_cast<uint32_t>(std::max(
+                        static_cast<int32_t>(gdr.record.rMaxRec), appending.vdr.record.MaxRec));
+                }
+            }
+        },
+        target);
+    gdr.record.eof = writer.offset();
+    saving::rewrite_record(gdr.record, gdr.offset, writer);
+    const bool written = writer.flush();
+    writer.close();
+    return written;
+}
+
+}
@@ -0,0 +1,446 @@
+#pragma once
+/*------------------------------------------------------------------------------
+-- This file is a part of the CDFpp library
+-- Copyright (C) 2022, Plasma Physics Laboratory - CNRS
+--
+-- This program is free software; you can redistribute it and/or modify
+-- it under the terms of the GNU General Public License as published by
+-- the Free Software Foundation; either version 2 of the License, or
+-- (at your option) any later version.
+--
+-- This program is distributed in the hope that it will be useful,
+-- but WITHOUT ANY WARRANTY; without even the implied warranty of
+-- MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+-- GNU General Public License for more details.
+--
+-- You should have received a copy of the GNU General Public License
+-- along with this program; if not, write to the Free Software
+-- Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA 02111-1307 USA
+-------------------------------------------------------------------------------*/
+/*-- Author : Alexis Jeandet
+-- Mail : alexis.jeandet@member.fsf.org
+----------------------------------------------------------------------------*/
+
+#include "../desc-records.hpp"
+#include "../loading/records-loading.hpp"
+#include "../saving/buffers.hpp"
+#include "../saving/create_records.hpp"
+#include "../saving/records-saving.hpp"
+#include "../saving/saving.hpp"
+#include "./records-editing.hpp"
+#include "cdfpp/cdf-data.hpp"
+#include "cdfpp/cdf-enums.hpp"
+#include <algorithm>
+#include <stdexcept>
+#include <string>
+#include <utility>
+#include <vector>
+
+namespace cdf::io
+{
+
+/*
+ * Edits the metadata of an uncompressed v3 file without rewriting it. Records are patched in
+ * place and chains relinked, new or grown records are written at the end of the file and the
+ * space used by the records they replace is left unreferenced. Every edit is written right away,
+ * the file must not be modified by anyone else until the editor is closed. Write errors are only
+ * reported by close() and good(), the destructor closes the file without reporting them.
+ */
+class metadata_editor
+{
+    template <typename aedr_t>
+    using entries_t = std::vector<record_wrapper<aedr_t>>;
+    using rvdrs_t = std::vector<record_wrapper<cdf_rVDR_t<v3x_tag>>>;
+    using zvdrs_t = std::vector<record_wrapper<cdf_zVDR_t<v3x_tag>>>;
+
+    struct attribute_records
+    {
+        record_wrapper<cdf_ADR_t<v3x_tag>> adr;
+        entries_t<cdf_AgrEDR_t<v3x_tag>> gr_entries;
+        entries_t<cdf_AzEDR_t<v3x_tag>> z_entries;
+    };
+
+    // chains are kept in file order
+    struct metadata_records
+    {
+        cdf_encoding encoding;
+        record_wrapper<cdf_GDR_t<v3x_tag>> gdr;
+        rvdrs_t rvdrs;
+        zvdrs_t zvdrs;
+        std::vector<attribute_records> attributes;
+    };
+
+    static constexpr std::size_t max_name_length = decltype(cdf_ADR_t<v3x_tag>::Name)::max_len;
+
+    metadata_records p_records;
+    buffers::file_writer p_writer;
+
+    template <typename T>
+    [[nodiscard]] static record_wrapper<T> located(const T& record, std::size_t offset)
+    {
+        record_wrapper<T> wrapper { T { record } };
+        wrapper.offset = offset;
+        wrapper.size = record.header.record_size;
+        return wrapper;
+    }
+
+    [[nodiscard]] static metadata_records read_metadata(const std::string& path)
+    {
+        auto context = editing::open_for_edition(path);
+        if (not context)
+            throw std::runtime_error { "Can't edit in place: " + path };
+        metadata_records records { context->cdr.Encoding,
+            located(context->gdr, static_cast<std::size_t>(context->cdr.GDRoffset)), {}, {}, {} };
+        std::for_each(begin_VDR<cdf_r_z::r>(*context), end_VDR<cdf_r_z::r>(*context),
+            [&records](const auto& blk)
+            { records.rvdrs.push_back(located(blk.second, blk.first)); });
+        std::for_each(begin_VDR<cdf_r_z::z>(*context), end_VDR<cdf_r_z::z>(*context),
+            [&records](const auto& blk)
+            { records.zvdrs.push_back(located(blk.second, blk.first)); });
+        std::for_each(begin_ADR(*context), end_ADR(*context),
+            [&records, &context](const auto& adr_blk)
+            {
+                auto& attribute = records.attributes.emplace_back(
+                    attribute_records { located(adr_blk.second, adr_blk.first), {}, {} });
+                const auto& adr = adr_blk.second;
+                std::for_each(begin_AgrEDR(adr, *context), end_AgrEDR(adr, *context),
+                    [&attribute](const auto& blk)
+                    { attribute.gr_entries.push_back(located(blk.second, blk.first)); });
+                std::for_each(begin_AzEDR(adr, *context), end_AzEDR(adr, *context),
+                    [&attribute](const auto& blk)
+                    { attribute.z_entries.push_back(located(blk.second, blk.first)); });
+            });
+        return records;
+    }
+
+    // the mapping is released before the file gets opened for writing
+    metadata_editor(metadata_records&& records, const std::string& path)
+            : p_records { std::move(records) }
+            , p_writer { path, buffers::file_writer::open_mode::update }
+    {
+        if (not p_writer.is_open())
+            throw std::runtime_error { "Failed to open " + path };
+    }
+
+    template <typename T>
+    void rewrite(const record_wrapper<T>& r)
+    {
+        saving::rewrite_record(r.record, r.offset, p_writer);
+    }
+
+    void update_eof()
+    {
+        p_records.gdr.record.eof = p_writer.offset();
+        rewrite(p_records.gdr);
+    }
+
+    template <typename T>
+    [[nodiscard]] static auto find_named(T& records, const std::string& name)
+    {
+        return std::find_if(std::begin(records), std::end(records),
+            [&name](const auto& r) { return r.record.Name.value == name; });
+    }
+
+    [[nodiscard]] auto find_attribute(const std::string& name)
+    {
+        auto& attributes = p_records.attributes;
+        return std::find_if(std::begin(attributes), std::end(attributes),
+            [&name](const auto& attribute) { return attribute.adr.record.Name.value == name; });
+    }
+
+    [[nodiscard]] static bool is_global(cdf_attr_scope scope)
+    {
+        return scope == cdf_attr_scope::global or scope == cdf_attr_scope::global_assumed;
+    }
+
+    static void check_name_length(const std::string& name)
+    {
+        if (std::size(name) > max_name_length)
+            throw std::invalid_argument { "Name too long: " + name };
+    }
+
+    [[nodiscard]] bool has_variable(const std::string& name)
+    {
+        return find_named(p_records.rvdrs, name) != std::end(p_records.rvdrs)
+            or find_named(p_records.zvdrs, name) != std::end(p_records.zvdrs);
+    }
+
+    // calls function(vdrs, iterator to the VDR), rVDRs and zVDRs have different types
+    template <typename function_t>
+    void visit_variable(const std::string& name, function_t&& function)
+    {
+        if (auto it = find_named(p_records.zvdrs, name); it != std::end(p_records.zvdrs))
+            function(p_records.zvdrs, it);
+        else if (auto it = find_named(p_records.rvdrs, name); it != std::end(p_records.rvdrs))
+            function(p_records.rvdrs, it);
+        else
+            throw std::invalid_argument { "Unknown variable: " + name };
+    }
+
+    auto& vdr_head(zvdrs_t&) { return p_records.gdr.record.zVDRhead; }
+    auto& vdr_head(rvdrs_t&) { return p_records.gdr.record.rVDRhead; }
+    auto& variables_count(zvdrs_t&) { return p_records.gdr.record.NzVars; }
+    auto& variables_count(rvdrs_t&) { return p_records.gdr.record.NrVars; }
+
+    // zVariables attributes are stored in AzEDRs, rVariables ones in AgrEDRs
+    static auto& variable_entries(attribute_records& attribute, zvdrs_t&)
+    {
+        return attribute.z_entries;
+    }
+    static auto& variable_entries(attribute_records& attribute, rvdrs_t&)
+    {
+        return attribute.gr_entries;
+    }
+    static auto& entries_head(attribute_records& attribute, entries_t<cdf_AzEDR_t<v3x_tag>>&)
+    {
+        return attribute.adr.record.AzEDRhead;
+    }
+    static auto& entries_head(attribute_records& attribute, entries_t<cdf_AgrEDR_t<v3x_tag>>&)
+    {
+        return attribute.adr.record.AgrEDRhead;
+    }
+
+    static void update_entries_count(attribute_records& attribute)
+    {
+        const auto max_entry = [](const auto& entries)
+        {
+            int32_t max = -1;
+            for (const auto& entry : entries)
+                max = std::max(max, entry.record.Num);
+            return max;
+        };
+        auto& adr = attribute.adr.record;
+        adr.NgrEntries = static_cast<int32_t>(std::size(attribute.gr_entries));
+        adr.MAXgrEntries = max_entry(attribute.gr_entries);
+        adr.NzEntries = static_cast<int32_t>(std::size(attribute.z_entries));
+        adr.MAXzEntries = max_entry(attribute.z_entries);
+    }
+
+    // makes the record before it (or the chain head) point to the record at it
+    template <typename head_t, typename records_t, typename next_t>
+    void link(head_t& head, records_t& records, typename records_t::iterator it, next_t next)
+    {
+        if (it == std::begin(records))
+            head = static_cast<head_t>(it->offset);
+        else
+        {
+            std::prev(it)->record.*next = it->offset;
+            rewrite(*std::prev(it));
+        }
+    }
+
+    template <typename head_t, typename records_t, typename next_t>
+    void unlink(head_t& head, records_t& records, typename records_t::iterator it, next_t next)
+    {
+        if (it == std::begin(records))
+            head = it->record.*next;
+        else
+        {
+            std::prev(it)->record.*next = it->record.*next;
+            rewrite(*std::prev(it));
+        }
+    }
+
+    template <typename aedr_t>
+    void delete_entry(attribute_records& attribute, entries_t<aedr_t>& entries, int32_t number)
+    {
+        if (auto it = std::find_if(std::begin(entries), std::end(entries),
+                [number](const auto& entry) { return entry.record.Num == number; });
+            it != std::end(entries))
+        {
+            unlink(entries_head(attribute, entries), entries, it, &aedr_t::AEDRnext);
+            entries.erase(it);
+        }
+        for (auto& entry : entries)
+        {
+            if (entry.record.Num > number)
+            {
+                entry.record.Num -= 1;
+                rewrite(entry);
+            }
+        }
+        update_entries_count(attribute);
+        rewrite(attribute.adr);
+    }
+
+    template <typename aedr_t>
+    void set_entry(
+        attribute_records& attribute, entries_t<aedr_t>& entries, int32_t number, const data_t& value)
+    {
+        const auto encoded = load_values<false>(data_t { value }, p_records.encoding);
+        const auto size = encoded.bytes();
+        aedr_t record { {}, 0, attribute.adr.record.num, value.type(), number,
+            saving::entry_elements(value), saving::entry_strings(value), 0, 0, 0, 0 };
+        auto it = std::find_if(std::begin(entries), std::end(entries),
+            [number](const auto& entry) { return entry.record.Num == number; });
+        if (it != std::end(entries))
+        {
+            record.AEDRnext = it->record.AEDRnext;
+            if (packed_size(record) + size <= it->size)
+            {
+                // the unused end of the previous value is left as is
+                record.header.record_size = it->size;
+                it->record = record;
+                rewrite(*it);
+                p_writer.write_at(it->offset + packed_size(record), encoded.bytes_ptr(), size);
+                return;
+            }
+        }
+        record_wrapper<aedr_t> entry { std::move(record) };
+        update_size(entry, size);
+        entry.offset = p_writer.offset();
+        save_record(entry.record, p_writer);
+        p_writer.write(encoded.bytes_ptr(), size);
+        if (it == std::end(entries))
+            it = entries.insert(it, std::move(entry));
+        else
+            *it = std::move(entry);
+        link(entries_head(attribute, entries), entries, it, &aedr_t::AEDRnext);
+        update_entries_count(attribute);
+        rewrite(attribute.adr);
+        update_eof();
+    }
+
+    attribute_records& attribute(const std::string& name, cdf_attr_scope scope)
+    {
+        auto& attributes = p_records.attributes;
+        if (auto it = find_attribute(name); it != std::end(attributes))
+        {
+            if (is_global(it->adr.record.scope) != is_global(scope))
+                throw std::invalid_argument { "Attribute scope mismatch: " + name };
+            return *it;
+        }
+        check_name_length(name);
+        record_wrapper<cdf_ADR_t<v3x_tag>> adr { cdf_ADR_t<v3x_tag> { {}, 0, 0, scope,
+            static_cast<int32_t>(p_records.gdr.record.NumAttr), 0, -1, 0, 0, 0, -1, 0, { name } } };
+        update_size(adr);
+        adr.offset = p_writer.offset();
+        save_record(adr.record, p_writer);
+        attributes.push_back(attribute_records { std::move(adr), {}, {} });
+        auto& gdr = p_records.gdr.record;
+        if (std::size(attributes) == 1)
+            gdr.ADRhead = attributes.back().adr.offset;
+        else
+        {
+            auto& previous = attributes[std::size(attributes) - 2].adr;
+            previous.record.ADRnext = attributes.back().adr.offset;
+            rewrite(previous);
+        }
+        gdr.NumAttr += 1;
+        update_eof();
+        return attributes.back();
+    }
+
+public:
+    explicit metadata_editor(const std::string& path) : metadata_editor { read_metadata(path), path }
+    {
+    }
+
+    metadata_editor(const metadata_editor&) = delete;
+    metadata_editor& operator=(const metadata_editor&) = delete;
+
+    ~metadata_editor()
+    {
+        if (is_open())
+        {
+            try
+            {
+                close();
+            }
+            catch (...)
+            {
+            }
+        }
+    }
+
+    [[nodiscard]] bool is_open() const noexcept { return p_writer.is_open(); }
+
+    // false once an edit failed to be written
+    [[nodiscard]] bool good() const noexcept { return p_writer.good(); }
+
+    void rename_variable(const std::string& name, const std::string& new_name)
+    {
+        check_name_length(new_name);
+        if (has_variable(new_name))
+            throw std::invalid_argument { "Variable already exists: " + new_name };
+        visit_variable(name,
+            [this, &new_name](auto&, auto it)
+            {
+                it->record.Name.value = new_name;
+                rewrite(*it);
+            });
+    }
+
+    /*
+     * Unlinks the variable and its attribute entries, variables numbered after it are renumbered
+     * so that numbers stay contiguous as the CDF format requires.
+     */
+    void delete_variable(const std::string& name)
+    {
+        visit_variable(name,
+            [this](auto& vdrs, auto it)
+            {
+                using vdr_t = std::decay_t<decltype(it->record)>;
+                const auto number = it->record.Num;
+                unlink(vdr_head(vdrs), vdrs, it, &vdr_t::VDRnext);
+                vdrs.erase(it);
+                for (auto& vdr : vdrs)
+                {
+                    if (vdr.record.Num > number)
+                    {
+                        vdr.record.Num -= 1;
+                        rewrite(vdr);
+                    }
+                }
+                for (auto& attribute : p_records.attributes)
+                {
+                    if (not is_global(attribute.adr.record.scope))
+                        delete_entry(attribute, variable_entries(attribute, vdrs), number);
+                }
+                variables_count(vdrs) -= 1;
+                rewrite(p_records.gdr);
+            });
+    }
+
+    void rename_attribute(const std::string& name, const std::string& new_name)
+    {
+        check_name_length(new_name);
+        auto& attributes = p_records.attributes;
+        if (find_attribute(new_name) != std::end(attributes))
+            throw std::invalid_argument { "Attribute already exists: " + new_name };
+        auto it = find_attribute(name);
+        if (it == std::end(attributes))
+            throw std::invalid_argument { "Unknown attribute: " + name };
+        it->adr.record.Name.value = new_name;
+        rewrite(it->adr);
+    }
+
+    // sets entry number entry of a global attribute, both are created when missing
+    void set_attribute(const std::string& name, std::size_t entry, const data_t& value)
+    {
+        auto& attr = attribute(name, cdf_attr_scope::global);
+        set_entry(attr, attr.gr_entries, static_cast<int32_t>(entry), value);
+    }
+
+    // sets the value of a variable attribute, it is created when missing
+    void set_variable_attribute(
+        const std::string& variable, const std::string& name, const data_t& value)
+    {
+        visit_variable(variable,
+            [this, &name, &value](auto& vdrs, auto it)
+            {
+                auto& attr = attribute(name, cdf_attr_scope::variable);
+                set_entry(attr, variable_entries(attr, vdrs), it->record.Num, value);
+            });
+    }
+
+    // returns false when any edit failed to be written
+    bool close()
+    {
+        const bool written = p_writer.flush();
+        p_writer.close();
+        return written;
+    }
+};
+
+}
@@ -0,0 +1,138 @@
+#pragma once
+/*------------------------------------------------------------------------------
+-- This file is a part of the CDFpp library
+-- Copyright (C) 2022, Plasma Physics Laboratory - CNRS
+--
+-- This program is free software; you can redistribute it and/or modify
+-- it under the terms of the GNU General Public License as published by
+-- the Free Software Foundation; either version 2 of the License, or
+-- (at your option) any later version.
+--
+-- This program is distributed in the hope that it will be useful,
+-- but WITHOUT ANY WARRANTY; without even the implied warranty of
+-- MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+-- GNU General Public License for more details.
+--
+-- You should have received a copy of the GNU General Public License
+-- along with this program; if not, write to the Free Software
+-- Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA 02111-1307 USA
+-------------------------------------------------------------------------------*/
+/*-- Author : Alexis Jeandet
+-- Mail : alexis.jeandet@member.fsf.org
+----------------------------------------------------------------------------*/
+
+#include "../loading/loading.hpp"
+#include "../saving/create_records.hpp"
+#include "../saving/saving.hpp"
+#include "cdfpp/cdf-enums.hpp"
+#include "cdfpp/cdf-file.hpp"
+#include "cdfpp/variable.hpp"
+#include <cstdio>
+#include <filesystem>
+#include <string>
+#include <system_error>
+
+namespace cdf::io
+{
+
+struct optimize_options
+{
+    // when set, variables stored in more values records than this chunking needs are re-chunked
+    chunk_size_t coalesce {};
+    // reloads the output and compares it with the input
+    bool validate = true;
+};
+
+namespace editing
+{
+    [[nodiscard]] inline bool is_fragmented(
+        const Variable& variable, const raw_data& raw, const chunk_size_t& chunk_size)
+    {
+        const auto records_per_chunk
+            = chunk_size.records_per_chunk(saving::variable_record_size(variable));
+        return std::size(raw.blocks)
+            > (variable.len() + records_per_chunk - 1) / records_per_chunk;
+    }
+
+    // compares one variable at a time so that at most two of them are loaded at once
+    [[nodiscard]] inline bool same_content(const CDF& expected, const CDF& actual)
+    {
+        if (expected.leap_second_last_updated != actual.leap_second_last_updated
+            or expected.attributes != actual.attributes
+            or std::size(expected.variables) != std::size(actual.variables))
+            return false;
+        for (const auto& [name, variable] : expected.variables)
+        {
+            const auto found = actual.variables.find(name);
+            if (found == std::cend(actual.variables))
+                return false;
+            // copies of unloaded variables are loaded, then dropped at the end of the iteration
+            const Variable candidate = found->second;
+            if (variable.values_loaded())
+            {
+                if (candidate != variable)
+                    return false;
+            }
+            else if (candidate != Variable { variable })
+                return false;
+        }
+        return true;
+    }
+} // namespace editing
+
+/*
+ * Rewrites path_in into path_out with the metadata first and the values records of each variable
+ * contiguous. Values records are copied as stored, compressed ones included, unless coalescing
+ * requires re-chunking them; sparse variables keep leaving out the records they were missing.
+ * path_out must not be path_in, whatever the path used to reach it, since the input stays mapped
+ * while writing. The output is written next to path_out under a temporary name and only renamed
+ * into place once it matches its input.
+ */
+[[nodiscard]] inline bool optimize(const std::string& path_in, const std::string& path_out,
+    const optimize_options& options = {})
+{
+    namespace fs = std::filesystem;
+    std::error_code error;
+    if (path_in == path_out or fs::equivalent(path_in, path_out, error))
+        return false;
+    const auto target = fs::path { path_out };
+    const auto temporary_path
+        = (target.parent_path() / ("." + target.filename().string() + ".optimizing")).string();
+    if (fs::exists(temporary_path, error) and fs::equivalent(path_in, temporary_path, error))
+        return false;
+    auto cdf = load(path_in, false, true);
+    if (not cdf)
+        return false;
+    cdf->layout = cdf_layout::metadata_first;
+    if (options.coalesce.is_set())
+    {
+        for (auto& [name, variable] : cdf->variables)
+        {
+            const auto raw = variable.raw_values();
+            // variables without raw values are encoded again anyway
+            if (not raw)
+                variable.set_chunk_size(options.coalesce);
+            else if (editing::is_fragmented(variable, *raw, options.coalesce))
+            {
+                variable.set_chunk_size(options.coalesce);
+                variable.load_values();
+            }
+        }
+    }
+    bool valid = save(*cdf, temporary_path);
+    if (valid and options.validate)
+    {
+        const auto output = load(temporary_path, false, true);
+        valid = output and editing::same_content(*cdf, *output);
+    }
+    if (valid)
+        fs::rename(temporary_path, path_out, error);
+    if (not valid or error)
+    {
+        std::remove(temporary_path.c_str());
+        return false;
+    }
+    return true;
+}
+
+} // namespace cdf::io
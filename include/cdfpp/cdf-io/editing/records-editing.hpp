@@ -0,0 +1,185 @@
+#pragma once
+/*------------------------------------------------------------------------------
+-- This file is a part of the CDFpp library
+-- Copyright (C) 2022, Plasma Physics Laboratory - CNRS
+--
+-- This program is free software; you can redistribute it and/or modify
+-- it under the terms of the GNU General Public License as published by
+-- the Free Software Foundation; either version 2 of the License, or
+-- (at your option) any later version.
+--
+-- This program is distributed in the hope that it will be useful,
+-- but WITHOUT ANY WARRANTY; without even the implied warranty of
+-- MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+-- GNU General Public License for more details.
+--
+-- You should have received a copy of the GNU General Public License
+-- along with this program; if not, write to the Free Software
+-- Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA 02111-1307 USA
+-------------------------------------------------------------------------------*/
+/*-- Author : Alexis Jeandet
+-- Mail : alexis.jeandet@member.fsf.org
+----------------------------------------------------------------------------*/
+
+#include "../common.hpp"
+#include "../desc-records.hpp"
+#include "../loading/loading.hpp"
+#include "../saving/buffers.hpp"
+#include "../saving/saving.hpp"
+#include "cdfpp/cdf-enums.hpp"
+#include "cdfpp/cdf-file.hpp"
+#include "cdfpp/no_init_vector.hpp"
+#include <algorithm>
+#include <optional>
+#include <stdexcept>
+#include <string>
+#include <utility>
+#include <vector>
+
+namespace cdf::io
+{
+
+namespace editing
+{
+    using file_buffer_t = decltype(buffers::make_shared_file_adapter(std::string {}));
+    using editing_context_t = parsing_context_t<file_buffer_t, v3x_tag>;
+
+    /*
+     * Only uncompressed v3 files can be edited in place, whole file compression would require to
+     * rewrite everything after the first modified byte anyway. The returned context maps the file
+     * read only, it must be released before writing to it.
+     */
+    [[nodiscard]] inline std::optional<editing_context_t> open_for_edition(const std::string& path)
+    {
+        auto buffer = buffers::make_shared_file_adapter(path);
+        if (not buffer.is_valid())
+            return std::nullopt;
+        const auto magic = get_magic(buffer);
+        if (not common::is_cdf(magic) or not common::is_v3x(magic)
+            or common::is_compressed(magic))
+            return std::nullopt;
+        return make_parsing_context(
+            v3x_tag {}, std::move(buffer), cdf_compression_type::no_compression);
+    }
+
+    template <cdf_r_z type, typename function_t>
+    [[nodiscard]] inline bool visit_variable(
+        editing_context_t& context, const std::string& name, function_t& function)
+    {
+        auto vdr = std::find_if(begin_VDR<type>(context), end_VDR<type>(context),
+            [&name](const auto& blk) { return blk.second.Name.value == name; });
+        if (vdr == end_VDR<type>(context))
+            return false;
+        const auto& [offset, record] = *vdr;
+        function(offset, record, variable::get_variable_dimensions<type>(record, context, {}));
+        return true;
+    }
+
+    /*
+     * Calls function(vdr_offset, vdr, record_shape) on the VDR of the variable called name,
+     * rVDRs and zVDRs having different types function must accept both.
+     */
+    template <typename function_t>
+    [[nodiscard]] inline bool visit_variable(
+        editing_context_t& context, const std::string& name, function_t&& function)
+    {
+        return visit_variable<cdf_r_z::z>(context, name, function)
+            or visit_variable<cdf_r_z::r>(context, name, function);
+    }
+
+    struct values_block
+    {
+        std::size_t first_record;
+        std::size_t last_record;
+        std::size_t data_offset;
+    };
+
+    // walks the VXR tree of a variable, nested VXRs included
+    inline void collect_values_blocks(
+        editing_context_t& context, std::size_t vxr_offset, std::vector<values_block>& blocks)
+    {
+        while (vxr_offset != 0)
+        {
+            cdf_VXR_t<v3x_tag> vxr;
+            load_record(vxr, context, vxr_offset);
+            for (auto i = 0UL; i < vxr.NusedEntries; i++)
+            {
+                const auto offset = static_cast<std::size_t>(vxr.Offset.values[i]);
+                cdf_DR_header<v3x_tag, cdf_record_type::UIR> header;
+                load_record(header, context, offset);
+                switch (header.record_type)
+                {
+                    case cdf_record_type::VVR:
+                        blocks.push_back({ vxr.First.values[i], vxr.Last.values[i],
+                            offset + record_size(header) });
+                        break;
+                    case cdf_record_type::VXR:
+                        collect_values_blocks(context, offset, blocks);
+                        break;
+                    default:
+                        throw std::invalid_argument {
+                            "Only uncompressed values records can be edited in place"
+                        };
+                }
+            }
+            vxr_offset = static_cast<std::size_t>(vxr.VXRnext);
+        }
+    }
+
+    /*
+     * Values block holding the last records of a variable, only the tail of the VXR tree is
+     * walked. Compressed blocks are never preallocated so they are not reported.
+     */
+    [[nodiscard]] inline std::optional<values_block> last_values_block(
+        editing_context_t& context, std::size_t vxr_offset)
+    {
+        while (vxr_offset != 0)
+        {
+            cdf_VXR_t<v3x_tag> vxr;
+            load_record(vxr, context, vxr_offset);
+            if (vxr.VXRnext != 0)
+            {
+                vxr_offset = static_cast<std::size_t>(vxr.VXRnext);
+                continue;
+            }
+            if (vxr.NusedEntries == 0)
+                return std::nullopt;
+            const auto last = vxr.NusedEntries - 1;
+            const auto offset = static_cast<std::size_t>(vxr.Offset.values[last]);
+            cdf_DR_header<v3x_tag, cdf_record_type::UIR> header;
+            load_record(header, context, offset);
+            if (header.record_type == cdf_record_type::VVR)
+                return values_block { vxr.First.values[last], vxr.Last.values[last],
+                    offset + record_size(header) };
+            if (header.record_type != cdf_record_type::VXR)
+                return std::nullopt;
+            vxr_offset = offset;
+        }
+        return std::nullopt;
+    }
+
+    /*
+     * Brings values back to the file representation. Byte swapping is its own inverse so the
+     * loading code is reused, column major records are transposed back using their reversed shape.
+     */
+    [[nodiscard]] inline data_t encode_values(const data_t& values,
+        const editing_context_t& context, const no_init_vector<uint32_t>& record_shape,
+        std::size_t records)
+    {
+        data_t encoded = values;
+        if (context.majority == cdf_majority::column and std::size(record_shape) >= 2)
+        {
+            if (is_string(values.type()))
+                throw std::invalid_argument {
+                    "Multidimensional string variables of column major files can't be edited"
+                };
+            no_init_vector<uint32_t> shape { static_cast<uint32_t>(records) };
+            shape.insert(std::end(shape), std::crbegin(record_shape), std::crend(record_shape));
+            majority::swap(encoded, shape);
+        }
+        return load_values<false>(std::move(encoded), context.cdr.Encoding);
+    }
+
+} // namespace
+
+}
@@ -0,0 +1,100 @@
+#pragma once
+/*------------------------------------------------------------------------------
+-- This file is a part of the CDFpp library
+-- Copyright (C) 2022, Plasma Physics Laboratory - CNRS
+--
+-- This program is free software; you can redistribute it and/or modify
+-- it under the terms of the GNU General Public License as published by
+-- the Free Software Foundation; either version 2 of the License, or
+-- (at your option) any later version.
+--
+-- This program is distributed in the hope that it will be useful,
+-- but WITHOUT ANY WARRANTY; without even the implied warranty of
+-- MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+-- GNU General Public License for more details.
+--
+-- You should have received a copy of the GNU General Public License
+-- along with this program; if not, write to the Free Software
+-- Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA 02111-1307 USA
+-------------------------------------------------------------------------------*/
+/*-- Author : Alexis Jeandet
+-- Mail : alexis.jeandet@member.fsf.org
+----------------------------------------------------------------------------*/
+
+#include "../saving/buffers.hpp"
+#include "./records-editing.hpp"
+#include "cdfpp/cdf-data.hpp"
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+namespace cdf::io
+{
+
+/*
+ * Overwrites the records [first_record, first_record + number of records in values) of an
+ * uncompressed variable in its existing VVRs, no other byte of the file moves. values must have
+ * the variable type and hold whole records. Returns false when the file can't be edited in place
+ * or the writes fail, invalid requests throw.
+ */
+[[nodiscard]] inline bool update_values(const std::string& path, const std::string& name,
+    const data_t& values, std::size_t first_record = 0)
+{
+    std::vector<editing::values_block> blocks;
+    data_t encoded;
+    std::size_t record_size = 0UL;
+    std::size_t records = 0UL;
+    {
+        auto context = editing::open_for_edition(path);
+        if (not context)
+            return false;
+        const bool found = editing::visit_variable(*context, name,
+            [&](std::size_t, const auto& vdr, const auto& record_shape)
+            {
+                if (common::is_compressed(vdr))
+                    throw std::invalid_argument { "Compressed variables can't be updated in place" };
+                if (vdr.DataType != values.type())
+                    throw std::invalid_argument { "Type mismatch while updating variable: " + name };
+                record_size = variable::var_record_size(record_shape, vdr.DataType);
+                if (values.bytes() % record_size != 0)
+                    throw std::invalid_argument { "Updating a partial record of variable: " + name };
+                records = values.bytes() / record_size;
+                if (first_record + records > static_cast<std::size_t>(vdr.MaxRec + 1))
+                    throw std::out_of_range { "Updating records past the end of variable: " + name };
+                encoded = editing::encode_values(values, *context, record_shape, records);
+                editing::collect_values_blocks(*context, vdr.VXRhead, blocks);
+            });
+        if (not found)
+            throw std::invalid_argument { "Unknown variable: " + name };
+    }
+    const auto last_record = first_record + records;
+    std::size_t covered = 0UL;
+    for (const auto& block : blocks)
+    {
+        const auto begin = std::max(first_record, block.first_record);
+        const auto end = std::min(last_record, block.last_record + 1);
+        covered += (end > begin) ? end - begin : 0UL;
+    }
+    // virtual records of sparse variables have no VVR to patch
+    if (covered != records)
+        throw std::invalid_argument { "Some updated records are not stored in variable: " + name };
+    buffers::file_writer writer { path, buffers::file_writer::open_mode::update };
+    if (not writer.is_open())
+        return false;
+    for (const auto& block : blocks)
+    {
+        const auto begin = std::max(first_record, block.first_record);
+        const auto end = std::min(last_record, block.last_record + 1);
+        if (end > begin)
+        {
+            writer.write_at(block.data_offset + (begin - block.first_record) * record_size,
+                encoded.bytes_ptr() + (begin - first_record) * record_size,
+                (end - begin) * record_size);
+        }
+    }
+    const bool written = writer.flush();
+    writer.close();
+    return written;
+}
+
+}
@@ -48,6 +48,8 @@ inline const bool host_is_little_endian = true;
 
 #include "../cdf-debug.hpp"
 #include "../cdf-enums.hpp"
+#include "parallel.hpp"
+#include "simd-byteswap.hpp"
 #include <algorithm>
 #include <stdint.h>
 #include <cstring>
@@ -182,13 +184,17 @@ inline void _impl_decode_v(value_t* data, std::size_t size)
     if constexpr (sizeof(value_t) > 1 and not std::is_same_v<host_endianness_t, src_endianess_t>)
     {
         CDFPP_ASSERT(data != nullptr);
-        if (size > 0)
-        {
-            for (auto i = 0UL; i < size; i++)
+        io::parallel::for_each_chunk(size, sizeof(value_t),
+            [data](std::size_t first, std::size_t count)
             {
-                data[i] = byte_swap(data[i]);
-            }
-        }
+                auto chunk = data + first;
+                const auto swapped
+                    = simd::byte_swap<sizeof(value_t)>(reinterpret_cast<char*>(chunk), count);
+                for (auto i = swapped; i < count; i++)
+                {
+                    chunk[i] = byte_swap(chunk[i]);
+                }
+            });
     }
 }
 
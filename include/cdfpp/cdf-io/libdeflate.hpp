@@ -21,26 +21,68 @@
 -- Mail : alexis.jeandet@member.fsf.org
 ----------------------------------------------------------------------------*/
 #include "../cdf-debug.hpp"
+#include "cdfpp/cdf-enums.hpp"
 #include "cdfpp/no_init_vector.hpp"
 
+#include <algorithm>
+#include <array>
 #include <cstddef>
 #include <libdeflate.h>
+#include <memory>
 #include <vector>
 
 namespace cdf::io::libdeflate
 {
 namespace _internal
 {
+    struct decompressor_deleter
+    {
+        void operator()(libdeflate_decompressor* decompressor) const noexcept
+        {
+            libdeflate_free_decompressor(decompressor);
+        }
+    };
+
+    struct compressor_deleter
+    {
+        void operator()(libdeflate_compressor* compressor) const noexcept
+        {
+            libdeflate_free_compressor(compressor);
+        }
+    };
+
+    // codec contexts are expensive to allocate, each thread keeps its own for reuse
+    inline libdeflate_decompressor* thread_decompressor()
+    {
+        thread_local std::unique_ptr<libdeflate_decompressor, decompressor_deleter> decompressor {
+            libdeflate_alloc_decompressor()
+        };
+        return decompressor.get();
+    }
+
+    // one compressor per level since libdeflate can't change the level of an existing one
+    inline libdeflate_compressor* thread_compressor(int level)
+    {
+        thread_local std::array<std::unique_ptr<libdeflate_compressor, compressor_deleter>,
+            max_compression_level + 1>
+            compressors;
+        level = std::clamp(level, 0, max_compression_level);
+        auto& compressor = compressors[static_cast<std::size_t>(level)];
+        if (!compressor)
+            compressor.reset(libdeflate_alloc_compressor(level));
+        return compressor.get();
+    }
+
     template <typename T>
     CDF_WARN_UNUSED_RESULT std::size_t impl_inflate(
         const T& input, char* output, const std::size_t output_size)
     {
-
-        auto decompressor = libdeflate_alloc_decompressor();
+        auto decompressor = thread_decompressor();
+        if (decompressor == nullptr)
+            return 0;
         std::size_t length;
         auto result = libdeflate_gzip_decompress(
             decompressor, input.data(), std::size(input), output, output_size, &length);
-        libdeflate_free_decompressor(decompressor);
         if (result == LIBDEFLATE_SUCCESS)
         {
             return length;
@@ -52,13 +94,14 @@ namespace _internal
     }
 
     template <typename T>
-    CDF_WARN_UNUSED_RESULT no_init_vector<char> impl_deflate(const T& input)
+    CDF_WARN_UNUSED_RESULT no_init_vector<char> impl_deflate(const T& input, int level)
     {
-        no_init_vector<char> result(std::max(std::size(input), std::size_t { 16 * 1024UL }));
-        auto compressor = libdeflate_alloc_compressor(6);
+        auto compressor = thread_compressor(level);
+        if (compressor == nullptr)
+            return {};
+        no_init_vector<char> result(libdeflate_gzip_compress_bound(compressor, std::size(input)));
         auto compressed_size = libdeflate_gzip_compress(
             compressor, input.data(), std::size(input), result.data(), std::size(result));
-        libdeflate_free_compressor(compressor);
         if (compressed_size > 0)
         {
             result.resize(compressed_size);
@@ -80,10 +123,10 @@ std::size_t gzinflate(const T& input, char* output, const std::size_t output_siz
 }
 
 template <typename T>
-no_init_vector<char> gzdeflate(const T& input)
+no_init_vector<char> gzdeflate(const T& input, int level = default_compression_level)
 {
     using namespace _internal;
-    return impl_deflate(input);
+    return impl_deflate(input, level);
 }
 
 }
@@ -28,48 +28,106 @@
 namespace cdf::io::attribute
 {
 
-template <cdf_r_z type, typename cdf_version_tag_t, bool iso_8859_1_to_utf8, typename ADR_t,
-    typename context_t>
-Attribute::attr_data_t load_data(
-    context_t& context, const ADR_t& ADR, std::vector<uint32_t>& var_num)
+template <bool iso_8859_1_to_utf8, typename buffer_t>
+data_t load_entry(buffer_t& buffer, cdf_encoding encoding, std::size_t offset, CDF_Types type,
+    uint32_t count, const std::shared_ptr<monotonic_arena>& arena)
+{
+    const std::size_t size = count * cdf_type_size(type);
+    data_t data = new_data_container(size, type, arena);
+    buffer.read(data.bytes_ptr(), offset, size);
+    return load_values<iso_8859_1_to_utf8>(std::move(data), encoding);
+}
+
+template <bool iso_8859_1_to_utf8, typename buffer_t>
+struct defered_attribute_entry_loader
+{
+    defered_attribute_entry_loader(buffer_t buffer, cdf_encoding encoding, std::size_t offset,
+        CDF_Types type, uint32_t count, std::shared_ptr<monotonic_arena> arena)
+            : p_buffer { buffer }
+            , p_encoding { encoding }
+            , p_offset { offset }
+            , p_type { type }
+            , p_count { count }
+            , p_arena { std::move(arena) }
+    {
+    }
+
+    inline data_t operator()()
+    {
+        return load_entry<iso_8859_1_to_utf8>(this->p_buffer, this->p_encoding, this->p_offset,
+            this->p_type, this->p_count, this->p_arena);
+    }
+
+private:
+    buffer_t p_buffer;
+    cdf_encoding p_encoding;
+    std::size_t p_offset;
+    CDF_Types p_type;
+    uint32_t p_count;
+    std::shared_ptr<monotonic_arena> p_arena;
+};
+
+template <cdf_r_z type, typename cdf_version_tag_t, bool iso_8859_1_to_utf8, typename entry_t,
+    typename ADR_t, typename context_t>
+std::vector<entry_t> load_data(context_t& context, const ADR_t& ADR,
+    std::vector<uint32_t>& var_num, const std::shared_ptr<monotonic_arena>& arena)
 {
-    Attribute::attr_data_t values;
+    std::vector<entry_t> values;
     std::for_each(begin_AEDR<type>(ADR, context), end_AEDR<type>(ADR, context),
         [&](auto& blk)
         {
             auto& [offset, AEDR] = blk;
-            std::size_t element_size = cdf_type_size(CDF_Types { AEDR.DataType });
-            data_t data
-                = new_data_container(AEDR.NumElements * element_size, CDF_Types { AEDR.DataType });
-            context.buffer.read(
-                data.bytes_ptr(), offset + packed_size(AEDR), AEDR.NumElements * element_size);
-            values.emplace_back(
-                load_values<iso_8859_1_to_utf8>(std::move(data), context.encoding()));
+            const auto data_type = CDF_Types { AEDR.DataType };
+            const std::size_t data_offset = offset + packed_size(AEDR);
+            if constexpr (std::is_same_v<entry_t, lazy_data>)
+            {
+                values.emplace_back(
+                    defered_attribute_entry_loader<iso_8859_1_to_utf8, decltype(context.buffer)> {
+                        context.buffer, context.encoding(), data_offset, data_type,
+                        static_cast<uint32_t>(AEDR.NumElements), arena },
+                    data_type);
+            }
+            else
+            {
+                values.emplace_back(load_entry<iso_8859_1_to_utf8>(context.buffer,
+                    context.encoding(), data_offset, data_type,
+                    static_cast<uint32_t>(AEDR.NumElements), arena));
+            }
             var_num.push_back(AEDR.Num);
         });
     return values;
 }
 
-template <typename cdf_version_tag_t, bool iso_8859_1_to_utf8, typename context_t>
-bool load_all(context_t& context, common::cdf_repr& repr)
+template <typename cdf_version_tag_t, bool iso_8859_1_to_utf8, typename entry_t,
+    typename context_t>
+void load_all_entries(context_t& context, common::cdf_repr& repr)
 {
     std::for_each(begin_ADR(context), end_ADR(context),
         [&](auto& blk)
         {
             auto& [offset, ADR] = blk;
             std::vector<uint32_t> var_nums;
-            Attribute::attr_data_t data = [&,&ADR=ADR]() -> Attribute::attr_data_t
+            std::vector<entry_t> data = [&, &ADR = ADR]() -> std::vector<entry_t>
             {
                 if (ADR.AzEDRhead != 0)
-                    return load_data<cdf_r_z::z, cdf_version_tag_t, iso_8859_1_to_utf8>(
-                        context, ADR, var_nums);
+                    return load_data<cdf_r_z::z, cdf_version_tag_t, iso_8859_1_to_utf8, entry_t>(
+                        context, ADR, var_nums, repr.arena);
                 else if (ADR.AgrEDRhead != 0)
-                    return load_data<cdf_r_z::r, cdf_version_tag_t, iso_8859_1_to_utf8>(
-                        context, ADR, var_nums);
+                    return load_data<cdf_r_z::r, cdf_version_tag_t, iso_8859_1_to_utf8, entry_t>(
+                        context, ADR, var_nums, repr.arena);
                 return {};
             }();
             common::add_attribute(repr, ADR.scope, ADR.Name.value, std::move(data), var_nums);
         });
+}
+
+template <typename cdf_version_tag_t, bool iso_8859_1_to_utf8, typename context_t>
+bool load_all(context_t& context, common::cdf_repr& repr, bool lazy_load = false)
+{
+    if (lazy_load)
+        load_all_entries<cdf_version_tag_t, iso_8859_1_to_utf8, lazy_data>(context, repr);
+    else
+        load_all_entries<cdf_version_tag_t, iso_8859_1_to_utf8, data_t>(context, repr);
     return true;
 }
 } // namespace cdf::io::attribute
@@ -20,6 +20,8 @@
 /*-- Author : Alexis Jeandet
 -- Mail : alexis.jeandet@member.fsf.org
 ----------------------------------------------------------------------------*/
+#include "cdfpp/no_init_vector.hpp"
+#include "cdfpp_config.h"
 #include <algorithm>
 #include <cassert>
 #include <cstdint>
@@ -27,7 +29,10 @@
 #include <filesystem>
 #include <fstream>
 #include <memory>
+#include <mutex>
+#include <new>
 #include <optional>
+#include <utility>
 #include <vector>
 
 #if __has_include(<sys/mman.h>)
@@ -229,6 +234,146 @@ struct array_adapter
 template <typename array_t>
 using owning_array_adapter = array_adapter<array_t, true>;
 
+#ifdef USE_MMAP
+namespace _private
+{
+    /*
+     * Holds the last released anonymous mapping so that loading many compressed files in a row
+     * reuses it instead of paying for a fresh mmap/munmap pair and zero-filled page faults each
+     * time. Its pages were handed back with MADV_FREE, the kernel may reclaim them under memory
+     * pressure or leave them for the next image.
+     */
+    struct released_mapping_cache
+    {
+        std::mutex mutex;
+        char* ptr = nullptr;
+        std::size_t capacity = 0UL;
+
+        ~released_mapping_cache()
+        {
+            if (ptr)
+                ::munmap(ptr, capacity);
+        }
+
+        std::pair<char*, std::size_t> take(std::size_t size)
+        {
+            std::lock_guard<std::mutex> lock { mutex };
+            if (ptr and capacity >= size and capacity / 2 <= size)
+                return { std::exchange(ptr, nullptr), std::exchange(capacity, 0UL) };
+            return { nullptr, 0UL };
+        }
+
+        void put(char* mapping, std::size_t mapping_capacity)
+        {
+            std::lock_guard<std::mutex> lock { mutex };
+            if (ptr)
+                ::munmap(ptr, capacity);
+            ptr = mapping;
+            capacity = mapping_capacity;
+        }
+    };
+
+    inline released_mapping_cache& mapping_cache()
+    {
+        static released_mapping_cache cache;
+        return cache;
+    }
+}
+
+/*
+ * Owned, page aligned and anonymously mapped memory block. Large blocks are advised for
+ * transparent huge pages, released blocks are given back with MADV_FREE and kept for reuse.
+ */
+class anonymous_mapping
+{
+    static inline constexpr std::size_t small_page_size = 1 << 12;
+    static inline constexpr std::size_t huge_page_size = 1 << 21;
+
+    char* p_data = nullptr;
+    std::size_t p_size = 0UL;
+    std::size_t p_capacity = 0UL;
+
+public:
+    using value_type = char;
+
+    explicit anonymous_mapping(std::size_t size) : p_size { size }
+    {
+        const auto page_size = (size >= 2 * huge_page_size) ? huge_page_size : small_page_size;
+        p_capacity = std::max(page_size, (size + page_size - 1) & ~(page_size - 1));
+        if (auto [cached, cached_capacity] = _private::mapping_cache().take(p_capacity); cached)
+        {
+            p_data = cached;
+            p_capacity = cached_capacity;
+            return;
+        }
+        void* mem = ::mmap(
+            nullptr, p_capacity, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+        if (mem == MAP_FAILED)
+            throw std::bad_alloc();
+#ifdef MADV_HUGEPAGE
+        if (p_capacity >= 2 * huge_page_size)
+            ::madvise(mem, p_capacity, MADV_HUGEPAGE);
+#endif
+        p_data = static_cast<char*>(mem);
+    }
+
+    anonymous_mapping(const anonymous_mapping&) = delete;
+    anonymous_mapping& operator=(const anonymous_mapping&) = delete;
+
+    anonymous_mapping(anonymous_mapping&& other) noexcept
+            : p_data { std::exchange(other.p_data, nullptr) }
+            , p_size { std::exchange(other.p_size, 0UL) }
+            , p_capacity { std::exchange(other.p_capacity, 0UL) }
+    {
+    }
+
+    anonymous_mapping& operator=(anonymous_mapping&& other) noexcept
+    {
+        if (this != &other)
+        {
+            release();
+            p_data = std::exchange(other.p_data, nullptr);
+            p_size = std::exchange(other.p_size, 0UL);
+            p_capacity = std::exchange(other.p_capacity, 0UL);
+        }
+        return *this;
+    }
+
+    ~anonymous_mapping() { release(); }
+
+    void release() noexcept
+    {
+        if (p_data)
+        {
+#if defined(MADV_FREE)
+            ::madvise(p_data, p_capacity, MADV_FREE);
+#else
+            ::madvise(p_data, p_capacity, MADV_DONTNEED);
+#endif
+            _private::mapping_cache().put(p_data, p_capacity);
+            p_data = nullptr;
+            p_size = 0UL;
+            p_capacity = 0UL;
+        }
+    }
+
+    [[nodiscard]] char* data() noexcept { return p_data; }
+    [[nodiscard]] const char* data() const noexcept { return p_data; }
+    [[nodiscard]] std::size_t size() const noexcept { return p_size; }
+    [[nodiscard]] std::size_t capacity() const noexcept { return p_capacity; }
+};
+#endif
+
+/*
+ * Owned buffer receiving the inflated image of whole-file compressed CDFs, heap allocated
+ * (huge page aligned for large images) unless built with anonymous mapping support.
+ */
+#if defined(CDFpp_USE_ANONYMOUS_MAPPING) && defined(USE_MMAP)
+using file_image_t = anonymous_mapping;
+#else
+using file_image_t = no_init_vector<char>;
+#endif
+
 
 struct mmap_adapter
 {
@@ -71,6 +71,7 @@ namespace
         cdf.variables = std::move(repr.variables);
         cdf.lazy_loaded = repr.lazy;
         cdf.compression = repr.compression_type;
+        cdf.arena = std::move(repr.arena);
         //cdf.leap_second_last_updated = repr.leap_second_last_updated;
         return cdf;
     }
@@ -83,8 +84,9 @@ namespace
         repr.majority = parsing_context.majority;
         repr.distribution_version = parsing_context.distribution_version();
         repr.compression_type = parsing_context.compression_type;
+        repr.lazy = lazy_load;
         if (!attribute::load_all<typename parsing_context_t::version_tag, iso_8859_1_to_utf8>(
-                parsing_context, repr))
+                parsing_context, repr, lazy_load))
             return std::nullopt;
         if (!variable::load_all<typename parsing_context_t::version_tag, iso_8859_1_to_utf8>(
                 parsing_context, repr, lazy_load))
@@ -98,16 +100,21 @@ namespace
     {
         if (is_compressed)
         {
-            if (cdf_CCR_t<cdf_version_tag_t> CCR {}; load_record(CCR, buffer, 8))
+            if (cdf_CCR_t<cdf_version_tag_t, table_view_field> CCR {};
+                load_record(CCR, buffer, 8))
             {
                 cdf_CPR_t<cdf_version_tag_t> CPR;
                 load_record(CPR, buffer, CCR.CPRoffset);
-                no_init_vector<char> data(8UL + CCR.uSize);
-                buffer.read(data.data(), 0, 8);
-                decompression::inflate(
-                    CPR.cType, CCR.data.values, data.data() + 8UL, std::size(data) - 8UL);
+                // the payload is inflated straight from the source buffer, only the magic
+                // numbers are copied so that record offsets stay file offsets
+                buffers::file_image_t image(8UL + CCR.uSize);
+                buffer.read(image.data(), 0, 8);
+                if (decompression::inflate(CPR.cType, CCR.data.values, image.data() + 8UL,
+                        CCR.uSize)
+                    != static_cast<std::size_t>(CCR.uSize))
+                    return std::nullopt;
                 auto parsing_ctx = make_parsing_context(cdf_version_tag_t {},
-                    buffers::make_shared_array_adapter(std::move(data)), CPR.cType);
+                    buffers::make_shared_array_adapter(std::move(image)), CPR.cType);
                 return impl_parse_cdf<common::with_iso_8859_1_to_utf8<iso_8859_1_to_utf8>>(
                     parsing_ctx, lazy_load);
             }
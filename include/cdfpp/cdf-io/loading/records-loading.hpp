@@ -75,7 +75,17 @@ inline std::size_t load_field(
     }
     else
     {
-        if constexpr (is_table_field_v<T>)
+        if constexpr (is_table_view_field_v<T>)
+        {
+            const auto bytes = r.size(field);
+            field.values = std::basic_string_view<typename T::value_type> {
+                reinterpret_cast<const typename T::value_type*>(
+                    buffers::get_data_ptr(parsing_context) + offset),
+                bytes
+            };
+            return offset + bytes;
+        }
+        else if constexpr (is_table_field_v<T>)
         {
             const auto bytes = r.size(field);
             field.values.resize(bytes / sizeof(typename T::value_type));
@@ -121,7 +131,8 @@ inline std::size_t load_fields(const record_t& r, parsing_context_t& parsing_con
     using Field_t = std::remove_cv_t<std::remove_reference_t<T>>;
     static constexpr std::size_t count = count_members<Field_t>;
     if constexpr (std::is_compound_v<Field_t> && (count > 1)
-        && (not is_string_field_v<Field_t>)&&(not is_table_field_v<Field_t>))
+        && (not is_string_field_v<Field_t>)&&(not is_table_field_v<Field_t>)
+        && (not is_table_view_field_v<Field_t>))
         return load_record(field, parsing_context, offset);
     else
         return load_field(r, parsing_context, offset, std::forward<T>(field));
@@ -143,7 +154,7 @@ struct cdf_mutable_variable_record_t
 {
     inline static constexpr bool v3 = is_v3_v<version_t>;
     using vvr_t = cdf_VVR_t<version_t>;
-    using cvvr_t = cdf_CVVR_t<version_t>;
+    using cvvr_t = cdf_CVVR_t<version_t, table_view_field>;
     using vxr_t = cdf_VXR_t<version_t>;
 
     std::variant<std::monostate, vvr_t, cvvr_t, vxr_t> actual_record;
@@ -29,7 +29,11 @@
 #include "cdfpp/variable.hpp"
 #include <algorithm>
 #include <cstdint>
+#include <cstring>
 #include <numeric>
+#include <optional>
+#include <type_traits>
+#include <vector>
 
 namespace cdf::io::variable
 {
@@ -44,12 +48,15 @@ namespace
     }
 
     template <cdf_r_z type, typename cdf_vdr_t, typename context_t>
-    no_init_vector<uint32_t> get_variable_dimensions(const cdf_vdr_t& vdr, context_t& context)
+    no_init_vector<uint32_t> get_variable_dimensions(
+        const cdf_vdr_t& vdr, context_t& context, const std::shared_ptr<monotonic_arena>& arena)
     {
         if constexpr (type == cdf_r_z::z)
         {
 
-            no_init_vector<uint32_t> shape;
+            no_init_vector<uint32_t> shape { default_init_allocator<uint32_t> { arena } };
+            // a single allocation, taken from the arena
+            shape.reserve(std::size(vdr.zDimSizes.values) + 1);
             if (vdr.zNumDims)
             {
                 std::copy_if(std::cbegin(vdr.zDimSizes.values), std::cend(vdr.zDimSizes.values),
@@ -70,7 +77,8 @@ namespace
         }
         else
         {
-            no_init_vector<uint32_t> shape;
+            no_init_vector<uint32_t> shape { default_init_allocator<uint32_t> { arena } };
+            shape.reserve(std::size(context.gdr.rDimSizes.values) + 1);
             if (std::size(vdr.DimVarys.values) != 0)
             {
                 std::copy_if(std::cbegin(context.gdr.rDimSizes.values),
@@ -89,7 +97,7 @@ namespace
             }
             if (std::size(shape) == 0)
             {
-                return { 1 };
+                shape.push_back(1);
             }
             return shape;
         }
@@ -118,8 +126,9 @@ namespace
 
 
     template <typename cdf_version_tag_t, typename buffer_t>
-    inline void load_cvvr_data(const cdf_CVVR_t<cdf_version_tag_t>& cvvr, std::size_t& pos,
-        const cdf_compression_type compression_type, char* data, std::size_t data_len)
+    inline void load_cvvr_data(const cdf_CVVR_t<cdf_version_tag_t, table_view_field>& cvvr,
+        std::size_t& pos, const cdf_compression_type compression_type, char* data,
+        std::size_t data_len)
     {
         if (compression_type == cdf_compression_type::gzip_compression)
         {
@@ -136,14 +145,126 @@ namespace
         }
     }
 
+    template <typename T>
+    inline void fill_record(char* record, std::size_t record_size, T value)
+    {
+        for (auto offset = 0UL; offset + sizeof(T) <= record_size; offset += sizeof(T))
+            std::memcpy(record + offset, &value, sizeof(T));
+    }
+
+    // pad values used by the CDF library when a VDR doesn't define its own
+    inline void fill_with_default_pad(CDF_Types type, char* record, std::size_t record_size)
+    {
+        // empty records have no storage, record may be null
+        if (record_size == 0)
+            return;
+        switch (type)
+        {
+            case CDF_Types::CDF_BYTE:
+            case CDF_Types::CDF_INT1:
+                fill_record(record, record_size, int8_t { -127 });
+                break;
+            case CDF_Types::CDF_INT2:
+                fill_record(record, record_size, int16_t { -32767 });
+                break;
+            case CDF_Types::CDF_INT4:
+                fill_record(record, record_size, int32_t { -2147483647 });
+                break;
+            case CDF_Types::CDF_INT8:
+            case CDF_Types::CDF_TIME_TT2000:
+                fill_record(record, record_size, int64_t { -9223372036854775807 });
+                break;
+            case CDF_Types::CDF_UINT1:
+                fill_record(record, record_size, uint8_t { 254 });
+                break;
+            case CDF_Types::CDF_UINT2:
+                fill_record(record, record_size, uint16_t { 65534 });
+                break;
+            case CDF_Types::CDF_UINT4:
+                fill_record(record, record_size, uint32_t { 4294967294 });
+                break;
+            case CDF_Types::CDF_FLOAT:
+            case CDF_Types::CDF_REAL4:
+                fill_record(record, record_size, float { -1e30f });
+                break;
+            case CDF_Types::CDF_DOUBLE:
+            case CDF_Types::CDF_REAL8:
+                fill_record(record, record_size, double { -1e30 });
+                break;
+            case CDF_Types::CDF_CHAR:
+            case CDF_Types::CDF_UCHAR:
+                std::memset(record, ' ', record_size);
+                break;
+            default:
+                std::memset(record, 0, record_size);
+                break;
+        }
+    }
+
+    /*
+     * Records missing from the VXR tree (sparse records or never written ones) read as the pad
+     * value, or as the previous record when SRecords says so. The pad record is kept in the file
+     * encoding since it is decoded with the values.
+     */
+    struct virtual_records_filler
+    {
+        no_init_vector<char> pad_record;
+        bool previous = false;
+
+        template <typename VDR_t>
+        virtual_records_filler(const VDR_t& vdr, uint32_t record_size, cdf_encoding encoding)
+                : pad_record(record_size), previous { vdr.SRecords == 2 }
+        {
+            const auto value_size = std::size(vdr.PadValues.values);
+            if (value_size != 0 and record_size % value_size == 0)
+            {
+                const auto* value = vdr.PadValues.values.data();
+                for (auto offset = 0UL; offset < record_size; offset += value_size)
+                    std::memcpy(pad_record.data() + offset, value, value_size);
+            }
+            else
+            {
+                fill_with_default_pad(vdr.DataType, pad_record.data(), record_size);
+                const auto type_size = std::min(cdf_type_size(vdr.DataType), std::size_t { 8 });
+                if (type_size > 1
+                    and endianness::is_big_endian_encoding(encoding)
+                        != host_is_big_endian)
+                {
+                    for (auto offset = 0UL; offset + type_size <= record_size; offset += type_size)
+                        std::reverse(pad_record.data() + offset,
+                            pad_record.data() + offset + type_size);
+                }
+            }
+        }
+
+        inline void operator()(char* data, std::size_t from, std::size_t to) const
+        {
+            const auto record_size = std::size(pad_record);
+            for (auto offset = from; offset + record_size <= to; offset += record_size)
+            {
+                if (previous and offset >= record_size)
+                    std::memcpy(data + offset, data + offset - record_size, record_size);
+                else
+                    std::memcpy(data + offset, pad_record.data(), record_size);
+            }
+        }
+    };
+
     template <typename cdf_version_tag_t, typename stream_t>
     void load_var_data(stream_t& stream, char* data, std::size_t data_len, std::size_t& pos,
         const cdf_VXR_t<cdf_version_tag_t>& vxr, uint32_t record_size,
-        const cdf_compression_type compression_type)
+        const cdf_compression_type compression_type, const virtual_records_filler& fill_gap)
     {
         for (auto i = 0UL; i < vxr.NusedEntries; i++)
         {
             int record_count = vxr.Last.values[i] - vxr.First.values[i] + 1;
+            if (const auto first = std::min(
+                    static_cast<std::size_t>(vxr.First.values[i]) * record_size, data_len);
+                first > pos)
+            {
+                fill_gap(data, pos, first);
+                pos = first;
+            }
 
             if (cdf_mutable_variable_record_t<cdf_version_tag_t> cvvr_or_vvr {};
                 load_mut_record(cvvr_or_vvr, stream, vxr.Offset.values[i]))
@@ -159,16 +280,16 @@ namespace
                         load_vvr_data<cdf_version_tag_t, stream_t>(
                             stream, offset, vvr, record_count, record_size, pos, data, data_len);
                     },
-                    [&stream, &data, data_len, &pos, record_size, compression_type](
+                    [&stream, &data, data_len, &pos, record_size, compression_type, &fill_gap](
                         vxr_t vxr) -> void
                     {
-                        load_var_data<cdf_version_tag_t, stream_t>(
-                            stream, data, data_len, pos, vxr, record_size, compression_type);
+                        load_var_data<cdf_version_tag_t, stream_t>(stream, data, data_len, pos,
+                            vxr, record_size, compression_type, fill_gap);
                         while (vxr.VXRnext)
                         {
                             load_record(vxr, stream, vxr.VXRnext);
-                            load_var_data<cdf_version_tag_t, stream_t>(
-                                stream, data, data_len, pos, vxr, record_size, compression_type);
+                            load_var_data<cdf_version_tag_t, stream_t>(stream, data, data_len,
+                                pos, vxr, record_size, compression_type, fill_gap);
                         }
                     },
                     [&stream, &data, data_len, &pos, record_count, record_size, compression_type](
@@ -187,26 +308,28 @@ namespace
 
     template <typename VDR_t, typename stream_t>
     data_t load_var_data(stream_t& stream, const VDR_t& vdr, const uint32_t record_size,
-        const uint32_t record_count, const cdf_compression_type compression_type)
+        const uint32_t record_count, const cdf_compression_type compression_type,
+        cdf_encoding encoding, const std::shared_ptr<monotonic_arena>& arena)
     {
-        data_t data = new_data_container(
-            static_cast<std::size_t>(record_count) * static_cast<std::size_t>(record_size),
-            vdr.DataType);
+        const auto data_len
+            = static_cast<std::size_t>(record_count) * static_cast<std::size_t>(record_size);
+        data_t data = new_data_container(data_len, vdr.DataType, arena);
         std::size_t pos { 0UL };
         cdf_VXR_t<typename VDR_t::cdf_version_t> vxr;
+        const virtual_records_filler fill_gap { vdr, record_size, encoding };
 
         if (vdr.VXRhead != 0 && load_record(vxr, stream, vdr.VXRhead))
         {
-            load_var_data(stream, data.bytes_ptr(), record_count * record_size, pos, vxr,
-                record_size, compression_type);
+            load_var_data(stream, data.bytes_ptr(), data_len, pos, vxr, record_size,
+                compression_type, fill_gap);
             if (vxr.VXRnext)
             {
                 do
                 {
                     if (load_record(vxr, stream, vxr.VXRnext))
                     {
-                        load_var_data(stream, data.bytes_ptr(), record_count * record_size, pos,
-                            vxr, record_size, compression_type);
+                        load_var_data(stream, data.bytes_ptr(), data_len, pos, vxr, record_size,
+                            compression_type, fill_gap);
                     }
                     else
                     {
@@ -215,21 +338,145 @@ namespace
                 } while (vxr.VXRnext != 0);
             }
         }
+        if (pos < data_len)
+            fill_gap(data.bytes_ptr(), pos, data_len);
         return data;
     }
 
 
+    template <typename cdf_version_tag_t, typename stream_t>
+    [[nodiscard]] bool collect_raw_blocks(stream_t& stream, std::size_t vxr_offset,
+        uint32_t record_size, std::vector<raw_data_block>& blocks)
+    {
+        cdf_VXR_t<cdf_version_tag_t> vxr;
+        while (vxr_offset != 0)
+        {
+            if (not load_record(vxr, stream, vxr_offset))
+                return false;
+            for (auto i = 0UL; i < vxr.NusedEntries; i++)
+            {
+                const auto offset = static_cast<std::size_t>(vxr.Offset.values[i]);
+                const std::size_t first = vxr.First.values[i];
+                const std::size_t last = vxr.Last.values[i];
+                cdf_DR_header<cdf_version_tag_t, cdf_record_type::UIR> header;
+                if (not load_record(header, stream, offset))
+                    return false;
+                switch (header.record_type)
+                {
+                    case cdf_record_type::VVR:
+                        blocks.push_back({ first, last, false,
+                            stream.view(offset + sizeof(header.record_size)
+                                + sizeof(header.record_type)),
+                            (last - first + 1) * record_size });
+                        break;
+                    case cdf_record_type::CVVR:
+                    {
+                        cdf_CVVR_t<cdf_version_tag_t, table_view_field> cvvr;
+                        if (not load_record(cvvr, stream, offset))
+                            return false;
+                        blocks.push_back({ first, last, true, cvvr.data.values.data(),
+                            std::size(cvvr.data.values) });
+                        break;
+                    }
+                    case cdf_record_type::VXR:
+                        if (not collect_raw_blocks<cdf_version_tag_t>(
+                                stream, offset, record_size, blocks))
+                            return false;
+                        break;
+                    default:
+                        return false;
+                }
+            }
+            vxr_offset = static_cast<std::size_t>(vxr.VXRnext);
+        }
+        return true;
+    }
+
+    // marks the records indexed by the VXR tree as stored
+    template <typename cdf_version_tag_t, typename stream_t>
+    [[nodiscard]] bool collect_stored_records(
+        stream_t& stream, std::size_t vxr_offset, std::vector<bool>& missing)
+    {
+        cdf_VXR_t<cdf_version_tag_t> vxr;
+        while (vxr_offset != 0)
+        {
+            if (not load_record(vxr, stream, vxr_offset))
+                return false;
+            for (auto i = 0UL; i < vxr.NusedEntries; i++)
+            {
+                const auto offset = static_cast<std::size_t>(vxr.Offset.values[i]);
+                cdf_DR_header<cdf_version_tag_t, cdf_record_type::UIR> header;
+                if (not load_record(header, stream, offset))
+                    return false;
+                if (header.record_type == cdf_record_type::VXR)
+                {
+                    if (not collect_stored_records<cdf_version_tag_t>(stream, offset, missing))
+                        return false;
+                    continue;
+                }
+                const auto last = std::min(
+                    static_cast<std::size_t>(vxr.Last.values[i]) + 1, std::size(missing));
+                for (auto record = static_cast<std::size_t>(vxr.First.values[i]); record < last;
+                     record++)
+                    missing[record] = false;
+            }
+            vxr_offset = static_cast<std::size_t>(vxr.VXRnext);
+        }
+        return true;
+    }
+
+    // records of a sparse variable missing from its VXR tree, empty when the tree can't be read
+    template <typename cdf_version_tag_t, typename stream_t, typename VDR_t>
+    [[nodiscard]] std::vector<bool> missing_records(
+        stream_t& stream, const VDR_t& vdr, uint32_t record_count)
+    {
+        std::vector<bool> missing(record_count, true);
+        if (vdr.VXRhead != 0
+            and not collect_stored_records<cdf_version_tag_t>(
+                stream, static_cast<std::size_t>(vdr.VXRhead), missing))
+            return {};
+        return missing;
+    }
+
+    /*
+     * Sparse variables are given back their pad value and, once read by missing_records, the
+     * records they were missing so saving them again leaves the same records out.
+     */
+    template <typename VDR_t>
+    [[nodiscard]] sparse_records_t sparse_records(const VDR_t& vdr, cdf_encoding encoding)
+    {
+        sparse_records_t sparse { false, {}, 1, vdr.SRecords == 2, std::nullopt };
+        if (const auto& pad = vdr.PadValues.values; std::size(pad) != 0)
+        {
+            sparse.pad_value = no_init_vector<char>(std::cbegin(pad), std::cend(pad));
+            const auto type_size = std::min(cdf_type_size(vdr.DataType), std::size_t { 8 });
+            if (type_size > 1
+                and endianness::is_big_endian_encoding(encoding) != host_is_big_endian)
+            {
+                auto& value = *sparse.pad_value;
+                for (auto offset = 0UL; offset + type_size <= std::size(value); offset += type_size)
+                    std::reverse(value.data() + offset, value.data() + offset + type_size);
+            }
+        }
+        return sparse;
+    }
+
     template <bool iso_8859_1_to_utf8, typename stream_t, typename VDR_t>
     struct defered_variable_loader
     {
-        defered_variable_loader(stream_t stream, cdf_encoding encoding, VDR_t vdr,
-            uint32_t record_count, uint32_t record_size, cdf_compression_type compression)
+        defered_variable_loader(stream_t stream, cdf_encoding encoding, cdf_majority majority,
+            VDR_t vdr, uint32_t record_count, uint32_t record_size,
+            cdf_compression_type compression, int compression_level,
+            std::shared_ptr<monotonic_arena> arena)
                 : p_stream { stream }
                 , p_encoding { encoding }
+                , p_majority { majority }
                 , p_vdr { vdr }
                 , p_record_count { record_count }
                 , p_record_size { record_size }
                 , p_compression { compression }
+                , p_compression_level { compression_level }
+                , p_arena { std::move(arena) }
         {
         }
 
@@ -237,17 +484,53 @@ namespace
         {
             return load_values<iso_8859_1_to_utf8>(
                 load_var_data(this->p_stream, this->p_vdr, this->p_record_size,
-                    this->p_record_count, p_compression),
+                    this->p_record_count, p_compression, p_encoding, p_arena),
                 this->p_encoding);
         }
 
+        /*
+         * Blocks are only reported when loading would just concatenate them: records stored past
+         * MaxRec in the last VVR are trimmed, gaps or converted strings make it give up.
+         */
+        [[nodiscard]] std::optional<raw_data> raw() const
+        {
+            if (iso_8859_1_to_utf8 and is_string(p_vdr.DataType))
+                return std::nullopt;
+            raw_data raw { p_encoding, p_majority, p_compression, p_compression_level, {} };
+            auto stream = p_stream;
+            if (p_vdr.VXRhead != 0
+                and not collect_raw_blocks<typename VDR_t::cdf_version_t>(
+                    stream, static_cast<std::size_t>(p_vdr.VXRhead), p_record_size, raw.blocks))
+                return std::nullopt;
+            std::size_t next_record = 0UL;
+            for (auto& block : raw.blocks)
+            {
+                if (block.first_record != next_record or next_record == p_record_count)
+                    return std::nullopt;
+                if (block.last_record >= p_record_count)
+                {
+                    if (block.compressed)
+                        return std::nullopt;
+                    block.last_record = p_record_count - 1;
+                    block.size = (block.last_record - block.first_record + 1) * p_record_size;
+                }
+                next_record = block.last_record + 1;
+            }
+            if (next_record != p_record_count)
+                return std::nullopt;
+            return raw;
+        }
+
     private:
         stream_t p_stream;
         cdf_encoding p_encoding;
+        cdf_majority p_majority;
         VDR_t p_vdr;
         uint32_t p_record_count;
         uint32_t p_record_size;
         cdf_compression_type p_compression;
+        int p_compression_level;
+        std::shared_ptr<monotonic_arena> p_arena;
     };
 
     template <cdf_r_z type, typename cdf_version_tag_t, bool iso_8859_1_to_utf8, typename context_t>
@@ -258,19 +541,24 @@ namespace
             {
                 const auto& [offset, vdr] = blk;
                 {
-                    auto shape = get_variable_dimensions<type>(vdr, context);
+                    auto shape = get_variable_dimensions<type>(vdr, context, cdf.arena);
                     const uint32_t record_size = var_record_size(shape, vdr.DataType);
                     const auto is_nrv = common::is_nrv(vdr);
-                    const auto compression_type = [&, &stream = context, &vdr = vdr]()
+                    // codec and gzip level, the level is only used to decide if raw blocks
+                    // can be copied as is when saving
+                    using compression_t = std::pair<cdf_compression_type, int>;
+                    const auto [compression_type, compression_level]
+                        = [&, &stream = context, &vdr = vdr]() -> compression_t
                     {
                         if (common::is_compressed(vdr))
                         {
                             if (cdf_CPR_t<cdf_version_tag_t> CPR;
                                 vdr.CPRorSPRoffset != static_cast<decltype(vdr.CPRorSPRoffset)>(-1)
                                 && load_record(CPR, stream, vdr.CPRorSPRoffset))
-                                return CPR.cType;
+                                return { CPR.cType,
+                                    CPR.pCount > 0 ? static_cast<int>(CPR.cParms.values[0]) : 0 };
                         }
-                        return cdf_compression_type::no_compression;
+                        return { cdf_compression_type::no_compression, 0 };
                     }();
                     const uint32_t record_count = [is_nrv, MaxRec = vdr.MaxRec]() -> uint32_t
                     {
@@ -289,11 +577,13 @@ namespace
                     /*}*/
                     if (lazy_load)
                     {
+                        const auto loader = defered_variable_loader<iso_8859_1_to_utf8,
+                            decltype(context.buffer), std::decay_t<decltype(vdr)>> {
+                            context.buffer, context.encoding(), context.majority, vdr,
+                            record_count, record_size, compression_type, compression_level,
+                            cdf.arena };
                         common::add_lazy_variable(cdf, vdr.Name.value, vdr.Num,
-                            lazy_data { defered_variable_loader<iso_8859_1_to_utf8,
-                                            decltype(context.buffer), decltype(vdr)> {
-                                            context.buffer, context.encoding(), vdr, record_count,
-                                            record_size, compression_type },
+                            lazy_data { loader, [loader]() { return loader.raw(); },
                                 vdr.DataType },
                             std::move(shape), is_nrv, compression_type);
                     }
@@ -302,10 +592,18 @@ namespace
                         common::add_variable(cdf, vdr.Name.value, vdr.Num,
                             load_values<iso_8859_1_to_utf8>(
                                 load_var_data(context.buffer, vdr, record_size, record_count,
-                                    compression_type),
+                                    compression_type, context.encoding(), cdf.arena),
                                 context.encoding()),
                             std::move(shape), is_nrv, compression_type);
                     }
+                    if (vdr.SRecords != 0 and not is_nrv)
+                        cdf.variables[vdr.Name.value].set_lazy_sparse_records(
+                            sparse_records(vdr, context.encoding()),
+                            [stream = context.buffer, vdr = vdr, record_count]() mutable
+                            {
+                                return missing_records<cdf_version_tag_t>(
+                                    stream, vdr, record_count);
+                            });
                 }
             });
         return true;
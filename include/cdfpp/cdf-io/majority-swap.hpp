@@ -23,13 +23,22 @@
 #include "../cdf-debug.hpp"
 #include "../cdf-data.hpp"
 #include "../no_init_vector.hpp"
+#include "parallel.hpp"
 #include <algorithm>
 #include <cstdint>
 #include <cstring>
+#include <map>
+#include <memory>
+#include <mutex>
 #include <numeric>
 #include <variant>
 #include <vector>
 
+#if defined(__SSE2__) || defined(_M_X64)
+#include <emmintrin.h>
+#define CDFPP_SSE2_TRANSPOSE
+#endif
+
 namespace cdf
 {
 namespace _private
@@ -82,6 +91,223 @@ namespace _private
         return access_patern;
     }
 
+    // per shape cache, string variables keep using a flat access pattern
+    inline std::shared_ptr<const std::vector<index_swap_pair>> cached_access_pattern(
+        const std::vector<std::size_t>& record_shape)
+    {
+        static std::mutex cache_mutex;
+        static std::map<std::vector<std::size_t>,
+            std::shared_ptr<const std::vector<index_swap_pair>>>
+            cache;
+        std::lock_guard<std::mutex> lock { cache_mutex };
+        if (auto it = cache.find(record_shape); it != std::end(cache))
+            return it->second;
+        if (std::size(cache) >= 64)
+            cache.clear();
+        auto pattern = std::make_shared<const std::vector<index_swap_pair>>(
+            generate_access_pattern(record_shape));
+        cache.emplace(record_shape, pattern);
+        return pattern;
+    }
+
+    /*
+     * Column to row major swap of a record is a reversal of its axes, the output element at
+     * (i_n-1, ..., i_0) is the input one at (i_0, ..., i_n-1). It is done as 2D transposes of
+     * the first and last axes, one per index of the middle axes. Transposes go by 8x8 tiles, few
+     * enough strided cache lines to avoid L1 set conflicts with power of two record shapes, and
+     * when SSE2 is available each tile is moved by blocks shuffled within registers.
+     */
+    inline constexpr std::size_t transpose_tile = 8;
+
+    template <typename T>
+    inline void transpose_scalar(const T* in, std::size_t in_stride, T* out, std::size_t out_stride,
+        std::size_t rows, std::size_t cols)
+    {
+        for (auto row = 0UL; row < rows; row++)
+            for (auto col = 0UL; col < cols; col++)
+                out[col * out_stride + row] = in[row * in_stride + col];
+    }
+
+#ifdef CDFPP_SSE2_TRANSPOSE
+    template <typename T>
+    inline constexpr std::size_t register_block = 16 / sizeof(T);
+
+    template <typename T>
+    inline constexpr bool has_register_block
+        = sizeof(T) == 2 or sizeof(T) == 4 or sizeof(T) == 8;
+
+    // register_block x register_block transpose, interleaving rows by pairs at growing widths
+    template <typename T>
+    inline void transpose_register_block(
+        const T* in, std::size_t in_stride, T* out, std::size_t out_stride)
+    {
+        constexpr auto block = register_block<T>;
+        __m128i rows[block];
+        for (auto row = 0UL; row < block; row++)
+            rows[row] = _mm_loadu_si128(reinterpret_cast<const __m128i*>(in + row * in_stride));
+        if constexpr (sizeof(T) == 2)
+        {
+            __m128i pairs[8];
+            for (auto i = 0UL; i < 4; i++)
+            {
+                pairs[i] = _mm_unpacklo_epi16(rows[2 * i], rows[2 * i + 1]);
+                pairs[i + 4] = _mm_unpackhi_epi16(rows[2 * i], rows[2 * i + 1]);
+            }
+            // pairs: 0-3 hold columns 0-3 of rows pairs 0-3, 4-7 their columns 4-7
+            for (auto half = 0UL; half < 2; half++)
+            {
+                const auto* p = pairs + 4 * half;
+                rows[4 * half] = _mm_unpacklo_epi32(p[0], p[1]);
+                rows[4 * half + 1] = _mm_unpackhi_epi32(p[0], p[1]);
+                rows[4 * half + 2] = _mm_unpacklo_epi32(p[2], p[3]);
+                rows[4 * half + 3] = _mm_unpackhi_epi32(p[2], p[3]);
+            }
+            for (auto i = 0UL; i < 2; i++)
+            {
+                pairs[4 * i] = _mm_unpacklo_epi64(rows[4 * i], rows[4 * i + 2]);
+                pairs[4 * i + 1] = _mm_unpackhi_epi64(rows[4 * i], rows[4 * i + 2]);
+                pairs[4 * i + 2] = _mm_unpacklo_epi64(rows[4 * i + 1], rows[4 * i + 3]);
+                pairs[4 * i + 3] = _mm_unpackhi_epi64(rows[4 * i + 1], rows[4 * i + 3]);
+            }
+            for (auto col = 0UL; col < block; col++)
+                rows[col] = pairs[col];
+        }
+        else if constexpr (sizeof(T) == 4)
+        {
+            const auto t0 = _mm_unpacklo_epi32(rows[0], rows[1]);
+            const auto t1 = _mm_unpacklo_epi32(rows[2], rows[3]);
+            const auto t2 = _mm_unpackhi_epi32(rows[0], rows[1]);
+            const auto t3 = _mm_unpackhi_epi32(rows[2], rows[3]);
+            rows[0] = _mm_unpacklo_epi64(t0, t1);
+            rows[1] = _mm_unpackhi_epi64(t0, t1);
+            rows[2] = _mm_unpacklo_epi64(t2, t3);
+            rows[3] = _mm_unpackhi_epi64(t2, t3);
+        }
+        else
+        {
+            const auto t0 = _mm_unpacklo_epi64(rows[0], rows[1]);
+            rows[1] = _mm_unpackhi_epi64(rows[0], rows[1]);
+            rows[0] = t0;
+        }
+        for (auto col = 0UL; col < block; col++)
+            _mm_storeu_si128(reinterpret_cast<__m128i*>(out + col * out_stride), rows[col]);
+    }
+#endif
+
+    template <typename T>
+    inline void transpose_tile_block(const T* in, std::size_t in_stride, T* out,
+        std::size_t out_stride, std::size_t rows, std::size_t cols)
+    {
+#ifdef CDFPP_SSE2_TRANSPOSE
+        if constexpr (has_register_block<T>)
+        {
+            constexpr auto block = register_block<T>;
+            const auto block_rows = rows - rows % block;
+            const auto block_cols = cols - cols % block;
+            for (auto row = 0UL; row < block_rows; row += block)
+                for (auto col = 0UL; col < block_cols; col += block)
+                    transpose_register_block(in + row * in_stride + col, in_stride,
+                        out + col * out_stride + row, out_stride);
+            transpose_scalar(in + block_cols, in_stride, out + block_cols * out_stride,
+                out_stride, block_rows, cols - block_cols);
+            transpose_scalar(in + block_rows * in_stride, in_stride, out + block_rows, out_stride,
+                rows - block_rows, cols);
+            return;
+        }
+#endif
+        transpose_scalar(in, in_stride, out, out_stride, rows, cols);
+    }
+
+    // out[col * out_stride + row] = in[row * in_stride + col]
+    template <typename T>
+    inline void transpose_2d(const T* in, std::size_t in_stride, T* out, std::size_t out_stride,
+        std::size_t rows, std::size_t cols)
+    {
+        for (auto row = 0UL; row < rows; row += transpose_tile)
+            for (auto col = 0UL; col < cols; col += transpose_tile)
+                transpose_tile_block(in + row * in_stride + col, in_stride,
+                    out + col * out_stride + row, out_stride,
+                    std::min(transpose_tile, rows - row), std::min(transpose_tile, cols - col));
+    }
+
+    // strides computed once per variable then applied to each record
+    struct axes_reversal
+    {
+        std::vector<std::size_t> shape;
+        // row major strides of the input and of the reversed output
+        std::vector<std::size_t> in_strides;
+        std::vector<std::size_t> out_strides;
+
+        axes_reversal(const std::vector<std::size_t>& record_shape)
+                : shape { record_shape }
+                , in_strides(std::size(record_shape), 1UL)
+                , out_strides(std::size(record_shape), 1UL)
+        {
+            const auto dimensions = std::size(shape);
+            for (auto dim = 1UL; dim < dimensions; dim++)
+            {
+                const auto reversed_dim = dimensions - dim;
+                in_strides[reversed_dim - 1] = in_strides[reversed_dim] * shape[reversed_dim];
+                out_strides[dim] = out_strides[dim - 1] * shape[dim - 1];
+            }
+        }
+
+        template <typename T>
+        void operator()(const T* in, T* out) const
+        {
+            const auto dimensions = std::size(shape);
+            const auto rows = shape.front();
+            const auto cols = shape.back();
+            const auto in_stride = in_strides.front();
+            const auto out_stride = out_strides.back();
+            if (dimensions == 2)
+            {
+                transpose_2d(in, in_stride, out, out_stride, rows, cols);
+            }
+            else if (dimensions == 3)
+            {
+                // middle axis innermost, successive tiles are next to each other in memory
+                for (auto row = 0UL; row < rows; row += transpose_tile)
+                    for (auto col = 0UL; col < cols; col += transpose_tile)
+                        for (auto middle = 0UL; middle < shape[1]; middle++)
+                            transpose_tile_block(
+                                in + middle * in_strides[1] + row * in_stride + col, in_stride,
+                                out + middle * out_strides[1] + col * out_stride + row, out_stride,
+                                std::min(transpose_tile, rows - row),
+                                std::min(transpose_tile, cols - col));
+            }
+            else
+            {
+                // walks the middle axes like an odometer, keeping both offsets up to date
+                std::vector<std::size_t> index(dimensions, 0UL);
+                std::size_t in_offset = 0UL;
+                std::size_t out_offset = 0UL;
+                while (true)
+                {
+                    transpose_2d(
+                        in + in_offset, in_stride, out + out_offset, out_stride, rows, cols);
+                    auto dim = dimensions - 2;
+                    for (; dim > 0; dim--)
+                    {
+                        index[dim]++;
+                        in_offset += in_strides[dim];
+                        out_offset += out_strides[dim];
+                        if (index[dim] < shape[dim])
+                            break;
+                        in_offset -= index[dim] * in_strides[dim];
+                        out_offset -= index[dim] * out_strides[dim];
+                        index[dim] = 0;
+                    }
+                    if (dim == 0)
+                        return;
+                }
+            }
+        }
+    };
+
+    // below this many values per record tiles are mostly edges, a flat pattern is faster
+    inline constexpr std::size_t min_tiled_record_size = 64;
+
 }
 
 namespace majority
@@ -94,32 +320,62 @@ namespace majority
         // Basically a variable with shape=2 is a variable with 1D records
         if (dimensions > 2 or (is_string and dimensions > 2))
         {
-            const std::size_t records_count = is_string ? 1 : shape[0];
             const std::vector<std::size_t> record_shape(
                 std::cbegin(shape) + (is_string ? 0 : 1), std::cend(shape) - (is_string ? 1 : 0));
-            const auto access_patern = _private::generate_access_pattern(record_shape);
-
-            std::vector<typename data_t::value_type> temporary_record(
-                std::size(access_patern) * (is_string ? shape.back() : 1));
-
-            for (auto record = 0UL; record < records_count; record++)
+            if constexpr (is_string)
             {
-                auto offset = record * std::size(access_patern);
-                for (const auto& swap_pair : access_patern)
+                // strings are elements of shape.back() chars, the whole variable is one record
+                const std::size_t string_size = shape.back();
+                const auto access_patern = _private::cached_access_pattern(record_shape);
+                std::vector<char> temporary_record(std::size(*access_patern) * string_size);
+                for (const auto& swap_pair : *access_patern)
                 {
-                    if constexpr (is_string)
-                    {
-                        std::memcpy(temporary_record.data() + (swap_pair.src * shape.back()),
-                            data.data() + offset + (swap_pair.dest * shape.back()), shape.back());
-                    }
-                    else
-                    {
-                        temporary_record[swap_pair.src] = data[offset + swap_pair.dest];
-                    }
+                    std::memcpy(temporary_record.data() + (swap_pair.src * string_size),
+                        data.data() + (swap_pair.dest * string_size), string_size);
+                }
+                std::memcpy(data.data(), temporary_record.data(), std::size(temporary_record));
+            }
+            else
+            {
+                using value_t = typename data_t::value_type;
+                const std::size_t records_count = shape[0];
+                const auto record_size = std::accumulate(std::cbegin(record_shape),
+                    std::cend(record_shape), std::size_t { 1 }, std::multiplies<std::size_t>());
+
+                // records are independent, huge variables get them swapped by chunks on many
+                // threads
+                auto swap_records = [&](auto&& swap_record)
+                {
+                    io::parallel::for_each_chunk(records_count, record_size * sizeof(value_t),
+                        [&](std::size_t first_record, std::size_t count)
+                        {
+                            no_init_vector<value_t> temporary_record(record_size);
+                            for (auto record = first_record; record < first_record + count;
+                                 record++)
+                            {
+                                auto record_data = data.data() + record * record_size;
+                                swap_record(record_data, temporary_record.data());
+                                std::memcpy(record_data, temporary_record.data(),
+                                    record_size * sizeof(value_t));
+                            }
+                        });
+                };
+                if (record_size < _private::min_tiled_record_size)
+                {
+                    const auto access_patern = _private::cached_access_pattern(record_shape);
+                    swap_records(
+                        [&access_patern](const value_t* record, value_t* output)
+                        {
+                            for (const auto& swap_pair : *access_patern)
+                                output[swap_pair.src] = record[swap_pair.dest];
+                        });
+                }
+                else
+                {
+                    swap_records([reversal = _private::axes_reversal { record_shape }](
+                                     const value_t* record, value_t* output)
+                        { reversal(record, output); });
                 }
-                std::memcpy(data.data() + offset, temporary_record.data(),
-                    (is_string ? shape.back() : sizeof(typename data_t::value_type))
-                        * std::size(access_patern));
             }
         }
     }
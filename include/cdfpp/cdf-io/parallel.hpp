@@ -0,0 +1,310 @@
+#pragma once
+/*------------------------------------------------------------------------------
+-- This file is a part of the CDFpp library
+-- Copyright (C) 2022, Plasma Physics Laboratory - CNRS
+--
+-- This program is free software; you can redistribute it and/or modify
+-- it under the terms of the GNU General Public License as published by
+-- the Free Software Foundation; either version 2 of the License, or
+-- (at your option) any later version.
+--
+-- This program is distributed in the hope that it will be useful,
+-- but WITHOUT ANY WARRANTY; without even the implied warranty of
+-- MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+-- GNU General Public License for more details.
+--
+-- You should have received a copy of the GNU General Public License
+-- along with this program; if not, write to the Free Software
+-- Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA 02111-1307 USA
+-------------------------------------------------------------------------------*/
+/*-- Author : Alexis Jeandet
+-- Mail : alexis.jeandet@member.fsf.org
+----------------------------------------------------------------------------*/
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <deque>
+#include <exception>
+#include <functional>
+#include <limits>
+#include <memory>
+#include <mutex>
+#include <system_error>
+#include <thread>
+#include <vector>
+#if __has_include(<pthread.h>)
+#include <pthread.h>
+#endif
+
+namespace cdf::io::parallel
+{
+
+[[nodiscard]] inline std::size_t workers_count(std::size_t tasks_count)
+{
+    return std::min(
+        tasks_count, std::max(std::size_t { 1 }, std::size_t { std::thread::hardware_concurrency() }));
+}
+
+namespace _internal
+{
+    // set on the pool threads and on a thread running a parallel_for, nested calls run inline
+    inline thread_local bool in_parallel_region = false;
+
+    /*
+     * One thread less than the cores, the thread calling parallel_for being the last worker.
+     * Threads live as long as the process so that their thread_local codec contexts are reused
+     * from one call to the next. A forked child doesn't get the threads, it leaves the pool
+     * behind and starts its own on first use.
+     */
+    class worker_pool
+    {
+    public:
+        [[nodiscard]] static worker_pool& instance()
+        {
+            std::lock_guard<std::mutex> lock { instance_mutex() };
+            auto& pool = current();
+            if (not pool)
+            {
+                register_fork_handlers();
+                pool.reset(new worker_pool);
+            }
+            return *pool;
+        }
+
+        [[nodiscard]] std::size_t size() const noexcept { return std::size(p_threads); }
+
+        // owner tags the job so that it can be cancelled until a thread picks it
+        void submit(const void* owner, std::function<void()> job)
+        {
+            {
+                std::lock_guard<std::mutex> lock { p_mutex };
+                p_jobs.push_back({ owner, std::move(job) });
+            }
+            p_job_added.notify_one();
+        }
+
+        // removes the jobs of owner no thread has picked yet and returns how many they were
+        [[nodiscard]] std::size_t cancel(const void* owner)
+        {
+            std::lock_guard<std::mutex> lock { p_mutex };
+            const auto queued = std::size(p_jobs);
+            p_jobs.erase(std::remove_if(std::begin(p_jobs), std::end(p_jobs),
+                             [owner](const job_t& job) { return job.owner == owner; }),
+                std::end(p_jobs));
+            return queued - std::size(p_jobs);
+        }
+
+        ~worker_pool()
+        {
+            {
+                std::lock_guard<std::mutex> lock { p_mutex };
+                p_stopping = true;
+            }
+            p_job_added.notify_all();
+            for (auto& thread : p_threads)
+                thread.join();
+        }
+
+    private:
+        struct job_t
+        {
+            const void* owner;
+            std::function<void()> run;
+        };
+
+        [[nodiscard]] static std::mutex& instance_mutex()
+        {
+            static std::mutex mutex;
+            return mutex;
+        }
+
+        [[nodiscard]] static std::unique_ptr<worker_pool>& current()
+        {
+            static std::unique_ptr<worker_pool> pool;
+            return pool;
+        }
+
+        // both mutexes are held across fork() so that the child gets them in a known state
+        static void register_fork_handlers()
+        {
+#if __has_include(<pthread.h>)
+            [[maybe_unused]] static const bool registered = []()
+            {
+                return ::pthread_atfork(prepare_fork, resume_parent, resume_child) == 0;
+            }();
+#endif
+        }
+
+        static void prepare_fork()
+        {
+            instance_mutex().lock();
+            if (const auto& pool = current())
+                pool->p_mutex.lock();
+        }
+
+        static void resume_parent()
+        {
+            if (const auto& pool = current())
+                pool->p_mutex.unlock();
+            instance_mutex().unlock();
+        }
+
+        static void resume_child()
+        {
+            if (auto& pool = current())
+            {
+                pool->p_mutex.unlock();
+                // its threads only exist in the parent, it can't be joined nor destroyed
+                static_cast<void>(pool.release());
+            }
+            instance_mutex().unlock();
+        }
+
+        worker_pool()
+        {
+            const auto threads_count = workers_count(std::numeric_limits<std::size_t>::max()) - 1;
+            p_threads.reserve(threads_count);
+            for (auto i = 0UL; i < threads_count; i++)
+            {
+                try
+                {
+                    p_threads.emplace_back([this]() { run(); });
+                }
+                catch (const std::system_error&)
+                {
+                    // out of threads, the ones already started will do the work
+                    break;
+                }
+            }
+        }
+
+        void run()
+        {
+            in_parallel_region = true;
+            while (true)
+            {
+                std::function<void()> job;
+                {
+                    std::unique_lock<std::mutex> lock { p_mutex };
+                    p_job_added.wait(lock, [this]() { return p_stopping or not p_jobs.empty(); });
+                    if (p_jobs.empty())
+                        return;
+                    job = std::move(p_jobs.front().run);
+                    p_jobs.pop_front();
+                }
+                job();
+            }
+        }
+
+        std::vector<std::thread> p_threads;
+        std::deque<job_t> p_jobs;
+        std::mutex p_mutex;
+        std::condition_variable p_job_added;
+        bool p_stopping = false;
+    };
+}
+
+/*
+ * Runs function(i) for every i in [0, count) on the calling thread and on a lazily created pool
+ * of threads reused across calls, tasks are picked in order from a shared counter. Calls made
+ * from within a task run inline so nesting doesn't oversubscribe the cores. Helpers still queued
+ * behind other calls when the calling thread runs out of tasks are cancelled instead of waited
+ * for. The first exception thrown by a task stops the remaining ones from being started and is
+ * rethrown on the calling thread once all workers are done.
+ */
+template <typename function_t>
+void parallel_for(std::size_t count, function_t&& function, std::size_t max_workers = 0UL)
+{
+    auto workers = std::min(workers_count(count), max_workers ? max_workers : count);
+    if (workers > 1 and not _internal::in_parallel_region)
+        workers = std::min(workers, _internal::worker_pool::instance().size() + 1);
+    if (workers <= 1 or _internal::in_parallel_region)
+    {
+        for (auto i = 0UL; i < count; i++)
+            function(i);
+        return;
+    }
+    std::atomic<std::size_t> next { 0UL };
+    std::atomic<bool> failed { false };
+    std::exception_ptr error;
+    std::mutex mutex;
+    std::condition_variable helper_done;
+    std::size_t running_helpers = workers - 1;
+    auto worker = [&]()
+    {
+        for (auto i = next++; i < count and not failed; i = next++)
+        {
+            try
+            {
+                function(i);
+            }
+            catch (...)
+            {
+                std::lock_guard<std::mutex> lock { mutex };
+                if (not error)
+                    error = std::current_exception();
+                failed = true;
+            }
+        }
+    };
+    auto& pool = _internal::worker_pool::instance();
+    for (auto i = 1UL; i < workers; i++)
+    {
+        pool.submit(&next,
+            [&]()
+            {
+                worker();
+                std::lock_guard<std::mutex> lock { mutex };
+                if (--running_helpers == 0)
+                    helper_done.notify_one();
+            });
+    }
+    _internal::in_parallel_region = true;
+    worker();
+    _internal::in_parallel_region = false;
+    const auto cancelled_helpers = pool.cancel(&next);
+    {
+        // started helpers reference this frame, wait even for the ones that found no task left
+        std::unique_lock<std::mutex> lock { mutex };
+        running_helpers -= cancelled_helpers;
+        helper_done.wait(lock, [&]() { return running_helpers == 0; });
+    }
+    if (error)
+        std::rethrow_exception(error);
+}
+
+// below this size waking the workers costs more than an element-wise pass over the buffer
+inline constexpr std::size_t min_parallel_bytes = std::size_t { 32 } << 20;
+// small enough to stay in the L2 cache while a worker reads and writes it back
+inline constexpr std::size_t chunk_bytes = std::size_t { 512 } << 10;
+
+/*
+ * Runs function(first, count) over [0, items_count) split in chunks of about chunk_bytes, items
+ * being item_size bytes large. Buffers smaller than min_parallel_bytes are processed in a single
+ * call on the calling thread, exactly as a plain loop would.
+ */
+template <typename function_t>
+void for_each_chunk(std::size_t items_count, std::size_t item_size, function_t&& function,
+    std::size_t max_workers = 0UL)
+{
+    if (items_count == 0)
+        return;
+    if (items_count * item_size < min_parallel_bytes or max_workers == 1)
+    {
+        function(std::size_t { 0 }, items_count);
+        return;
+    }
+    const auto chunk_items = std::max(std::size_t { 1 }, chunk_bytes / item_size);
+    const auto chunks = (items_count + chunk_items - 1) / chunk_items;
+    parallel_for(
+        chunks,
+        [&](std::size_t chunk)
+        {
+            const auto first = chunk * chunk_items;
+            function(first, std::min(chunk_items, items_count - first));
+        },
+        max_workers);
+}
+
+}
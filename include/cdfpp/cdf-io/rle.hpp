@@ -25,83 +25,356 @@
 #include <algorithm>
 #include <cstdint>
 #include <cstring>
+#include <iterator>
 #include <vector>
 
+#if defined(__AVX2__) || defined(__SSE2__) || defined(_M_X64)
+#include <immintrin.h>
+#endif
+#if defined(_MSC_VER)
+#include <intrin.h>
+#endif
+
 namespace cdf::io::rle
 {
 namespace _internal
 {
+    // RLE0 only encodes runs of zeros as (0, count-1) pairs, a single pair covers at most 256
+    // zeros
+    static inline constexpr std::size_t max_run = 256;
 
-}
+    [[nodiscard]] inline unsigned int first_set_bit(uint32_t mask) noexcept
+    {
+#if defined(_MSC_VER)
+        unsigned long index;
+        _BitScanForward(&index, mask);
+        return static_cast<unsigned int>(index);
+#else
+        return static_cast<unsigned int>(__builtin_ctz(mask));
+#endif
+    }
 
-template <typename T>
-inline std::size_t inflate(const T& input, char* output, const std::size_t)
-{
-    auto output_cursor = output;
-    auto input_cursor = std::cbegin(input);
-    while (input_cursor != std::cend(input))
+    [[nodiscard]] inline unsigned int last_set_bit(uint32_t mask) noexcept
+    {
+#if defined(_MSC_VER)
+        unsigned long index;
+        _BitScanReverse(&index, mask);
+        return static_cast<unsigned int>(index);
+#else
+        return 31U - static_cast<unsigned int>(__builtin_clz(mask));
+#endif
+    }
+
+    [[nodiscard]] inline std::size_t pop_count(uint32_t mask) noexcept
     {
-        auto value = *input_cursor;
-        if (value == 0)
+#if defined(_MSC_VER)
+        return __popcnt(mask);
+#else
+        return static_cast<std::size_t>(__builtin_popcount(mask));
+#endif
+    }
+
+    [[nodiscard]] inline const char* find_zero(const char* begin, const char* end) noexcept
+    {
+#if defined(__AVX2__)
+        const __m256i zero = _mm256_setzero_si256();
+        for (; end - begin >= 32; begin += 32)
         {
-            input_cursor++;
-            std::size_t count = static_cast<unsigned char>(*input_cursor) + 1;
-            std::generate_n(output_cursor, count, []() constexpr { return 0; });
-            output_cursor += count;
+            const uint32_t mask = static_cast<uint32_t>(_mm256_movemask_epi8(_mm256_cmpeq_epi8(
+                _mm256_loadu_si256(reinterpret_cast<const __m256i*>(begin)), zero)));
+            if (mask != 0)
+                return begin + first_set_bit(mask);
+        }
+#elif defined(__SSE2__) || defined(_M_X64)
+        const __m128i zero = _mm_setzero_si128();
+        for (; end - begin >= 16; begin += 16)
+        {
+            const uint32_t mask = static_cast<uint32_t>(_mm_movemask_epi8(
+                _mm_cmpeq_epi8(_mm_loadu_si128(reinterpret_cast<const __m128i*>(begin)), zero)));
+            if (mask != 0)
+                return begin + first_set_bit(mask);
+        }
+#endif
+        if (begin == end)
+            return end;
+        if (auto found = static_cast<const char*>(std::memchr(begin, 0, end - begin)))
+            return found;
+        return end;
+    }
+
+    [[nodiscard]] inline const char* find_non_zero(const char* begin, const char* end) noexcept
+    {
+#if defined(__AVX2__)
+        const __m256i zero = _mm256_setzero_si256();
+        for (; end - begin >= 32; begin += 32)
+        {
+            const uint32_t mask = ~static_cast<uint32_t>(_mm256_movemask_epi8(_mm256_cmpeq_epi8(
+                _mm256_loadu_si256(reinterpret_cast<const __m256i*>(begin)), zero)));
+            if (mask != 0)
+                return begin + first_set_bit(mask);
+        }
+#elif defined(__SSE2__) || defined(_M_X64)
+        const __m128i zero = _mm_setzero_si128();
+        for (; end - begin >= 16; begin += 16)
+        {
+            const uint32_t mask = ~static_cast<uint32_t>(_mm_movemask_epi8(_mm_cmpeq_epi8(
+                                      _mm_loadu_si128(reinterpret_cast<const __m128i*>(begin)),
+                                      zero)))
+                & 0xFFFFu;
+            if (mask != 0)
+                return begin + first_set_bit(mask);
+        }
+#else
+        for (; end - begin >= 8; begin += 8)
+        {
+            uint64_t word;
+            std::memcpy(&word, begin, sizeof(word));
+            if (word != 0)
+                break;
+        }
+#endif
+        while (begin != end and *begin == 0)
+            begin++;
+        return begin;
+    }
+
+    /*
+     * Splits the input into literal segments and zero runs, this is shared by the size
+     * computation and the actual encoding so both always agree
+     */
+    template <typename literals_f, typename zeros_f>
+    inline void for_each_segment(
+        const char* begin, const char* end, literals_f&& on_literals, zeros_f&& on_zeros)
+    {
+        while (begin != end)
+        {
+            const char* zero = find_zero(begin, end);
+            if (zero != begin)
+                on_literals(begin, static_cast<std::size_t>(zero - begin));
+            if (zero == end)
+                return;
+            const char* non_zero = find_non_zero(zero, end);
+            on_zeros(static_cast<std::size_t>(non_zero - zero));
+            begin = non_zero;
+        }
+    }
+
+    [[nodiscard]] inline std::size_t encoded_run_size(std::size_t count) noexcept
+    {
+        return 2 * ((count + max_run - 1) / max_run);
+    }
+
+    inline char* write_run(char* output, std::size_t count) noexcept
+    {
+        while (count != 0)
+        {
+            const std::size_t run = std::min(count, max_run);
+            output[0] = 0;
+            output[1] = static_cast<char>(static_cast<unsigned char>(run - 1));
+            output += 2;
+            count -= run;
         }
-        else
+        return output;
+    }
+
+    [[nodiscard]] inline std::size_t deflated_size(const char* begin, const char* end) noexcept
+    {
+        std::size_t output_size = 0;
+#if defined(__SSE2__) || defined(_M_X64)
+        // counts zero bytes and zero runs 16 bytes at a time, a run still open at the end of a
+        // chunk is carried over since it is the only one that can need several pairs
+        const char* const start = begin;
+        std::size_t zeros = 0, pairs = 0, open_run = 0;
+        const __m128i zero = _mm_setzero_si128();
+        for (; end - begin >= 16; begin += 16)
         {
-            *output_cursor = value;
-            output_cursor++;
+            const uint32_t mask = static_cast<uint32_t>(_mm_movemask_epi8(
+                _mm_cmpeq_epi8(_mm_loadu_si128(reinterpret_cast<const __m128i*>(begin)), zero)));
+            if (mask == 0xFFFFu)
+            {
+                open_run += 16;
+                continue;
+            }
+            const uint32_t leading = first_set_bit(~mask);
+            const uint32_t trailing = 15 - last_set_bit(~mask & 0xFFFFu);
+            open_run += leading;
+            if (open_run != 0)
+            {
+                pairs += (open_run + max_run - 1) / max_run;
+                zeros += open_run;
+            }
+            const uint32_t inner
+                = mask & ~((1u << leading) - 1u) & ((1u << (16 - trailing)) - 1u);
+            pairs += pop_count(inner & ~(inner << 1));
+            zeros += pop_count(inner);
+            open_run = trailing;
         }
-        input_cursor++;
+        if (open_run != 0)
+        {
+            const char* run_end = find_non_zero(begin, end);
+            open_run += static_cast<std::size_t>(run_end - begin);
+            pairs += (open_run + max_run - 1) / max_run;
+            zeros += open_run;
+            begin = run_end;
+        }
+        output_size = static_cast<std::size_t>(begin - start) - zeros + 2 * pairs;
+#endif
+        for_each_segment(
+            begin, end, [&output_size](const char*, std::size_t count) { output_size += count; },
+            [&output_size](std::size_t count) { output_size += encoded_run_size(count); });
+        return output_size;
     }
-    return output_cursor - output;
 }
 
 template <typename T>
-inline void _deflate_copy(const T* input, std::size_t count, no_init_vector<char>& dest)
+inline std::size_t inflate(const T& input, char* output, const std::size_t output_size)
 {
-    if (count)
+    using namespace _internal;
+    const char* input_cursor = reinterpret_cast<const char*>(std::data(input));
+    const char* const input_end = input_cursor + std::size(input);
+    char* output_cursor = output;
+    char* const output_end = output + output_size;
+#if defined(__SSE2__) || defined(_M_X64)
+    // fast path, literals and zeros are written 16 bytes at a time and may spill past the
+    // decoded bytes, this is fine as long as there is enough room for a full run and a chunk
+    {
+        const __m128i zero = _mm_setzero_si128();
+        while (input_end - input_cursor >= 16
+            and output_end - output_cursor >= static_cast<std::ptrdiff_t>(max_run + 16))
+        {
+            const __m128i chunk = _mm_loadu_si128(reinterpret_cast<const __m128i*>(input_cursor));
+            const uint32_t mask
+                = static_cast<uint32_t>(_mm_movemask_epi8(_mm_cmpeq_epi8(chunk, zero)));
+            _mm_storeu_si128(reinterpret_cast<__m128i*>(output_cursor), chunk);
+            if (mask == 0)
+            {
+                input_cursor += 16;
+                output_cursor += 16;
+                continue;
+            }
+            const auto literals = first_set_bit(mask);
+            input_cursor += literals;
+            output_cursor += literals;
+            if (literals == 15)
+                break; // the run length lives in the next chunk
+            const std::size_t count = static_cast<unsigned char>(input_cursor[1]) + 1UL;
+            for (std::size_t i = 0; i < count; i += 16)
+                _mm_storeu_si128(reinterpret_cast<__m128i*>(output_cursor + i), zero);
+            output_cursor += count;
+            input_cursor += 2;
+        }
+    }
+#endif
+    while (input_cursor != input_end)
     {
-        const auto sz = std::size(dest);
-        dest.resize(sz + count);
-        std::memcpy(dest.data() + sz, input, count);
+        const char* zero = find_zero(input_cursor, input_end);
+        const std::size_t literals = static_cast<std::size_t>(zero - input_cursor);
+        if (literals > static_cast<std::size_t>(output_end - output_cursor))
+            return 0;
+        std::memcpy(output_cursor, input_cursor, literals);
+        output_cursor += literals;
+        if (zero == input_end)
+            break;
+        if (input_end - zero < 2)
+            return 0;
+        const std::size_t count = static_cast<unsigned char>(zero[1]) + 1UL;
+        if (count > static_cast<std::size_t>(output_end - output_cursor))
+            return 0;
+        std::memset(output_cursor, 0, count);
+        output_cursor += count;
+        input_cursor = zero + 2;
     }
+    return static_cast<std::size_t>(output_cursor - output);
 }
 
 template <typename T>
 inline no_init_vector<char> deflate(const T& input)
 {
-    no_init_vector<char> result;
-    result.reserve(std::size(input));
-    auto input_cursor = std::cbegin(input);
-    auto last_copy_cursor = std::cbegin(input);
-    while (input_cursor != std::cend(input))
+    using namespace _internal;
+    const char* input_cursor = reinterpret_cast<const char*>(std::data(input));
+    const char* const input_end = input_cursor + std::size(input);
+    no_init_vector<char> result(deflated_size(input_cursor, input_end));
+    char* output_cursor = result.data();
+    char* const output_end = output_cursor + std::size(result);
+#if defined(__SSE2__) || defined(_M_X64)
     {
-        auto value = *input_cursor;
-        if (value == 0)
+        const __m128i zero = _mm_setzero_si128();
+        while (input_end - input_cursor >= 16 and output_end - output_cursor >= 16)
         {
-            _deflate_copy(input.data() + (last_copy_cursor - std::cbegin(input)),
-                input_cursor - last_copy_cursor, result);
-            auto z_count = 0UL;
-            do
+            const __m128i chunk = _mm_loadu_si128(reinterpret_cast<const __m128i*>(input_cursor));
+            const uint32_t mask
+                = static_cast<uint32_t>(_mm_movemask_epi8(_mm_cmpeq_epi8(chunk, zero)));
+            // the output is exactly sized, bytes written past the literals are overwritten
+            // by what follows
+            _mm_storeu_si128(reinterpret_cast<__m128i*>(output_cursor), chunk);
+            if (mask == 0)
             {
-                input_cursor++;
-                z_count++;
-            } while (input_cursor != std::cend(input) and *input_cursor == 0);
-            last_copy_cursor = input_cursor;
-            result.push_back(0);
-            result.push_back(z_count-1);
-        }
-        else
-        {
-            input_cursor++;
+                input_cursor += 16;
+                output_cursor += 16;
+                continue;
+            }
+            const auto literals = first_set_bit(mask);
+            input_cursor += literals;
+            output_cursor += literals;
+            const char* run_end = find_non_zero(input_cursor, input_end);
+            output_cursor = write_run(output_cursor, static_cast<std::size_t>(run_end - input_cursor));
+            input_cursor = run_end;
         }
     }
-    _deflate_copy(input.data() + (last_copy_cursor - std::cbegin(input)),
-        input_cursor - last_copy_cursor, result);
+#endif
+    for_each_segment(
+        input_cursor, input_end,
+        [&output_cursor](const char* literals, std::size_t count)
+        {
+            std::memcpy(output_cursor, literals, count);
+            output_cursor += count;
+        },
+        [&output_cursor](std::size_t count) { output_cursor = write_run(output_cursor, count); });
     return result;
 }
 
+/*
+ * Incremental encoder producing the same output as deflate over the concatenation of all the
+ * written chunks. Literals are forwarded to the sink as is, zero runs may span several chunks
+ * and are only emitted once they end.
+ */
+class deflate_stream
+{
+    std::size_t p_pending_zeros = 0UL;
+
+    template <typename sink_t>
+    void flush_zeros(sink_t& sink)
+    {
+        char encoded[2 * _internal::max_run];
+        while (p_pending_zeros != 0UL)
+        {
+            const auto count = std::min(p_pending_zeros, _internal::max_run * _internal::max_run);
+            const char* end = _internal::write_run(encoded, count);
+            sink(encoded, static_cast<std::size_t>(end - encoded));
+            p_pending_zeros -= count;
+        }
+    }
+
+public:
+    // sink is called as sink(const char* data, std::size_t size) with encoded bytes
+    template <typename sink_t>
+    void write(const char* data, std::size_t size, sink_t&& sink)
+    {
+        _internal::for_each_segment(
+            data, data + size,
+            [this, &sink](const char* literals, std::size_t count)
+            {
+                flush_zeros(sink);
+                sink(literals, count);
+            },
+            [this](std::size_t count) { p_pending_zeros += count; });
+    }
+
+    template <typename sink_t>
+    void finish(sink_t&& sink)
+    {
+        flush_zeros(sink);
+    }
+};
+
 }
@@ -29,7 +29,20 @@
 #include <iostream>
 #include <numeric>
 #include <optional>
+#include <stdexcept>
+#include <string>
+#include <tuple>
 #include <utility>
+#include <vector>
+
+#if __has_include(<sys/uio.h>)
+#include <cerrno>
+#include <climits>
+#include <fcntl.h>
+#include <sys/uio.h>
+#include <unistd.h>
+#define USE_PWRITEV
+#endif
 
 namespace cdf::io::buffers
 {
@@ -42,6 +55,9 @@ struct vector_writer
 
     std::size_t write(const char* const data_ptr, std::size_t count)
     {
+        // empty values may come with a null pointer, memcpy must not see it
+        if (count == 0)
+            return global_offset;
         data.resize(global_offset + count);
         memcpy(data.data() + global_offset, data_ptr, count);
         global_offset += count;
@@ -50,23 +66,53 @@ struct vector_writer
 
     std::size_t fill(const char v, std::size_t count)
     {
+        if (count == 0)
+            return global_offset;
         data.resize(global_offset + count);
         memset(data.data() + global_offset, v, count);
         global_offset += count;
         return global_offset;
     }
 
+    // overwrites already written bytes, used to back-patch records
+    void write_at(std::size_t offset, const char* const data_ptr, std::size_t count)
+    {
+        if (count != 0)
+            memcpy(data.data() + offset, data_ptr, count);
+    }
+
+    bool flush() { return true; }
+
     [[nodiscard]] std::size_t offset() const noexcept { return this->global_offset; }
 };
 
 struct file_writer
 {
+    enum class open_mode
+    {
+        truncate,
+        // keeps the existing content, writes are appended at the end of the file
+        update
+    };
+
     std::fstream os;
     std::size_t global_offset;
-    file_writer(const std::string& fname) : global_offset { 0 }
+    file_writer(const std::string& fname, open_mode mode = open_mode::truncate)
+            : global_offset { 0 }
     {
-        this->os
-            = std::fstream(fname, std::fstream::out | std::fstream::binary | std::fstream::trunc);
+        if (mode == open_mode::truncate)
+        {
+            this->os = std::fstream(
+                fname, std::fstream::out | std::fstream::binary | std::fstream::trunc);
+        }
+        else
+        {
+            this->os = std::fstream(
+                fname, std::fstream::in | std::fstream::out | std::fstream::binary);
+            this->os.seekp(0, std::ios_base::end);
+            if (this->os)
+                global_offset = static_cast<std::size_t>(this->os.tellp());
+        }
     }
     ~file_writer()
     {
@@ -79,6 +125,21 @@ struct file_writer
 
     [[nodiscard]] bool is_open() const noexcept { return os.is_open(); }
 
+    // false once anything failed to be written
+    bool flush()
+    {
+        os.flush();
+        return not os.fail();
+    }
+
+    [[nodiscard]] bool good() const noexcept { return not os.fail(); }
+
+    void close()
+    {
+        os.flush();
+        os.close();
+    }
+
     std::size_t write(const char* const data_ptr, std::size_t count)
     {
         os.write(data_ptr, count);
@@ -94,6 +155,305 @@ struct file_writer
         return global_offset;
     }
 
+    // overwrites already written bytes, used to back-patch records
+    void write_at(std::size_t offset, const char* const data_ptr, std::size_t count)
+    {
+        os.seekp(static_cast<std::streamoff>(offset));
+        os.write(data_ptr, count);
+        os.seekp(0, std::ios_base::end);
+    }
+
+    [[nodiscard]] std::size_t offset() const noexcept { return this->global_offset; }
+};
+
+#ifdef USE_PWRITEV
+/*
+ * Gathers writes and sends them to the file with pwritev. Small writes such as record fields are
+ * copied into an arena while large ones (variable values) are referenced in place, they must stay
+ * valid until the next flush. Nothing is guaranteed to be written before flush() is called, a
+ * failed write makes it and every later flush return false without throwing.
+ * Since writes are positional, several writers can share the same file descriptor as long as they
+ * write to distinct ranges.
+ */
+struct vectored_file_writer
+{
+    static inline constexpr std::size_t copy_threshold = 1 << 14;
+    static inline constexpr std::size_t arena_size = 1 << 20;
+#ifdef IOV_MAX
+    static inline constexpr std::size_t max_iovecs = IOV_MAX;
+#else
+    static inline constexpr std::size_t max_iovecs = 1024;
+#endif
+
+    struct segment
+    {
+        const char* data; // nullptr when the bytes live in the arena
+        std::size_t arena_offset;
+        std::size_t size;
+    };
+
+    int fd = -1;
+    bool owns_fd = true;
+    bool failed = false;
+    std::size_t global_offset = 0UL;
+    std::size_t file_offset = 0UL;
+    no_init_vector<char> arena;
+    std::vector<segment> segments;
+
+    vectored_file_writer(const std::string& fname)
+    {
+        fd = ::open(fname.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+        arena.reserve(arena_size);
+    }
+
+    // writes to an already opened file starting at offset, the file stays open on destruction
+    vectored_file_writer(int fd, std::size_t offset)
+            : fd { fd }, owns_fd { false }, global_offset { offset }, file_offset { offset }
+    {
+    }
+
+    ~vectored_file_writer()
+    {
+        if (is_open())
+        {
+            flush();
+            if (owns_fd)
+                ::close(fd);
+        }
+    }
+
+    vectored_file_writer(const vectored_file_writer&) = delete;
+    vectored_file_writer& operator=(const vectored_file_writer&) = delete;
+
+    [[nodiscard]] bool is_open() const noexcept { return fd != -1; }
+
+    [[nodiscard]] bool good() const noexcept { return is_open() and not failed; }
+
+    std::size_t write(const char* const data_ptr, std::size_t count)
+    {
+        if (count >= copy_threshold)
+        {
+            make_room(0UL);
+            push({ data_ptr, 0UL, count });
+        }
+        else
+        {
+            make_room(count);
+            push({ nullptr, std::size(arena), count });
+            arena.insert(std::end(arena), data_ptr, data_ptr + count);
+        }
+        global_offset += count;
+        return global_offset;
+    }
+
+    std::size_t fill(const char v, std::size_t count)
+    {
+        while (count != 0)
+        {
+            make_room(1UL);
+            const auto chunk = std::min(count, arena_size - std::size(arena));
+            push({ nullptr, std::size(arena), chunk });
+            arena.resize(std::size(arena) + chunk, v);
+            count -= chunk;
+            global_offset += chunk;
+        }
+        return global_offset;
+    }
+
+    // overwrites already written bytes, used to back-patch records
+    void write_at(std::size_t offset, const char* const data_ptr, std::size_t count)
+    {
+        if (flush() and not pwrite_all(offset, data_ptr, count))
+            failed = true;
+    }
+
+    // next writes go to offset, skipped ranges are left to other writers
+    void seek(std::size_t offset)
+    {
+        flush();
+        global_offset = offset;
+        file_offset = offset;
+    }
+
+    // reserves the whole file upfront so that concurrent writers don't fragment it
+    void preallocate([[maybe_unused]] std::size_t size)
+    {
+#ifdef __linux__
+        // not every file system supports it, writes will allocate on the fly then
+        std::ignore = ::fallocate(fd, 0, 0, static_cast<off_t>(size));
+#endif
+    }
+
+    bool flush()
+    {
+        if (failed or std::empty(segments))
+        {
+            segments.clear();
+            arena.clear();
+            return not failed;
+        }
+        std::vector<iovec> iovecs(std::size(segments));
+        std::transform(std::cbegin(segments), std::cend(segments), std::begin(iovecs),
+            [this](const segment& s)
+            {
+                const char* base = s.data ? s.data : arena.data() + s.arena_offset;
+                return iovec { const_cast<char*>(base), s.size };
+            });
+        auto* first = iovecs.data();
+        auto* last = iovecs.data() + std::size(iovecs);
+        while (first != last)
+        {
+            const auto count
+                = static_cast<int>(std::min(static_cast<std::size_t>(last - first), max_iovecs));
+            const auto written = ::pwritev(fd, first, count, static_cast<off_t>(file_offset));
+            if (written < 0 and errno == EINTR)
+                continue;
+            if (written <= 0)
+            {
+                failed = true;
+                break;
+            }
+            file_offset += static_cast<std::size_t>(written);
+            // skip what was written, the last iovec might be partially written
+            auto remaining = static_cast<std::size_t>(written);
+            while (first != last and remaining >= first->iov_len)
+            {
+                remaining -= first->iov_len;
+                first++;
+            }
+            if (first != last)
+            {
+                first->iov_base = static_cast<char*>(first->iov_base) + remaining;
+                first->iov_len -= remaining;
+            }
+        }
+        segments.clear();
+        arena.clear();
+        return not failed;
+    }
+
+    void close()
+    {
+        flush();
+        if (owns_fd)
+            ::close(fd);
+        fd = -1;
+    }
+
+    [[nodiscard]] std::size_t offset() const noexcept { return this->global_offset; }
+
+private:
+    void make_room(std::size_t bytes)
+    {
+        if (std::size(arena) + bytes > arena_size or std::size(segments) == max_iovecs)
+            flush();
+    }
+
+    void push(segment s)
+    {
+        if (std::size(segments) != 0 and s.data == nullptr and segments.back().data == nullptr)
+        {
+            // consecutive copies are contiguous in the arena
+            segments.back().size += s.size;
+            return;
+        }
+        segments.push_back(s);
+    }
+
+    [[nodiscard]] bool pwrite_all(std::size_t offset, const char* data_ptr, std::size_t count)
+    {
+        while (count != 0)
+        {
+            const auto written = ::pwrite(fd, data_ptr, count, static_cast<off_t>(offset));
+            if (written < 0 and errno == EINTR)
+                continue;
+            if (written <= 0)
+                return false;
+            data_ptr += written;
+            offset += static_cast<std::size_t>(written);
+            count -= static_cast<std::size_t>(written);
+        }
+        return true;
+    }
+};
+#endif
+
+/*
+ * Compresses everything written to it on the fly and forwards the compressed stream to the
+ * underlying writer. Offsets are given in the uncompressed stream, small writes such as record
+ * fields are batched before reaching the encoder.
+ */
+template <typename encoder_t, typename writer_t>
+struct compressing_writer
+{
+    static inline constexpr std::size_t staging_size = 1 << 16;
+
+    encoder_t encoder;
+    writer_t& output;
+    std::size_t global_offset = 0UL;
+    std::size_t compressed_size = 0UL;
+    no_init_vector<char> staging;
+
+    template <typename... encoder_args_t>
+    compressing_writer(writer_t& output, encoder_args_t&&... encoder_args)
+            : encoder { std::forward<encoder_args_t>(encoder_args)... }, output { output }
+    {
+        staging.reserve(staging_size);
+    }
+
+    std::size_t write(const char* const data_ptr, std::size_t count)
+    {
+        if (std::size(staging) + count > staging_size)
+            flush_staging();
+        if (count >= staging_size)
+            encoder.write(data_ptr, count, sink());
+        else
+            staging.insert(std::end(staging), data_ptr, data_ptr + count);
+        global_offset += count;
+        return global_offset;
+    }
+
+    std::size_t fill(const char v, std::size_t count)
+    {
+        while (count != 0)
+        {
+            if (std::size(staging) == staging_size)
+                flush_staging();
+            const auto chunk = std::min(count, staging_size - std::size(staging));
+            staging.resize(std::size(staging) + chunk, v);
+            count -= chunk;
+            global_offset += chunk;
+        }
+        return global_offset;
+    }
+
+    // ends the compressed stream and returns its size
+    std::size_t finish()
+    {
+        flush_staging();
+        encoder.finish(sink());
+        return compressed_size;
+    }
+
     [[nodiscard]] std::size_t offset() const noexcept { return this->global_offset; }
+
+private:
+    auto sink()
+    {
+        return [this](const char* data, std::size_t size)
+        {
+            output.write(data, size);
+            compressed_size += size;
+        };
+    }
+
+    void flush_staging()
+    {
+        if (std::size(staging) != 0)
+        {
+            encoder.write(staging.data(), std::size(staging), sink());
+            staging.clear();
+        }
+    }
 };
 }
@@ -22,18 +22,25 @@
 ----------------------------------------------------------------------------*/
 #pragma once
 
+#include "../compression-selection.hpp"
 #include "../compression.hpp"
 #include "../desc-records.hpp"
+#include "../endianness.hpp"
+#include "../parallel.hpp"
 #include "./records-saving.hpp"
 #include "cdfpp/cdf-enums.hpp"
 #include "cdfpp/cdf-file.hpp"
 #include "cdfpp/no_init_vector.hpp"
+#include "cdfpp_config.h"
 #include <algorithm>
+#include <cstring>
 #include <fstream>
 #include <iostream>
+#include <limits>
 #include <numeric>
 #include <optional>
 #include <utility>
+#include <vector>
 
 namespace cdf::io
 {
@@ -41,7 +48,9 @@ namespace cdf::io
 namespace saving
 {
 
-    record_wrapper<cdf_CPR_t<v3x_tag>> make_cpr(cdf_compression_type ct)
+    // the CPR records the gzip level the way the CDF library does, in the [1, 9] range
+    record_wrapper<cdf_CPR_t<v3x_tag>> make_cpr(
+        cdf_compression_type ct, int level = default_compression_level)
     {
         record_wrapper<cdf_CPR_t<v3x_tag>> cpr { { {}, ct, 0, 0, {} } };
         switch (ct)
@@ -50,7 +59,7 @@ namespace saving
                 break;
             case cdf_compression_type::gzip_compression:
                 cpr.record.pCount = 1;
-                cpr.record.cParms.values.push_back(9);
+                cpr.record.cParms.values.push_back(std::clamp(level, 1, 9));
                 break;
             default:
                 throw std::invalid_argument { "Unsupported compression algorithm" };
@@ -60,6 +69,34 @@ namespace saving
         return cpr;
     }
 
+    [[nodiscard]] inline int32_t entry_elements(const data_t& data)
+    {
+        return visit(
+            data, [](const cdf_none&) -> int32_t { return 0; },
+            [](const auto& v) -> int32_t { return std::size(v); });
+    }
+
+    // multiple strings are stored in one entry separated by new lines
+    [[nodiscard]] inline int32_t entry_strings(const data_t& data)
+    {
+        if (not is_string(data.type()))
+            return 0;
+        return visit(
+            data,
+            [](const no_init_vector<char>& v) -> int32_t
+            {
+                return std::max(std::size_t { 1 },
+                    static_cast<std::size_t>(std::count(std::cbegin(v), std::cend(v), '\n')));
+            },
+            [](const no_init_vector<unsigned char>& v) -> int32_t
+            {
+                return std::max(std::size_t { 1 },
+                    static_cast<std::size_t>(std::count(
+                        std::cbegin(v), std::cend(v), static_cast<unsigned char>('\n'))));
+            },
+            [](const auto&) -> int32_t { return 0; });
+    }
+
     inline void create_file_attributes_records(const CDF& cdf, saving_context& svg_ctx)
     {
         for (const auto& [name, attribute] : cdf.attributes)
@@ -76,29 +113,9 @@ namespace saving
             int32_t value_index = 0UL;
             for (const auto& data : attribute)
             {
-                auto& aedr = fac.aedrs.emplace_back(cdf_AgrEDR_t<v3x_tag> {
-                    {}, 0, index, data.type(), value_index, 0, 0, 0, 0, 0, 0 });
-                if (is_string(data.type()))
-                {
-                    aedr.record.NumStrings = visit(
-                        data,
-                        [](const no_init_vector<char>& v) -> uint32_t
-                        {
-                            return std::max(std::size_t { 1 },
-                                static_cast<std::size_t>(
-                                    std::count(std::cbegin(v), std::cend(v), '\n')));
-                        },
-                        [](const no_init_vector<unsigned char>& v) -> uint32_t
-                        {
-                            return std::max(std::size_t { 1 },
-                                static_cast<std::size_t>(std::count(std::cbegin(v), std::cend(v),
-                                    static_cast<unsigned char>('\n'))));
-                        },
-                        [](const auto&) -> uint32_t { return 0; });
-                }
-                aedr.record.NumElements = visit(
-                    data, [](const cdf_none&) -> uint32_t { return 0; },
-                    [](const auto& v) -> uint32_t { return std::size(v); });
+                auto& aedr = fac.aedrs.emplace_back(cdf_AgrEDR_t<v3x_tag> { {}, 0, index,
+                    data.type(), value_index, entry_elements(data), entry_strings(data), 0, 0, 0,
+                    0 });
                 value_index += 1;
                 update_size(aedr, aedr.record.NumElements * cdf_type_size(aedr.record.DataType));
             }
@@ -124,28 +141,8 @@ namespace saving
             vac.attrs.push_back(&attribute);
             const auto& data = attribute[0UL];
             auto& aedr = vac.aedrs.emplace_back(cdf_AzEDR_t<v3x_tag> { {}, 0, vac.adr.record.num,
-                data.type(), static_cast<int32_t>(variable.number), 0, 0, 0, 0, 0, 0 });
-            if (is_string(data.type()))
-            {
-                aedr.record.NumStrings = visit(
-                    data,
-                    [](const no_init_vector<char>& v) -> int32_t
-                    {
-                        return std::max(std::size_t { 1 },
-                            static_cast<std::size_t>(
-                                std::count(std::cbegin(v), std::cend(v), '\n')));
-                    },
-                    [](const no_init_vector<unsigned char>& v) -> int32_t
-                    {
-                        return std::max(std::size_t { 1 },
-                            static_cast<std::size_t>(std::count(
-                                std::cbegin(v), std::cend(v), static_cast<unsigned char>('\n'))));
-                    },
-                    [](const auto&) -> int32_t { return 0; });
-            }
-            aedr.record.NumElements = visit(
-                data, [](const cdf_none&) -> int32_t { return 0; },
-                [](const auto& v) -> int32_t { return std::size(v); });
+                data.type(), static_cast<int32_t>(variable.number), entry_elements(data),
+                entry_strings(data), 0, 0, 0, 0 });
             update_size(aedr, aedr.record.NumElements * cdf_type_size(aedr.record.DataType));
             vac.adr.record.MAXzEntries = std::max(vac.adr.record.MAXzEntries, aedr.record.Num);
             vac.adr.record.NzEntries = std::size(vac.aedrs);
@@ -179,11 +176,12 @@ namespace saving
         vdr.MaxRec = variable.len() - 1;
     }
 
-    typename variable_ctx::values_records_t make_values_record(const Variable& v,
-        const std::size_t records_in_vvr, const std::size_t record_size,
-        const std::size_t first_record)
+    // CVVRs are created empty, their payload is filled by compress_values_records
+    typename variable_ctx::values_records_t make_values_record(
+        const cdf_compression_type compression, const std::size_t records_in_vvr,
+        const std::size_t record_size)
     {
-        if (v.compression_type() == cdf_compression_type::no_compression)
+        if (compression == cdf_compression_type::no_compression)
         {
             auto vvr = record_wrapper<cdf_VVR_t<v3x_tag>> {};
             update_size(vvr, records_in_vvr * record_size);
@@ -191,65 +189,311 @@ namespace saving
         }
         else
         {
-            auto cvvr = record_wrapper<cdf_CVVR_t<v3x_tag>> {};
-            cvvr.record.data.values = compression::deflate(v.compression_type(),
-                std::string_view {
-                    v.bytes_ptr() + first_record * record_size, records_in_vvr * record_size });
-            cvvr.record.cSize = std::size(cvvr.record.data.values);
-            update_size(cvvr);
-            return cvvr;
+            return record_wrapper<cdf_CVVR_t<v3x_tag>> {};
+        }
+    }
+
+    // VXRs are chained once they index this many values records
+    inline constexpr std::size_t max_vxr_entries = 1024;
+
+    /*
+     * Unmodified lazy variables whose values are stored the way we would write them are copied
+     * block by block from their source, without decoding nor recompressing them. Compressed
+     * blocks must have been made with the target gzip level, and when a chunk size applies the
+     * source blocks must already hold records_per_vvr records each (the last one excepted).
+     */
+    [[nodiscard]] inline std::optional<raw_data> raw_values_source(const Variable& variable,
+        cdf_compression_type compression, int compression_level, bool chunked,
+        std::size_t records_per_vvr)
+    {
+        auto raw = variable.raw_values();
+        if (not raw or raw->compression != compression
+            or endianness::is_big_endian_encoding(raw->encoding)
+                != endianness::is_big_endian_encoding(CDFpp_ENCODING)
+            or (raw->majority == cdf_majority::column and std::size(variable.shape()) > 2))
+            return std::nullopt;
+        if (compression == cdf_compression_type::gzip_compression
+            and raw->compression_level != std::clamp(compression_level, 1, 9))
+            return std::nullopt;
+        if (chunked)
+        {
+            for (auto block = std::cbegin(raw->blocks); block != std::cend(raw->blocks); block++)
+            {
+                const auto records = block->last_record - block->first_record + 1;
+                if (records > records_per_vvr
+                    or (records != records_per_vvr and std::next(block) != std::cend(raw->blocks)))
+                    return std::nullopt;
+            }
+        }
+        return raw;
+    }
+
+    // source blocks are kept as is, uncompressed blocks of compressed variables included
+    inline void create_raw_values_records(variable_ctx& var_ctx, std::size_t record_size)
+    {
+        for (const auto& block : var_ctx.raw->blocks)
+        {
+            if (std::size(var_ctx.vxrs.back().record.First.values) == max_vxr_entries)
+                var_ctx.vxrs.emplace_back(cdf_VXR_t<v3x_tag> { {}, 0, 0, 0, {}, {}, {} });
+            auto& vxr = var_ctx.vxrs.back();
+            if (block.compressed)
+            {
+                // the payload is written straight from the source buffer
+                record_wrapper<cdf_CVVR_t<v3x_tag>> cvvr {};
+                cvvr.record.cSize = block.size;
+                update_size(cvvr, block.size);
+                var_ctx.values_records.emplace_back(std::move(cvvr));
+            }
+            else
+            {
+                var_ctx.values_records.emplace_back(make_values_record(
+                    cdf_compression_type::no_compression,
+                    block.last_record - block.first_record + 1, record_size));
+            }
+            vxr.record.First.values.push_back(block.first_record);
+            vxr.record.Last.values.push_back(block.last_record);
         }
     }
 
+    [[nodiscard]] inline std::size_t variable_record_size(const Variable& variable)
+    {
+        return std::max(std::size_t { 1 },
+                   flat_size(std::cbegin(variable.shape()) + 1, std::cend(variable.shape())))
+            * cdf_type_size(variable.type());
+    }
+
+    struct compression_task
+    {
+        record_wrapper<cdf_CVVR_t<v3x_tag>>* cvvr;
+        cdf_compression_type type;
+        int level;
+        std::string_view input;
+    };
+
+    /*
+     * Compresses every CVVR block of every variable on a worker pool, layout only needs their
+     * compressed sizes. Each block is compressed exactly as it would be on a single thread so the
+     * resulting file doesn't depend on the number of workers. This runs while the saving context
+     * is built, before any record is written: offsets depend on every compressed size, so
+     * compression doesn't overlap with the writes.
+     */
+    inline void compress_values_records(saving_context& svg_ctx)
+    {
+        std::vector<compression_task> tasks;
+        for (auto& var_ctx : svg_ctx.body.variables)
+        {
+            if (var_ctx.compression == cdf_compression_type::no_compression or var_ctx.raw)
+                continue;
+            const auto& variable = *var_ctx.variable;
+            // lazy variables are loaded here, on the calling thread
+            const char* data = variable.bytes_ptr();
+            const auto record_size = variable_record_size(variable);
+            auto values_record = std::begin(var_ctx.values_records);
+            for (const auto& vxr : var_ctx.vxrs)
+            {
+                for (auto i = 0UL; i < std::size(vxr.record.First.values); i++, values_record++)
+                {
+                    const auto first_record = static_cast<std::size_t>(vxr.record.First.values[i]);
+                    const auto records
+                        = static_cast<std::size_t>(vxr.record.Last.values[i]) - first_record + 1;
+                    tasks.push_back(
+                        { &std::get<record_wrapper<cdf_CVVR_t<v3x_tag>>>(*values_record),
+                            var_ctx.compression, var_ctx.compression_level,
+                            std::string_view {
+                                data + first_record * record_size, records * record_size } });
+                }
+            }
+        }
+        parallel::parallel_for(std::size(tasks),
+            [&tasks](std::size_t index)
+            {
+                auto& task = tasks[index];
+                task.cvvr->record.data.values
+                    = compression::deflate(task.type, task.input, task.level);
+                task.cvvr->record.cSize = std::size(task.cvvr->record.data.values);
+                update_size(*task.cvvr);
+            });
+    }
+
+    [[nodiscard]] inline std::size_t records_per_values_record(
+        const CDF& cdf, const Variable& variable, std::size_t record_size)
+    {
+        // this is an arbitrary decision to limit VVRs to 1GB
+        const auto max_records = std::max(std::size_t { 1 }, (std::size_t { 1 } << 30) / record_size);
+        const auto chunk_size
+            = variable.chunk_size().is_set() ? variable.chunk_size() : cdf.chunk_size;
+        if (chunk_size.is_set())
+            return std::min(max_records, chunk_size.records_per_chunk(record_size));
+        return max_records;
+    }
+
+    // FILLVAL is used as pad value when it holds exactly one value of the variable type
+    [[nodiscard]] inline std::optional<no_init_vector<char>> fill_value(
+        const Variable& variable, std::size_t value_size)
+    {
+        const auto attribute = variable.attributes.find("FILLVAL");
+        if (attribute == std::cend(variable.attributes) or std::size(attribute->second) != 1)
+            return std::nullopt;
+        const auto& value = attribute->second[0];
+        if (value.type() != variable.type() or value.bytes() != value_size)
+            return std::nullopt;
+        return no_init_vector<char>(value.bytes_ptr(), value.bytes_ptr() + value_size);
+    }
+
+    // runs of records written to the file as (first record, count), see sparse_records_t
+    [[nodiscard]] inline std::vector<std::pair<std::size_t, std::size_t>> stored_records(
+        const Variable& variable, std::size_t record_size,
+        const std::optional<no_init_vector<char>>& pad)
+    {
+        const auto records = variable.len();
+        const auto& sparse = variable.sparse_records();
+        std::vector<std::pair<std::size_t, std::size_t>> runs;
+        if (not sparse.is_set() or variable.is_nrv())
+        {
+            if (records != 0)
+                runs.emplace_back(0UL, records);
+            return runs;
+        }
+        const char* data = variable.bytes_ptr();
+        const auto skipped = [&](std::size_t record)
+        {
+            if (record < std::size(sparse.mask) and sparse.mask[record])
+                return true;
+            if (not sparse.fill_values or not pad)
+                return false;
+            const auto value_size = std::size(*pad);
+            const auto* values = data + record * record_size;
+            for (auto offset = 0UL; offset < record_size; offset += value_size)
+            {
+                if (std::memcmp(values + offset, pad->data(), value_size) != 0)
+                    return false;
+            }
+            return true;
+        };
+        const auto min_run = std::max(std::size_t { 1 }, sparse.min_run);
+        std::size_t first = 0;
+        std::size_t record = 0;
+        while (record < records)
+        {
+            if (not skipped(record))
+            {
+                record++;
+                continue;
+            }
+            auto end = record + 1;
+            while (end < records and skipped(end))
+                end++;
+            if (end - record >= min_run)
+            {
+                if (record > first)
+                    runs.emplace_back(first, record - first);
+                first = end;
+            }
+            record = end;
+        }
+        if (records > first)
+            runs.emplace_back(first, records - first);
+        return runs;
+    }
+
     inline void create_variables_records(const CDF& cdf, saving_context& svg_ctx)
     {
         for (const auto& [name, variable] : cdf.variables)
         {
             int32_t index = std::size(svg_ctx.body.variables);
+            auto compression = variable.compression_type();
+            if (compression == cdf_compression_type::auto_compression)
+            {
+                const auto& decision = svg_ctx.compression_decisions.emplace_back(
+                    choose_compression(cdf, variable));
+                compression = decision.type;
+            }
             auto& var_ctx = svg_ctx.body.variables.emplace_back(
-                variable_ctx { variable.compression_type(), index, &variable,
+                variable_ctx { compression, index, &variable,
                     cdf_zVDR_t<v3x_tag> { {}, 0, variable.type(), 0, 0, 0, !variable.is_nrv(), 0, 0,
                         -1, -1, 0, index, 0, 0, { name }, 0, {}, {}, {} },
                     {}, {} });
 
             populate_variable_geometry(variable, var_ctx.vdr.record);
-            if (variable.compression_type() != cdf_compression_type::no_compression)
+            if (compression != cdf_compression_type::no_compression)
             {
-                var_ctx.cpr = make_cpr(variable.compression_type());
+                var_ctx.compression_level
+                    = variable.compression_level().value_or(cdf.compression_level);
+                var_ctx.cpr = make_cpr(compression, var_ctx.compression_level);
                 var_ctx.vdr.record.Flags |= 1 << 2;
-                var_ctx.vdr.record.BlockingFactor = 0x40;
+            }
+
+            const auto var_record_size = variable_record_size(variable);
+            const auto records_per_vvr = records_per_values_record(cdf, variable, var_record_size);
+            if (compression != cdf_compression_type::no_compression
+                or variable.chunk_size().is_set() or cdf.chunk_size.is_set())
+            {
+                var_ctx.vdr.record.BlockingFactor = static_cast<int32_t>(std::min(
+                    records_per_vvr, static_cast<std::size_t>(std::numeric_limits<int32_t>::max())));
+            }
+
+            const bool sparse = variable.sparse_records().is_set() and not variable.is_nrv();
+            std::optional<no_init_vector<char>> pad;
+            if (sparse)
+            {
+                // missing records read as the pad value, or as the previous record
+                const auto& sparse_records = variable.sparse_records();
+                const auto value_size = static_cast<std::size_t>(var_ctx.vdr.record.NumElems)
+                    * cdf_type_size(variable.type());
+                var_ctx.vdr.record.SRecords = sparse_records.previous ? 2 : 1;
+                if (sparse_records.pad_value
+                    and std::size(*sparse_records.pad_value) == value_size)
+                    pad = sparse_records.pad_value;
+                else
+                    pad = fill_value(variable, value_size);
+                if (pad)
+                {
+                    var_ctx.vdr.record.Flags |= 1 << 1;
+                    var_ctx.vdr.record.PadValues.values = *pad;
+                }
             }
 
             update_size(var_ctx.vdr);
 
-            auto& vxr = var_ctx.vxrs.emplace_back(cdf_VXR_t<v3x_tag> { {}, 0, 0, 0, {}, {}, {} });
-            const auto var_record_size
-                = std::max(std::size_t { 1 },
-                      flat_size(std::cbegin(variable.shape()) + 1, std::cend(variable.shape())))
-                * cdf_type_size(variable.type());
+            var_ctx.vxrs.emplace_back(cdf_VXR_t<v3x_tag> { {}, 0, 0, 0, {}, {}, {} });
+            if (not sparse)
+                var_ctx.raw = raw_values_source(variable, compression, var_ctx.compression_level,
+                    variable.chunk_size().is_set() or cdf.chunk_size.is_set(), records_per_vvr);
+            if (var_ctx.raw)
+                create_raw_values_records(var_ctx, var_record_size);
+            else
             {
-                auto records = variable.len();
-                auto first_record = 0;
-                while (records > 0)
+                for (auto [first_record, records] : stored_records(variable, var_record_size, pad))
                 {
-                    // this is an arbitrary decision to limit VVRs to 1GB
-                    auto records_in_vvr
-                        = std::min(static_cast<std::size_t>((1 << 30) / var_record_size),
-                            static_cast<std::size_t>(records));
-                    var_ctx.values_records.emplace_back(make_values_record(
-                        variable, records_in_vvr, var_record_size, first_record));
-                    vxr.record.First.values.push_back(first_record);
-                    vxr.record.Last.values.push_back(first_record + records_in_vvr - 1);
-                    first_record += records_in_vvr;
-                    records -= records_in_vvr;
+                    while (records > 0)
+                    {
+                        if (std::size(var_ctx.vxrs.back().record.First.values) == max_vxr_entries)
+                            var_ctx.vxrs.emplace_back(
+                                cdf_VXR_t<v3x_tag> { {}, 0, 0, 0, {}, {}, {} });
+                        auto& vxr = var_ctx.vxrs.back();
+                        auto records_in_vvr = std::min(records_per_vvr, records);
+                        var_ctx.values_records.emplace_back(
+                            make_values_record(compression, records_in_vvr, var_record_size));
+                        vxr.record.First.values.push_back(first_record);
+                        vxr.record.Last.values.push_back(first_record + records_in_vvr - 1);
+                        first_record += records_in_vvr;
+                        records -= records_in_vvr;
+                    }
                 }
             }
-            vxr.record.Offset.values.resize(std::size(vxr.record.First.values));
-            vxr.record.Nentries = std::size(vxr.record.First.values);
-            vxr.record.NusedEntries = std::size(vxr.record.First.values);
-            update_size(vxr);
+            // variables without records get no VXR, VXRhead stays null until records are appended
+            if (std::empty(var_ctx.values_records))
+                var_ctx.vxrs.clear();
+            for (auto& vxr : var_ctx.vxrs)
+            {
+                vxr.record.Offset.values.resize(std::size(vxr.record.First.values));
+                vxr.record.Nentries = std::size(vxr.record.First.values);
+                vxr.record.NusedEntries = std::size(vxr.record.First.values);
+                update_size(vxr);
+            }
             create_variable_attributes_records(var_ctx, svg_ctx);
         }
+        compress_values_records(svg_ctx);
     }
 
 
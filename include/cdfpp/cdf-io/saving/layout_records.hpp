@@ -76,6 +76,34 @@ namespace saving
         return offset;
     }
 
+    [[nodiscard]] inline std::size_t layout_variable_descriptors(
+        variable_ctx& vc, std::size_t offset)
+    {
+        offset = layout(vc.vdr, offset);
+        offset = layout(vc.vxrs, offset);
+        if (vc.cpr)
+        {
+            offset = layout(vc.cpr.value(), offset);
+        }
+        return offset;
+    }
+
+    [[nodiscard]] inline std::size_t layout_variables_attributes(
+        cdf_body& body, std::size_t offset)
+    {
+        for (auto& [name, vac] : body.variable_attributes)
+        {
+            offset = layout(vac.adr, offset);
+            offset = layout(vac.aedrs, offset);
+        }
+        return offset;
+    }
+
+    /*
+     * interleaved: CDR, GDR, file attributes, then VDR, VXRs, CPR and values records of each
+     * variable and finally the variable attributes.
+     * metadata_first: CDR, GDR, every ADR/AEDR, every VDR/VXR/CPR and then all the values records.
+     */
     [[nodiscard]] inline std::size_t map_records(saving_context& svg_ctx)
     {
         if (svg_ctx.ccr)
@@ -89,20 +117,22 @@ namespace saving
             offset = layout(fac.adr, offset);
             offset = layout(fac.aedrs, offset);
         }
-        for (auto& vc : svg_ctx.body.variables)
+        if (svg_ctx.body.layout == cdf_layout::metadata_first)
         {
-            offset = layout(vc.vdr, offset);
-            offset = layout(vc.vxrs, offset);
-            if (vc.cpr)
-            {
-                offset = layout(vc.cpr.value(), offset);
-            }
-            offset = layout(vc.values_records, offset);
+            offset = layout_variables_attributes(svg_ctx.body, offset);
+            for (auto& vc : svg_ctx.body.variables)
+                offset = layout_variable_descriptors(vc, offset);
+            for (auto& vc : svg_ctx.body.variables)
+                offset = layout(vc.values_records, offset);
         }
-        for (auto& [name, vac] : svg_ctx.body.variable_attributes)
+        else
         {
-            offset = layout(vac.adr, offset);
-            offset = layout(vac.aedrs, offset);
+            for (auto& vc : svg_ctx.body.variables)
+            {
+                offset = layout_variable_descriptors(vc, offset);
+                offset = layout(vc.values_records, offset);
+            }
+            offset = layout_variables_attributes(svg_ctx.body, offset);
         }
         return offset;
     }
@@ -47,7 +47,7 @@ namespace saving
                 fac.adr.record.AgrEDRhead = fac.aedrs.front().offset;
             else
                 fac.adr.record.AzEDRhead = fac.aedrs.front().offset;
-            auto last_offset = 0;
+            std::size_t last_offset = 0;
             std::for_each(std::rbegin(fac.aedrs), std::rend(fac.aedrs),
                 [&last_offset](auto& aedr)
                 {
@@ -59,7 +59,7 @@ namespace saving
 
     inline void link_adrs(saving_context& svg_ctx)
     {
-        auto last_offset = 0;
+        std::size_t last_offset = 0;
         std::for_each(std::rbegin(svg_ctx.body.variable_attributes),
             std::rend(svg_ctx.body.variable_attributes),
             [&last_offset](auto& node)
@@ -87,7 +87,7 @@ namespace saving
 
     inline void link_vxrs(variable_ctx& vc)
     {
-        auto last_offset = 0;
+        std::size_t last_offset = 0;
         auto last_vvr = vc.values_records.rbegin();
         std::for_each(std::rbegin(vc.vxrs), std::rend(vc.vxrs),
             [&last_offset, &last_vvr](record_wrapper<cdf_VXR_t<v3x_tag>>& vxr)
@@ -107,20 +107,21 @@ namespace saving
 
     inline void link_vdrs(saving_context& svg_ctx)
     {
-        auto last_offset = 0;
+        std::size_t last_offset = 0;
         std::for_each(std::rbegin(svg_ctx.body.variables), std::rend(svg_ctx.body.variables),
             [&last_offset](variable_ctx& vc)
             {
                 vc.vdr.record.VDRnext = last_offset;
                 last_offset = vc.vdr.offset;
+                // variables without records have no VXR but keep their compression
+                if (vc.cpr)
+                {
+                    vc.vdr.record.CPRorSPRoffset = vc.cpr.value().offset;
+                }
                 if (std::size(vc.vxrs) >= 1)
                 {
                     vc.vdr.record.VXRhead = vc.vxrs.front().offset;
                     vc.vdr.record.VXRtail = vc.vxrs.back().offset;
-                    if (vc.cpr)
-                    {
-                        vc.vdr.record.CPRorSPRoffset = vc.cpr.value().offset;
-                    }
                     link_vxrs(vc);
                 }
             });
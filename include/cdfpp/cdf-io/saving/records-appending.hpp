@@ -0,0 +1,131 @@
+#pragma once
+/*------------------------------------------------------------------------------
+-- This file is a part of the CDFpp library
+-- Copyright (C) 2022, Plasma Physics Laboratory - CNRS
+--
+-- This program is free software; you can redistribute it and/or modify
+-- it under the terms of the GNU General Public License as published by
+-- the Free Software Foundation; either version 2 of the License, or
+-- (at your option) any later version.
+--
+-- This program is distributed in the hope that it will be useful,
+-- but WITHOUT ANY WARRANTY; without even the implied warranty of
+-- MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+-- GNU General Public License for more details.
+--
+-- You should have received a copy of the GNU General Public License
+-- along with this program; if not, write to the Free Software
+-- Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA 02111-1307 USA
+-------------------------------------------------------------------------------*/
+/*-- Author : Alexis Jeandet
+-- Mail : alexis.jeandet@member.fsf.org
+----------------------------------------------------------------------------*/
+
+#include "../compression.hpp"
+#include "../desc-records.hpp"
+#include "./create_records.hpp"
+#include "./records-saving.hpp"
+#include "./saving.hpp"
+#include "cdfpp/cdf-enums.hpp"
+#include <algorithm>
+#include <string_view>
+#include <tuple>
+#include <utility>
+
+namespace cdf::io
+{
+
+namespace saving
+{
+    /*
+     * State needed to append records to a variable at the end of a file: its VDR and the last
+     * VXR of its top level chain. A null VXR offset means the variable has no VXR yet.
+     */
+    template <typename vdr_t>
+    struct appending_context
+    {
+        cdf_compression_type compression;
+        int compression_level;
+        std::size_t record_size;
+        std::size_t records_per_values_record;
+        std::size_t records;
+        record_wrapper<vdr_t> vdr;
+        record_wrapper<cdf_VXR_t<v3x_tag>> vxr;
+    };
+
+    // VXRs are written with unused entries and filled as values records get appended
+    template <typename vdr_t, typename writer_t>
+    void append_vxr(appending_context<vdr_t>& context, writer_t& writer)
+    {
+        record_wrapper<cdf_VXR_t<v3x_tag>> vxr { cdf_VXR_t<v3x_tag> { {}, 0,
+            static_cast<uint32_t>(max_vxr_entries), 0, {}, {}, {} } };
+        vxr.record.First.values.resize(max_vxr_entries, static_cast<uint32_t>(-1));
+        vxr.record.Last.values.resize(max_vxr_entries, static_cast<uint32_t>(-1));
+        vxr.record.Offset.values.resize(max_vxr_entries, -1);
+        update_size(vxr);
+        vxr.offset = writer.offset();
+        save_record(vxr.record, writer);
+        if (context.vxr.offset == 0)
+            context.vdr.record.VXRhead = vxr.offset;
+        else
+        {
+            // the previous VXR is full, it won't change anymore
+            context.vxr.record.VXRnext = vxr.offset;
+            rewrite_record(context.vxr.record, context.vxr.offset, writer);
+        }
+        context.vdr.record.VXRtail = vxr.offset;
+        context.vxr = std::move(vxr);
+    }
+
+    template <typename writer_t>
+    void append_values_record(cdf_compression_type compression, int compression_level,
+        const char* data, std::size_t len, writer_t& writer)
+    {
+        if (compression == cdf_compression_type::no_compression)
+        {
+            record_wrapper<cdf_VVR_t<v3x_tag>> vvr {};
+            update_size(vvr, len);
+            std::ignore = save_record(vvr.record, data, len, writer);
+        }
+        else
+        {
+            record_wrapper<cdf_CVVR_t<v3x_tag>> cvvr {};
+            cvvr.record.data.values = compression::deflate(
+                compression, std::string_view { data, len }, compression_level);
+            cvvr.record.cSize = std::size(cvvr.record.data.values);
+            update_size(cvvr);
+            save_record(cvvr.record, writer);
+        }
+    }
+
+    /*
+     * Writes records at the end of the file and indexes them in the in memory VXR, full VXRs are
+     * chained to a new one. The caller is responsible for rewriting the last VXR and the VDR.
+     */
+    template <typename vdr_t, typename writer_t>
+    void append_records(
+        appending_context<vdr_t>& context, const char* data, std::size_t records, writer_t& writer)
+    {
+        while (records != 0)
+        {
+            if (context.vxr.record.NusedEntries == context.vxr.record.Nentries)
+                append_vxr(context, writer);
+            const auto count = std::min(records, context.records_per_values_record);
+            const auto offset = writer.offset();
+            append_values_record(context.compression, context.compression_level, data,
+                count * context.record_size, writer);
+            auto& vxr = context.vxr.record;
+            vxr.First.values[vxr.NusedEntries] = static_cast<uint32_t>(context.records);
+            vxr.Last.values[vxr.NusedEntries] = static_cast<uint32_t>(context.records + count - 1);
+            vxr.Offset.values[vxr.NusedEntries] = offset;
+            vxr.NusedEntries += 1;
+            context.records += count;
+            data += count * context.record_size;
+            records -= count;
+        }
+        context.vdr.record.MaxRec = static_cast<int32_t>(context.records) - 1;
+    }
+
+} // namespace
+
+}
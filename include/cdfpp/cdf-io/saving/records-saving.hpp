@@ -23,6 +23,7 @@
 #pragma once
 
 #include "../common.hpp"
+#include "../compression-selection.hpp"
 #include "../desc-records.hpp"
 #include "../endianness.hpp"
 #include "../reflection.hpp"
@@ -107,6 +108,9 @@ struct variable_ctx
     std::vector<record_wrapper<cdf_VXR_t<v3x_tag>>> vxrs;
     std::vector<values_records_t> values_records;
     std::optional<record_wrapper<cdf_CPR_t<v3x_tag>>> cpr = std::nullopt;
+    int compression_level = default_compression_level;
+    // set when the values records are copied from the source file
+    std::optional<raw_data> raw = std::nullopt;
 };
 
 template <typename... Ts>
@@ -128,15 +132,19 @@ struct cdf_body
     std::vector<file_attribute_ctx> file_attributes;
     nomap<std::string, variable_attribute_ctx> variable_attributes;
     std::vector<variable_ctx> variables;
+    cdf_layout layout = cdf_layout::interleaved;
 };
 
 struct saving_context
 {
     cdf_compression_type compression = cdf_compression_type::no_compression;
+    int compression_level = default_compression_level;
     common::magic_numbers_t magic;
     std::optional<record_wrapper<cdf_CCR_t<v3x_tag>>> ccr;
     std::optional<record_wrapper<cdf_CPR_t<v3x_tag>>> cpr;
     cdf_body body;
+    // codecs picked for auto_compression, the file one first with an empty variable name
+    std::vector<compression_decision> compression_decisions;
 };
 
 
@@ -23,8 +23,12 @@
 #pragma once
 
 #include "../common.hpp"
+#include "../compression-selection.hpp"
 #include "../compression.hpp"
 #include "../desc-records.hpp"
+#include "../parallel.hpp"
+#include "../rle.hpp"
+#include "../zlib.hpp"
 #include "./buffers.hpp"
 #include "./create_records.hpp"
 #include "./layout_records.hpp"
@@ -36,10 +40,12 @@
 #include "cdfpp/no_init_vector.hpp"
 #include "cdfpp_config.h"
 #include <algorithm>
+#include <atomic>
 #include <fstream>
 #include <iostream>
 #include <numeric>
 #include <optional>
+#include <tuple>
 #include <utility>
 
 namespace cdf::io
@@ -62,6 +68,16 @@ namespace saving
         assert(r.offset == offset - r.size);
     }
 
+    // serializes a record over its previous version, its size must not change
+    template <typename T, typename U>
+    void rewrite_record(const T& record, std::size_t offset, U& writer)
+    {
+        no_init_vector<char> buffer;
+        buffers::vector_writer buffer_writer { buffer };
+        save_record(record, buffer_writer);
+        writer.write_at(offset, buffer.data(), std::size(buffer));
+    }
+
     template <typename T, typename U>
     void write_records(const T& items, U&& writer, std::size_t virtual_offset = 0)
     {
@@ -103,25 +119,59 @@ namespace saving
     }
 
     template <typename U>
-    void write_records(const Variable* const variable,
-        const std::vector<typename variable_ctx::values_records_t>& values_records, U&& writer,
-        std::size_t virtual_offset = 0)
+    void write_raw_records(const variable_ctx& variable_ctx, U&& writer, std::size_t virtual_offset)
     {
-        const auto* data = variable->bytes_ptr();
-        for (auto& values_record : values_records)
+        auto block = std::cbegin(variable_ctx.raw->blocks);
+        for (auto& values_record : variable_ctx.values_records)
         {
             visit(
                 values_record,
-                [&data, &writer, virtual_offset](const record_wrapper<cdf_VVR_t<v3x_tag>>& vvr)
+                [&block, &writer, virtual_offset](const record_wrapper<cdf_VVR_t<v3x_tag>>& vvr)
                 {
-                    const auto header_sz = record_size(vvr.record);
-                    const auto len = vvr.size - header_sz;
-                    auto offset = save_record(vvr.record, data, len, writer) + virtual_offset;
+                    auto offset = save_record(vvr.record, block->data, block->size, writer);
+                    offset += virtual_offset;
                     assert(offset - vvr.size == vvr.offset);
-                    data += len;
                 },
-                [&writer, virtual_offset](const record_wrapper<cdf_CVVR_t<v3x_tag>>& cvvr)
-                { write_record(cvvr, writer, virtual_offset); });
+                [&block, &writer, virtual_offset](const record_wrapper<cdf_CVVR_t<v3x_tag>>& cvvr)
+                {
+                    save_record(cvvr.record, writer);
+                    auto offset = writer.write(block->data, block->size) + virtual_offset;
+                    assert(offset - cvvr.size == cvvr.offset);
+                });
+            block++;
+        }
+    }
+
+    template <typename U>
+    void write_values_records(
+        const variable_ctx& variable_ctx, U&& writer, std::size_t virtual_offset = 0)
+    {
+        if (variable_ctx.raw)
+        {
+            write_raw_records(variable_ctx, writer, virtual_offset);
+            return;
+        }
+        // sparse variables skip records, VVRs start at the first record of their VXR entry
+        const auto* data = variable_ctx.variable->bytes_ptr();
+        const auto var_record_size = variable_record_size(*variable_ctx.variable);
+        auto values_record = std::cbegin(variable_ctx.values_records);
+        for (const auto& vxr : variable_ctx.vxrs)
+        {
+            for (const auto first_record : vxr.record.First.values)
+            {
+                visit(
+                    *values_record++,
+                    [data = data + static_cast<std::size_t>(first_record) * var_record_size,
+                        &writer, virtual_offset](const record_wrapper<cdf_VVR_t<v3x_tag>>& vvr)
+                    {
+                        const auto header_sz = record_size(vvr.record);
+                        const auto len = vvr.size - header_sz;
+                        auto offset = save_record(vvr.record, data, len, writer) + virtual_offset;
+                        assert(offset - vvr.size == vvr.offset);
+                    },
+                    [&writer, virtual_offset](const record_wrapper<cdf_CVVR_t<v3x_tag>>& cvvr)
+                    { write_record(cvvr, writer, virtual_offset); });
+            }
         }
     }
 
@@ -147,31 +197,83 @@ namespace saving
         }
     }
 
+    template <typename T>
+    void write_variable_descriptors(
+        const variable_ctx& variable_ctx, T& writer, std::size_t virtual_offset = 0)
+    {
+        write_record(variable_ctx.vdr, writer, virtual_offset);
+        write_records(variable_ctx.vxrs, writer, virtual_offset);
+        if (variable_ctx.cpr)
+        {
+            write_record(variable_ctx.cpr.value(), writer, virtual_offset);
+        }
+    }
+
     template <typename T>
     void write_variables(
         const std::vector<variable_ctx>& variables, T& writer, std::size_t virtual_offset = 0)
     {
         for (auto& variable_ctx : variables)
         {
-            write_record(variable_ctx.vdr, writer, virtual_offset);
-            write_records(variable_ctx.vxrs, writer, virtual_offset);
-            if (variable_ctx.cpr)
-            {
-                write_record(variable_ctx.cpr.value(), writer, virtual_offset);
-            }
-            write_records(
-                variable_ctx.variable, variable_ctx.values_records, writer, virtual_offset);
+            write_variable_descriptors(variable_ctx, writer, virtual_offset);
+            write_values_records(variable_ctx, writer, virtual_offset);
         }
     }
 
+    // must follow the order given by map_records
     template <typename T>
     void write_body(const cdf_body& body, T& writer, std::size_t virtual_offset = 0)
     {
         write_record(body.cdr, writer, virtual_offset);
         write_record(body.gdr, writer, virtual_offset);
         write_file_attributes(body.file_attributes, writer, virtual_offset);
-        write_variables(body.variables, writer, virtual_offset);
-        write_variables_attributes(body.variable_attributes, writer, virtual_offset);
+        if (body.layout == cdf_layout::metadata_first)
+        {
+            write_variables_attributes(body.variable_attributes, writer, virtual_offset);
+            for (auto& variable_ctx : body.variables)
+                write_variable_descriptors(variable_ctx, writer, virtual_offset);
+            for (auto& variable_ctx : body.variables)
+                write_values_records(variable_ctx, writer, virtual_offset);
+        }
+        else
+        {
+            write_variables(body.variables, writer, virtual_offset);
+            write_variables_attributes(body.variable_attributes, writer, virtual_offset);
+        }
+    }
+
+    // the body starts right after the magic numbers, offsets inside the CCR are uncompressed ones
+    template <typename encoder_t, typename T, typename... encoder_args_t>
+    [[nodiscard]] std::size_t stream_body(
+        const cdf_body& body, T& writer, encoder_args_t&&... encoder_args)
+    {
+        buffers::compressing_writer<encoder_t, T> compressing_writer { writer,
+            std::forward<encoder_args_t>(encoder_args)... };
+        write_body(body, compressing_writer, 8);
+        return compressing_writer.finish();
+    }
+
+    /*
+     * The compressed body is streamed to the output so that peak memory doesn't grow with the
+     * file size, the CCR header is written with a placeholder size and patched once the
+     * compressed size is known.
+     */
+    template <typename T>
+    void write_compressed_body(saving_context& svg_ctx, T& writer)
+    {
+        auto& ccr = svg_ctx.ccr.value();
+        auto& cpr = svg_ctx.cpr.value();
+        update_size(ccr);
+        save_record(ccr.record, writer);
+        const auto compressed_size
+            = (svg_ctx.compression == cdf_compression_type::gzip_compression)
+            ? stream_body<zlib::gzdeflate_stream>(svg_ctx.body, writer, svg_ctx.compression_level)
+            : stream_body<rle::deflate_stream>(svg_ctx.body, writer);
+        update_size(ccr, compressed_size);
+        cpr.offset = ccr.offset + ccr.size;
+        ccr.record.CPRoffset = cpr.offset;
+        rewrite_record(ccr.record, ccr.offset, writer);
+        write_record(cpr, writer);
     }
 
     template <typename T>
@@ -184,8 +286,7 @@ namespace saving
         }
         else
         {
-            write_record(svg_ctx.ccr.value(), writer);
-            write_record(svg_ctx.cpr.value(), writer);
+            write_compressed_body(svg_ctx, writer);
         }
     }
 
@@ -193,7 +294,15 @@ namespace saving
     {
         saving_context svg_ctx;
         svg_ctx.compression = cdf.compression;
-        if (cdf.compression == cdf_compression_type::no_compression)
+        if (cdf.compression == cdf_compression_type::auto_compression)
+        {
+            const auto& decision
+                = svg_ctx.compression_decisions.emplace_back(choose_compression(cdf));
+            svg_ctx.compression = decision.type;
+        }
+        svg_ctx.compression_level = cdf.compression_level;
+        svg_ctx.body.layout = cdf.layout;
+        if (svg_ctx.compression == cdf_compression_type::no_compression)
         {
             svg_ctx.magic = { 0xCDF30001, 0x0000FFFF };
         }
@@ -201,7 +310,7 @@ namespace saving
         {
             svg_ctx.magic = { 0xCDF30001, 0xCCCC0001 };
             svg_ctx.ccr = record_wrapper<cdf_CCR_t<v3x_tag>> { { {}, 0, 0, 0, {} } };
-            svg_ctx.cpr = make_cpr(cdf.compression);
+            svg_ctx.cpr = make_cpr(svg_ctx.compression, cdf.compression_level);
         }
         svg_ctx.body.cdr.record
             = cdf_CDR_t<v3x_tag> { {}, 0, 3, 8, CDFpp_ENCODING, 3, 0, 0, 0, 2, 0, { R"(
@@ -226,25 +335,18 @@ Greenbelt, Maryland 20771 USA
         svg_ctx.body.gdr.record.eof = eof;
     }
 
-    inline void apply_compression(saving_context& svg_ctx)
+    // the uncompressed body spans from the end of the magic numbers to the end of file
+    inline void update_ccr(saving_context& svg_ctx, std::size_t eof)
     {
-        if (svg_ctx.ccr and svg_ctx.cpr)
+        if (svg_ctx.ccr)
         {
-            svg_ctx.ccr->record.data.values.reserve(svg_ctx.body.gdr.record.eof);
-            buffers::vector_writer writer { svg_ctx.ccr->record.data.values };
-            write_body(svg_ctx.body, writer, 8);
-            svg_ctx.ccr->record.uSize = std::size(writer.data);
-            svg_ctx.ccr->record.data.values
-                = compression::deflate(svg_ctx.compression, writer.data);
-            update_size(svg_ctx.ccr.value());
-            svg_ctx.cpr->offset = svg_ctx.ccr->offset + svg_ctx.ccr->size;
-            svg_ctx.ccr->record.CPRoffset = svg_ctx.cpr->offset;
+            svg_ctx.ccr->record.uSize = eof - 8;
         }
     }
 
 
-    template <typename T>
-    [[nodiscard]] bool impl_save(const CDF& cdf, T& writer)
+    // builds, lays out and links every record, the returned context is ready to be written
+    [[nodiscard]] inline saving_context build_saving_context(const CDF& cdf)
     {
         saving_context svg_ctx = make_saving_context(cdf);
         create_file_attributes_records(cdf, svg_ctx);
@@ -252,16 +354,112 @@ Greenbelt, Maryland 20771 USA
         auto eof = map_records(svg_ctx);
         link_records(svg_ctx);
         update_gdr(svg_ctx, eof);
-        apply_compression(svg_ctx);
+        update_ccr(svg_ctx, eof);
+        return svg_ctx;
+    }
+
+    template <typename T>
+    [[nodiscard]] bool impl_save(const CDF& cdf, T& writer)
+    {
+        saving_context svg_ctx = build_saving_context(cdf);
         write_records(svg_ctx, writer);
-        return true;
+        // some writers reference records owned by svg_ctx until they are flushed
+        return writer.flush();
+    }
+
+#ifdef USE_PWRITEV
+    [[nodiscard]] inline std::size_t values_records_end(const variable_ctx& variable_ctx)
+    {
+        return visit(variable_ctx.values_records.back(),
+            [](const auto& values_record) { return values_record.offset + values_record.size; });
+    }
+
+    // everything but the values records, they are left as holes filled by other writers
+    inline void write_metadata(const saving_context& svg_ctx, buffers::vectored_file_writer& writer)
+    {
+        save_record(svg_ctx.magic, writer);
+        write_record(svg_ctx.body.cdr, writer);
+        write_record(svg_ctx.body.gdr, writer);
+        write_file_attributes(svg_ctx.body.file_attributes, writer);
+        if (svg_ctx.body.layout == cdf_layout::metadata_first)
+        {
+            write_variables_attributes(svg_ctx.body.variable_attributes, writer);
+            for (auto& variable_ctx : svg_ctx.body.variables)
+                write_variable_descriptors(variable_ctx, writer);
+        }
+        else
+        {
+            for (auto& variable_ctx : svg_ctx.body.variables)
+            {
+                write_variable_descriptors(variable_ctx, writer);
+                if (std::size(variable_ctx.values_records))
+                {
+                    writer.seek(values_records_end(variable_ctx));
+                }
+            }
+            write_variables_attributes(svg_ctx.body.variable_attributes, writer);
+        }
+        writer.flush();
+    }
+
+    /*
+     * The layout gives the final offset of every record before anything is written, so the
+     * metadata and the values records of each variable are written concurrently at their final
+     * position in a preallocated file. Only the writes run here, CVVRs were already compressed
+     * on the pool when the saving context was built.
+     */
+    [[nodiscard]] inline bool impl_save_parallel(
+        const CDF& cdf, buffers::vectored_file_writer& writer)
+    {
+        saving_context svg_ctx = build_saving_context(cdf);
+        writer.preallocate(svg_ctx.body.gdr.record.eof);
+        std::vector<const variable_ctx*> variables;
+        for (const auto& variable_ctx : svg_ctx.body.variables)
+        {
+            if (std::size(variable_ctx.values_records))
+            {
+                // lazy variables are loaded here, on the calling thread
+                if (not variable_ctx.raw)
+                    std::ignore = variable_ctx.variable->bytes_ptr();
+                variables.push_back(&variable_ctx);
+            }
+        }
+        std::atomic<bool> values_written { true };
+        parallel::parallel_for(std::size(variables) + 1,
+            [&svg_ctx, &variables, &writer, &values_written](std::size_t index)
+            {
+                if (index == std::size(variables))
+                {
+                    write_metadata(svg_ctx, writer);
+                    return;
+                }
+                const auto& variable_ctx = *variables[index];
+                const auto offset = visit(variable_ctx.values_records.front(),
+                    [](const auto& values_record) { return values_record.offset; });
+                buffers::vectored_file_writer values_writer { writer.fd, offset };
+                write_values_records(variable_ctx, values_writer);
+                if (not values_writer.flush())
+                    values_written = false;
+            });
+        return values_written and writer.good();
     }
+#endif
 
 } // namespace
 
 
 [[nodiscard]] inline bool save(const CDF& cdf, const std::string& path)
 {
+#ifdef USE_PWRITEV
+    // the compressed stream goes through reused buffers, it can't be referenced in place
+    if (cdf.compression == cdf_compression_type::no_compression)
+    {
+        buffers::vectored_file_writer writer { path };
+        if (not writer.is_open())
+            return false;
+        return saving::impl_save_parallel(cdf, writer);
+    }
+#endif
     buffers::file_writer writer { path };
     return saving::impl_save(cdf, writer);
 }
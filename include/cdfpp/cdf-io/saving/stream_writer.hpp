@@ -0,0 +1,169 @@
+#pragma once
+/*------------------------------------------------------------------------------
+-- This file is a part of the CDFpp library
+-- Copyright (C) 2022, Plasma Physics Laboratory - CNRS
+--
+-- This program is free software; you can redistribute it and/or modify
+-- it under the terms of the GNU General Public License as published by
+-- the Free Software Foundation; either version 2 of the License, or
+-- (at your option) any later version.
+--
+-- This program is distributed in the hope that it will be useful,
+-- but WITHOUT ANY WARRANTY; without even the implied warranty of
+-- MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+-- GNU General Public License for more details.
+--
+-- You should have received a copy of the GNU General Public License
+-- along with this program; if not, write to the Free Software
+-- Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA 02111-1307 USA
+-------------------------------------------------------------------------------*/
+/*-- Author : Alexis Jeandet
+-- Mail : alexis.jeandet@member.fsf.org
+----------------------------------------------------------------------------*/
+
+#include "../desc-records.hpp"
+#include "./buffers.hpp"
+#include "./create_records.hpp"
+#include "./records-appending.hpp"
+#include "./records-saving.hpp"
+#include "./saving.hpp"
+#include "cdfpp/cdf-enums.hpp"
+#include "cdfpp/cdf-file.hpp"
+#include "cdfpp/cdf-map.hpp"
+#include "cdfpp/no_init_vector.hpp"
+#include <algorithm>
+#include <stdexcept>
+#include <string>
+#include <utility>
+
+namespace cdf::io
+{
+
+/*
+ * Writes a CDF file incrementally. Attributes and variables are declared up front by the CDF
+ * given to the constructor (record varying variables usually with no record), then batches of
+ * records are appended and written right away as VVR or CVVR blocks. New VXRs are allocated at
+ * the end of the file and chained to the previous ones, only the last VXR of each variable is
+ * kept in memory. After each flush() the file is a valid CDF, VDRs, VXRs and the GDR being
+ * rewritten in place.
+ */
+class stream_writer
+{
+    struct streamed_variable
+    {
+        CDF_Types type;
+        bool is_nrv;
+        saving::appending_context<cdf_zVDR_t<v3x_tag>> appending;
+        bool dirty = false;
+    };
+
+    buffers::file_writer p_writer;
+    record_wrapper<cdf_GDR_t<v3x_tag>> p_gdr;
+    cdf_map<std::string, streamed_variable> p_variables;
+
+    template <typename T>
+    void rewrite(const record_wrapper<T>& r)
+    {
+        saving::rewrite_record(r.record, r.offset, p_writer);
+    }
+
+public:
+    stream_writer(const std::string& path, const CDF& declaration) : p_writer { path }
+    {
+        if (not p_writer.is_open())
+            throw std::runtime_error { "Failed to open " + path };
+        if (declaration.compression != cdf_compression_type::no_compression)
+            throw std::invalid_argument { "Whole file compression can't be used when streaming" };
+        auto svg_ctx = saving::build_saving_context(declaration);
+        saving::write_records(svg_ctx, p_writer);
+        p_gdr = svg_ctx.body.gdr;
+        for (auto& var_ctx : svg_ctx.body.variables)
+        {
+            const auto& variable = *var_ctx.variable;
+            const auto record_size
+                = std::max(std::size_t { 1 },
+                      flat_size(std::cbegin(variable.shape()) + 1, std::cend(variable.shape())))
+                * cdf_type_size(variable.type());
+            // declared without records, the first VXR is created by the first append
+            auto last_vxr = std::empty(var_ctx.vxrs)
+                ? record_wrapper<cdf_VXR_t<v3x_tag>> { cdf_VXR_t<v3x_tag> {
+                    {}, 0, 0, 0, {}, {}, {} } }
+                : var_ctx.vxrs.back();
+            p_variables[variable.name()] = streamed_variable { variable.type(),
+                variable.is_nrv(),
+                { var_ctx.compression, var_ctx.compression_level, record_size,
+                    saving::records_per_values_record(declaration, variable, record_size),
+                    variable.len(), var_ctx.vdr, std::move(last_vxr) } };
+        }
+        p_writer.flush();
+    }
+
+    stream_writer(const stream_writer&) = delete;
+    stream_writer& operator=(const stream_writer&) = delete;
+
+    ~stream_writer()
+    {
+        if (is_open())
+        {
+            try
+            {
+                close();
+            }
+            catch (...)
+            {
+            }
+        }
+    }
+
+    [[nodiscard]] bool is_open() const noexcept { return p_writer.is_open(); }
+
+    // values must hold whole records of the declared variable type, in row major order
+    void append(const std::string& name, const data_t& values)
+    {
+        auto it = p_variables.find(name);
+        if (it == std::end(p_variables))
+            throw std::invalid_argument { "Unknown variable: " + name };
+        auto& variable = it->second;
+        if (variable.is_nrv)
+            throw std::invalid_argument { "Can't append records to NRV variable: " + name };
+        if (values.type() != variable.type)
+            throw std::invalid_argument { "Type mismatch while appending to variable: " + name };
+        const auto record_size = variable.appending.record_size;
+        if (values.bytes() % record_size != 0)
+            throw std::invalid_argument {
+                "Appending a partial record to variable: " + name
+            };
+        saving::append_records(
+            variable.appending, values.bytes_ptr(), values.bytes() / record_size, p_writer);
+        variable.dirty = true;
+    }
+
+    [[nodiscard]] std::size_t records(const std::string& name) const
+    {
+        return p_variables.at(name).appending.records;
+    }
+
+    void flush()
+    {
+        for (auto& [name, variable] : p_variables)
+        {
+            if (variable.dirty)
+            {
+                rewrite(variable.appending.vxr);
+                rewrite(variable.appending.vdr);
+                variable.dirty = false;
+            }
+        }
+        p_gdr.record.eof = p_writer.offset();
+        rewrite(p_gdr);
+        p_writer.flush();
+    }
+
+    void close()
+    {
+        flush();
+        p_writer.close();
+    }
+};
+
+}
@@ -0,0 +1,193 @@
+#pragma once
+/*------------------------------------------------------------------------------
+-- This file is a part of the CDFpp library
+-- Copyright (C) 2019, Plasma Physics Laboratory - CNRS
+--
+-- This program is free software; you can redistribute it and/or modify
+-- it under the terms of the GNU General Public License as published by
+-- the Free Software Foundation; either version 2 of the License, or
+-- (at your option) any later version.
+--
+-- This program is distributed in the hope that it will be useful,
+-- but WITHOUT ANY WARRANTY; without even the implied warranty of
+-- MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+-- GNU General Public License for more details.
+--
+-- You should have received a copy of the GNU General Public License
+-- along with this program; if not, write to the Free Software
+-- Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA 02111-1307 USA
+-------------------------------------------------------------------------------*/
+/*-- Author : Alexis Jeandet
+-- Mail : alexis.jeandet@member.fsf.org
+----------------------------------------------------------------------------*/
+#include <cstddef>
+#include <cstdint>
+
+#if (defined(__x86_64__) || defined(__i386__)) && (defined(__GNUC__) || defined(__clang__))
+#define CDFPP_X86_DISPATCH
+#include <immintrin.h>
+#endif
+
+/*
+ * Vectorized byte swap of 2, 4 and 8 bytes values with pshufb/vpshufb. The widest instruction
+ * set supported by the CPU is picked at runtime so that builds stay portable, other compilers
+ * and architectures only get the scalar path from endianness.hpp.
+ */
+namespace cdf::endianness::simd
+{
+
+enum class instruction_set
+{
+    scalar = 0,
+    ssse3 = 1,
+    avx2 = 2,
+    avx512 = 3
+};
+
+#ifdef CDFPP_X86_DISPATCH
+namespace
+{
+    // bytes of each value in reverse order, pshufb works on 128 bits lanes
+    template <std::size_t value_size>
+    struct shuffle_mask
+    {
+        alignas(64) int8_t bytes[64] {};
+        constexpr shuffle_mask()
+        {
+            for (std::size_t i = 0; i < 64; i++)
+            {
+                const auto in_lane = i % 16;
+                bytes[i] = static_cast<int8_t>(
+                    (in_lane / value_size) * value_size + value_size - 1 - in_lane % value_size);
+            }
+        }
+    };
+
+    template <std::size_t value_size>
+    inline constexpr shuffle_mask<value_size> mask {};
+
+    template <std::size_t value_size>
+    __attribute__((target("ssse3"))) std::size_t byte_swap_ssse3(char* data, std::size_t count)
+    {
+        const auto shuffle
+            = _mm_load_si128(reinterpret_cast<const __m128i*>(mask<value_size>.bytes));
+        const auto bytes = count * value_size;
+        std::size_t offset = 0;
+        for (; offset + 16 <= bytes; offset += 16)
+        {
+            auto* p = reinterpret_cast<__m128i*>(data + offset);
+            _mm_storeu_si128(p, _mm_shuffle_epi8(_mm_loadu_si128(p), shuffle));
+        }
+        return offset / value_size;
+    }
+
+    template <std::size_t value_size>
+    __attribute__((target("avx2"))) std::size_t byte_swap_avx2(char* data, std::size_t count)
+    {
+        const auto shuffle
+            = _mm256_load_si256(reinterpret_cast<const __m256i*>(mask<value_size>.bytes));
+        const auto bytes = count * value_size;
+        std::size_t offset = 0;
+        for (; offset + 128 <= bytes; offset += 128)
+        {
+            auto* p = reinterpret_cast<__m256i*>(data + offset);
+            const auto v0 = _mm256_loadu_si256(p);
+            const auto v1 = _mm256_loadu_si256(p + 1);
+            const auto v2 = _mm256_loadu_si256(p + 2);
+            const auto v3 = _mm256_loadu_si256(p + 3);
+            _mm256_storeu_si256(p, _mm256_shuffle_epi8(v0, shuffle));
+            _mm256_storeu_si256(p + 1, _mm256_shuffle_epi8(v1, shuffle));
+            _mm256_storeu_si256(p + 2, _mm256_shuffle_epi8(v2, shuffle));
+            _mm256_storeu_si256(p + 3, _mm256_shuffle_epi8(v3, shuffle));
+        }
+        for (; offset + 32 <= bytes; offset += 32)
+        {
+            auto* p = reinterpret_cast<__m256i*>(data + offset);
+            _mm256_storeu_si256(p, _mm256_shuffle_epi8(_mm256_loadu_si256(p), shuffle));
+        }
+        return offset / value_size;
+    }
+
+    template <std::size_t value_size>
+    __attribute__((target("avx512f,avx512bw"))) std::size_t byte_swap_avx512(
+        char* data, std::size_t count)
+    {
+        const auto shuffle = _mm512_load_si512(mask<value_size>.bytes);
+        const auto bytes = count * value_size;
+        std::size_t offset = 0;
+        for (; offset + 256 <= bytes; offset += 256)
+        {
+            char* p = data + offset;
+            const auto v0 = _mm512_loadu_si512(p);
+            const auto v1 = _mm512_loadu_si512(p + 64);
+            const auto v2 = _mm512_loadu_si512(p + 128);
+            const auto v3 = _mm512_loadu_si512(p + 192);
+            _mm512_storeu_si512(p, _mm512_shuffle_epi8(v0, shuffle));
+            _mm512_storeu_si512(p + 64, _mm512_shuffle_epi8(v1, shuffle));
+            _mm512_storeu_si512(p + 128, _mm512_shuffle_epi8(v2, shuffle));
+            _mm512_storeu_si512(p + 192, _mm512_shuffle_epi8(v3, shuffle));
+        }
+        for (; offset + 64 <= bytes; offset += 64)
+        {
+            char* p = data + offset;
+            _mm512_storeu_si512(p, _mm512_shuffle_epi8(_mm512_loadu_si512(p), shuffle));
+        }
+        return offset / value_size;
+    }
+
+    // __builtin_cpu_supports also checks that the OS saves the wide registers
+    inline instruction_set detect_instruction_set() noexcept
+    {
+        __builtin_cpu_init();
+        if (__builtin_cpu_supports("avx512bw"))
+            return instruction_set::avx512;
+        if (__builtin_cpu_supports("avx2"))
+            return instruction_set::avx2;
+        if (__builtin_cpu_supports("ssse3"))
+            return instruction_set::ssse3;
+        return instruction_set::scalar;
+    }
+}
+#endif
+
+[[nodiscard]] inline instruction_set detected_instruction_set() noexcept
+{
+#ifdef CDFPP_X86_DISPATCH
+    static const instruction_set detected = detect_instruction_set();
+    return detected;
+#else
+    return instruction_set::scalar;
+#endif
+}
+
+/*
+ * Swaps the leading values of data in place and returns how many were swapped, the remaining
+ * ones (less than a vector) are left to the caller. Requesting an instruction set the CPU
+ * doesn't support falls back to the detected one.
+ */
+template <std::size_t value_size>
+[[nodiscard]] inline std::size_t byte_swap([[maybe_unused]] char* data,
+    [[maybe_unused]] std::size_t count,
+    [[maybe_unused]] instruction_set requested = detected_instruction_set()) noexcept
+{
+#ifdef CDFPP_X86_DISPATCH
+    if constexpr (value_size == 2 or value_size == 4 or value_size == 8)
+    {
+        const auto detected = detected_instruction_set();
+        switch (static_cast<int>(requested) < static_cast<int>(detected) ? requested : detected)
+        {
+            case instruction_set::avx512:
+                return byte_swap_avx512<value_size>(data, count);
+            case instruction_set::avx2:
+                return byte_swap_avx2<value_size>(data, count);
+            case instruction_set::ssse3:
+                return byte_swap_ssse3<value_size>(data, count);
+            default:
+                break;
+        }
+    }
+#endif
+    return 0;
+}
+
+} // namespace cdf::endianness::simd
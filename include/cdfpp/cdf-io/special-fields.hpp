@@ -22,6 +22,7 @@
 ----------------------------------------------------------------------------*/
 #include <cstddef>
 #include <string>
+#include <string_view>
 #include <vector>
 #include "../no_init_vector.hpp"
 
@@ -71,3 +72,33 @@ struct is_table_field<T,
 template <typename T>
 static inline constexpr bool is_table_field_v
     = is_table_field<std::remove_cv_t<std::remove_reference_t<T>>>::value;
+
+
+/*
+ * Non owning table, values point directly into the loaded buffer and are only valid as long as
+ * this buffer lives. Used for large opaque payloads (compressed blocks) to avoid copying them.
+ */
+template <typename T, std::size_t _index = 0>
+struct table_view_field
+{
+    static_assert(sizeof(T) == 1, "table_view_field only supports raw bytes");
+    using value_type = T;
+    static constexpr std::size_t index = _index;
+    std::basic_string_view<T> values;
+};
+
+template <typename T, typename = void>
+struct is_table_view_field : std::false_type
+{
+};
+
+template <typename T>
+struct is_table_view_field<T,
+    decltype(std::is_same_v<table_view_field<typename T::value_type, T::index>, T>, void())>
+        : std::is_same<table_view_field<typename T::value_type, T::index>, T>
+{
+};
+
+template <typename T>
+static inline constexpr bool is_table_view_field_v
+    = is_table_view_field<std::remove_cv_t<std::remove_reference_t<T>>>::value;
@@ -21,8 +21,11 @@
 -- Mail : alexis.jeandet@member.fsf.org
 ----------------------------------------------------------------------------*/
 #include "../cdf-debug.hpp"
+#include "cdfpp/cdf-enums.hpp"
 #include "cdfpp/no_init_vector.hpp"
+#include <algorithm>
 #include <cstddef>
+#include <stdexcept>
 #include <vector>
 #define ZLIB_CONST
 #include <zlib.h>
@@ -32,6 +35,89 @@ namespace cdf::io::zlib
 {
 namespace _internal
 {
+    // z_streams are expensive to set up, each thread keeps one of each kind and resets it
+    // between blocks
+    struct inflate_stream
+    {
+        z_stream stream;
+        bool initialized = false;
+
+        inflate_stream()
+        {
+            stream.zalloc = Z_NULL;
+            stream.zfree = Z_NULL;
+            stream.opaque = Z_NULL;
+            stream.avail_in = 0;
+            stream.next_in = Z_NULL;
+        }
+        ~inflate_stream()
+        {
+            if (initialized)
+                inflateEnd(&stream);
+        }
+
+        z_stream* acquire()
+        {
+            if (!initialized)
+                initialized = (Z_OK == inflateInit2(&stream, 32 + MAX_WBITS));
+            else if (Z_OK != inflateReset(&stream))
+                return nullptr;
+            return initialized ? &stream : nullptr;
+        }
+    };
+
+    // the level is changed with deflateParams when a block asks for a different one
+    struct deflate_stream
+    {
+        z_stream stream;
+        bool initialized = false;
+        int level = default_compression_level;
+
+        deflate_stream()
+        {
+            stream.zalloc = Z_NULL;
+            stream.zfree = Z_NULL;
+            stream.opaque = Z_NULL;
+        }
+        ~deflate_stream()
+        {
+            if (initialized)
+                deflateEnd(&stream);
+        }
+
+        z_stream* acquire(int requested_level)
+        {
+            requested_level = std::clamp(requested_level, 0, Z_BEST_COMPRESSION);
+            if (!initialized)
+            {
+                initialized = (Z_OK
+                    == deflateInit2(&stream, requested_level, Z_DEFLATED, 15 | 16, 6,
+                        Z_DEFAULT_STRATEGY));
+                level = requested_level;
+            }
+            else if (Z_OK != deflateReset(&stream))
+                return nullptr;
+            if (initialized and requested_level != level)
+            {
+                if (Z_OK != deflateParams(&stream, requested_level, Z_DEFAULT_STRATEGY))
+                    return nullptr;
+                level = requested_level;
+            }
+            return initialized ? &stream : nullptr;
+        }
+    };
+
+    inline z_stream* thread_inflate_stream()
+    {
+        thread_local inflate_stream stream;
+        return stream.acquire();
+    }
+
+    inline z_stream* thread_deflate_stream(int level)
+    {
+        thread_local deflate_stream stream;
+        return stream.acquire(level);
+    }
 
     // Taken from:
     //   https://github.com/qpdf/qpdf/blob/master/libqpdf/Pl_Flate.cc
@@ -39,49 +125,37 @@ namespace _internal
     CDF_WARN_UNUSED_RESULT std::size_t impl_inflate(
         const T& input, char* output, const std::size_t output_size)
     {
-
-        z_stream fstream;
-        fstream.zalloc = Z_NULL;
-        fstream.zfree = Z_NULL;
-        fstream.opaque = Z_NULL;
-        fstream.avail_in = std::size(input);
-        fstream.next_in = reinterpret_cast<const Bytef*>(input.data());
-        fstream.avail_out = output_size;
-        fstream.next_out = reinterpret_cast<Bytef*>(output);
-
-        if (Z_OK != inflateInit2(&fstream, 32 + MAX_WBITS))
+        z_stream* fstream = thread_inflate_stream();
+        if (fstream == nullptr)
             return 0;
+        fstream->avail_in = std::size(input);
+        fstream->next_in = reinterpret_cast<const Bytef*>(input.data());
+        fstream->avail_out = output_size;
+        fstream->next_out = reinterpret_cast<Bytef*>(output);
 
-        auto ret = inflate(&fstream, Z_FINISH);
-        inflateEnd(&fstream);
+        auto ret = inflate(fstream, Z_FINISH);
 
         if (ret == Z_STREAM_END)
-            return output_size - fstream.avail_out;
+            return output_size - fstream->avail_out;
         else
             return 0;
     }
 
     template <typename T>
-    CDF_WARN_UNUSED_RESULT no_init_vector<char> impl_deflate(const T& input)
+    CDF_WARN_UNUSED_RESULT no_init_vector<char> impl_deflate(const T& input, int level)
     {
-        no_init_vector<char> result(std::max(std::size(input), 16 * 1024UL));
-        z_stream fstream;
-        fstream.zalloc = Z_NULL;
-        fstream.zfree = Z_NULL;
-        fstream.opaque = Z_NULL;
-        fstream.avail_in = std::size(input);
-        fstream.next_in = reinterpret_cast<const Bytef*>(input.data());
-        fstream.avail_out = std::size(result);
-        fstream.next_out = reinterpret_cast<Bytef*>(result.data());
-        if (Z_OK
-            != deflateInit2(
-                &fstream, Z_DEFAULT_COMPRESSION, Z_DEFLATED, 15 | 16, 6, Z_DEFAULT_STRATEGY))
+        z_stream* fstream = thread_deflate_stream(level);
+        if (fstream == nullptr)
             return {};
-        auto ret = deflate(&fstream, Z_FINISH);
-        deflateEnd(&fstream);
+        no_init_vector<char> result(deflateBound(fstream, std::size(input)));
+        fstream->avail_in = std::size(input);
+        fstream->next_in = reinterpret_cast<const Bytef*>(input.data());
+        fstream->avail_out = std::size(result);
+        fstream->next_out = reinterpret_cast<Bytef*>(result.data());
+        auto ret = deflate(fstream, Z_FINISH);
         if (ret == Z_STREAM_END)
         {
-            result.resize(fstream.total_out);
+            result.resize(fstream->total_out);
             result.shrink_to_fit();
             return result;
         }
@@ -98,9 +172,76 @@ std::size_t gzinflate(const T& input, char* output, const std::size_t output_siz
 }
 
 template <typename T>
-no_init_vector<char> gzdeflate(const T& input)
+no_init_vector<char> gzdeflate(const T& input, int level = default_compression_level)
 {
     using namespace _internal;
-    return impl_deflate(input);
+    return impl_deflate(input, level);
 }
+/*
+ * Incremental gzip encoder, the whole stream is produced through a small fixed size buffer so
+ * that memory usage doesn't depend on the amount of data compressed.
+ */
+class gzdeflate_stream
+{
+    static inline constexpr std::size_t buffer_size = 1 << 18;
+    static inline constexpr std::size_t max_input_slice = 1 << 30;
+
+    z_stream p_stream;
+    no_init_vector<char> p_buffer;
+
+    template <typename sink_t>
+    void run(const char* data, std::size_t size, int flush, sink_t& sink)
+    {
+        do
+        {
+            const auto slice = std::min(size, max_input_slice);
+            const auto slice_flush = (slice == size) ? flush : Z_NO_FLUSH;
+            p_stream.next_in = reinterpret_cast<const Bytef*>(data);
+            p_stream.avail_in = static_cast<uInt>(slice);
+            int ret = Z_OK;
+            do
+            {
+                p_stream.next_out = reinterpret_cast<Bytef*>(p_buffer.data());
+                p_stream.avail_out = static_cast<uInt>(buffer_size);
+                ret = deflate(&p_stream, slice_flush);
+                if (ret == Z_STREAM_ERROR)
+                    throw std::runtime_error { "gzip stream compression failed" };
+                if (const auto produced = buffer_size - p_stream.avail_out; produced != 0)
+                    sink(p_buffer.data(), produced);
+            } while (p_stream.avail_out == 0 or (slice_flush == Z_FINISH and ret != Z_STREAM_END));
+            data += slice;
+            size -= slice;
+        } while (size != 0);
+    }
+
+public:
+    explicit gzdeflate_stream(int level = default_compression_level) : p_buffer(buffer_size)
+    {
+        p_stream.zalloc = Z_NULL;
+        p_stream.zfree = Z_NULL;
+        p_stream.opaque = Z_NULL;
+        if (Z_OK
+            != deflateInit2(&p_stream, std::clamp(level, 0, Z_BEST_COMPRESSION), Z_DEFLATED,
+                15 | 16, 6, Z_DEFAULT_STRATEGY))
+            throw std::runtime_error { "Failed to initialize gzip stream" };
+    }
+    gzdeflate_stream(const gzdeflate_stream&) = delete;
+    gzdeflate_stream& operator=(const gzdeflate_stream&) = delete;
+    ~gzdeflate_stream() { deflateEnd(&p_stream); }
+
+    // sink is called as sink(const char* data, std::size_t size) with compressed bytes
+    template <typename sink_t>
+    void write(const char* data, std::size_t size, sink_t&& sink)
+    {
+        if (size != 0)
+            run(data, size, Z_NO_FLUSH, sink);
+    }
+
+    template <typename sink_t>
+    void finish(sink_t&& sink)
+    {
+        run(nullptr, 0UL, Z_FINISH, sink);
+    }
+};
+
 }
@@ -20,14 +20,135 @@
 /*-- Author : Alexis Jeandet
 -- Mail : alexis.jeandet@member.fsf.org
 ----------------------------------------------------------------------------*/
+#include <atomic>
+#include <cstddef>
 #include <memory>
+#include <mutex>
+#include <new>
 #include <string.h>
+#include <type_traits>
 #include <vector>
 #if __has_include(<sys/mman.h>)
 #include <stdlib.h>
 #include <sys/mman.h>
 #endif
 
+/*
+ * Monotonic arena used to back small vectors (attribute values, shapes, small variables) of a
+ * given CDF file. Allocations bump an atomic cursor in the current chunk, the mutex is only taken
+ * to start a new chunk. Memory is given back when the arena is destroyed, except for the last
+ * allocation of the current chunk which is rolled back when deallocated.
+ */
+class monotonic_arena
+{
+    static inline constexpr std::size_t chunk_size = 1 << 18;
+    static inline constexpr std::size_t alignment = alignof(std::max_align_t);
+
+    struct alignas(std::max_align_t) chunk_t
+    {
+        std::atomic<std::size_t> used;
+        chunk_t* previous;
+
+        [[nodiscard]] char* data() noexcept { return reinterpret_cast<char*>(this + 1); }
+        [[nodiscard]] bool owns(const void* ptr) noexcept
+        {
+            const auto* bytes = static_cast<const char*>(ptr);
+            return bytes >= data() and bytes < data() + chunk_size;
+        }
+    };
+
+public:
+    static inline constexpr std::size_t max_allocation_size = 1 << 14;
+
+    monotonic_arena() = default;
+    monotonic_arena(const monotonic_arena&) = delete;
+    monotonic_arena(monotonic_arena&&) = delete;
+    monotonic_arena& operator=(const monotonic_arena&) = delete;
+    monotonic_arena& operator=(monotonic_arena&&) = delete;
+
+    ~monotonic_arena()
+    {
+        for (auto chunk = p_current.load(); chunk != nullptr;)
+        {
+            auto previous = chunk->previous;
+            chunk->~chunk_t();
+            ::free(chunk);
+            chunk = previous;
+        }
+    }
+
+    [[nodiscard]] void* allocate(std::size_t bytes)
+    {
+        bytes = aligned(bytes);
+        while (true)
+        {
+            auto chunk = p_current.load(std::memory_order_acquire);
+            if (chunk != nullptr)
+            {
+                // overshooting the chunk is harmless, it is never bumped again
+                const auto offset = chunk->used.fetch_add(bytes, std::memory_order_relaxed);
+                if (offset + bytes <= chunk_size)
+                    return chunk->data() + offset;
+            }
+            std::lock_guard<std::mutex> lock { p_mutex };
+            if (p_current.load(std::memory_order_relaxed) != chunk)
+                continue; // another thread just started a new chunk
+            void* mem = ::malloc(sizeof(chunk_t) + chunk_size);
+            if (mem == nullptr)
+                throw std::bad_alloc();
+            auto new_chunk = ::new (mem) chunk_t { { bytes }, chunk };
+            p_current.store(new_chunk, std::memory_order_release);
+            return new_chunk->data();
+        }
+    }
+
+    // gives the memory back if it is the last allocation of the current chunk
+    void deallocate(void* ptr, std::size_t bytes) noexcept
+    {
+        auto chunk = p_current.load(std::memory_order_acquire);
+        if (chunk != nullptr and chunk->owns(ptr))
+        {
+            const auto offset = static_cast<std::size_t>(static_cast<char*>(ptr) - chunk->data());
+            auto end = offset + aligned(bytes);
+            chunk->used.compare_exchange_strong(end, offset, std::memory_order_relaxed);
+        }
+    }
+
+    [[nodiscard]] bool owns(const void* ptr) const noexcept
+    {
+        for (auto chunk = p_current.load(std::memory_order_acquire); chunk != nullptr;
+             chunk = chunk->previous)
+        {
+            if (chunk->owns(ptr))
+                return true;
+        }
+        return false;
+    }
+
+    [[nodiscard]] static bool handles(std::size_t bytes) noexcept
+    {
+        return bytes <= max_allocation_size;
+    }
+
+    [[nodiscard]] std::size_t chunks_count() const noexcept
+    {
+        std::size_t count = 0;
+        for (auto chunk = p_current.load(std::memory_order_acquire); chunk != nullptr;
+             chunk = chunk->previous)
+            count++;
+        return count;
+    }
+
+private:
+    [[nodiscard]] static std::size_t aligned(std::size_t bytes) noexcept
+    {
+        return (bytes + alignment - 1) & ~(alignment - 1);
+    }
+
+    std::mutex p_mutex;
+    std::atomic<chunk_t*> p_current { nullptr };
+};
+
 /*
  * taken from:
  *  https://stackoverflow.com/questions/21028299/is-this-behavior-of-vectorresizesize-type-n-under-c11-and-boost-container/21028912#21028912
@@ -50,7 +171,52 @@ public:
         using other = default_init_allocator<U, typename a_t::template rebind_alloc<U>>;
     };
 
-    using A::A;
+    // allocators bound to an arena must follow their containers
+    using propagate_on_container_copy_assignment = std::false_type;
+    using propagate_on_container_move_assignment = std::true_type;
+    using propagate_on_container_swap = std::true_type;
+    using is_always_equal = std::false_type;
+
+    default_init_allocator() noexcept = default;
+    default_init_allocator(const default_init_allocator&) noexcept = default;
+    default_init_allocator(default_init_allocator&&) noexcept = default;
+    default_init_allocator& operator=(const default_init_allocator&) noexcept = default;
+    default_init_allocator& operator=(default_init_allocator&&) noexcept = default;
+
+    // containers share the arena with the loaded CDF, they may outlive it
+    explicit default_init_allocator(std::shared_ptr<monotonic_arena> arena) noexcept
+            : p_arena { std::move(arena) }
+    {
+    }
+
+    template <typename U, typename B>
+    default_init_allocator(const default_init_allocator<U, B>& other) noexcept
+            : A { other }, p_arena { other.arena() }
+    {
+    }
+
+    // copies of a container are allocated from the heap, they may outlive the source arena
+    [[nodiscard]] default_init_allocator select_on_container_copy_construction() const noexcept
+    {
+        return default_init_allocator {};
+    }
+
+    [[nodiscard]] const std::shared_ptr<monotonic_arena>& arena() const noexcept
+    {
+        return p_arena;
+    }
+
+    template <typename U, typename B>
+    [[nodiscard]] bool operator==(const default_init_allocator<U, B>& other) const noexcept
+    {
+        return p_arena == other.arena();
+    }
+
+    template <typename U, typename B>
+    [[nodiscard]] bool operator!=(const default_init_allocator<U, B>& other) const noexcept
+    {
+        return !(*this == other);
+    }
 
     template <typename U>
     void construct(U* ptr) noexcept(std::is_nothrow_default_constructible_v<U>)
@@ -63,12 +229,20 @@ public:
         a_t::construct(static_cast<A&>(*this), ptr, std::forward<Args>(args)...);
     }
 
-#if __has_include(<sys/mman.h>)
     template <bool U = is_trivial_and_nothrow_default_constructible>
     T* allocate(std::size_t pCount, const T* = 0, typename std::enable_if<U>::type* = 0)
     {
-        void* mem = 0;
         auto bytes = sizeof(T) * pCount;
+        // only the first allocation comes from the arena, a container growing after that is
+        // reallocated from the heap
+        if (p_arena and not p_arena_used and monotonic_arena::handles(bytes))
+        {
+            p_arena_used = true;
+            p_arena_block = reinterpret_cast<T*>(p_arena->allocate(bytes));
+            return p_arena_block;
+        }
+#if __has_include(<sys/mman.h>)
+        void* mem = 0;
         if (bytes >= 2 * page_size)
         {
             if (::posix_memalign(&mem, page_size, sizeof(T) * pCount) != 0)
@@ -85,6 +259,9 @@ public:
         }
         //::memset(reinterpret_cast<char*>(mem),0x9e,bytes);
         return reinterpret_cast<T*>(mem);
+#else
+        return A::allocate(pCount);
+#endif
     }
 
     template <bool U = is_trivial_and_nothrow_default_constructible>
@@ -94,10 +271,20 @@ public:
     }
 
     template <bool U = is_trivial_and_nothrow_default_constructible>
-    void deallocate(T* ptr, std::size_t, typename std::enable_if<U>::type* = 0) noexcept(
+    void deallocate(T* ptr, std::size_t sz, typename std::enable_if<U>::type* = 0) noexcept(
         std::is_nothrow_default_constructible<T>::value)
     {
+        if (ptr != nullptr and ptr == p_arena_block)
+        {
+            p_arena->deallocate(ptr, sizeof(T) * sz);
+            p_arena_block = nullptr;
+            return;
+        }
+#if __has_include(<sys/mman.h>)
         ::free(ptr);
+#else
+        A::deallocate(ptr, sz);
+#endif
     }
 
     template <bool U = is_trivial_and_nothrow_default_constructible>
@@ -106,7 +293,11 @@ public:
     {
         A::deallocate(ptr, sz);
     }
-#endif
+
+private:
+    std::shared_ptr<monotonic_arena> p_arena;
+    T* p_arena_block = nullptr;
+    bool p_arena_used = false;
 };
 
 template <typename T>
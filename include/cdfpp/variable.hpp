@@ -28,7 +28,9 @@
 #include "cdf-repr.hpp"
 #include "no_init_vector.hpp"
 
+#include <algorithm>
 #include <cstdint>
+#include <functional>
 #include <iomanip>
 #include <optional>
 #include <vector>
@@ -64,6 +66,65 @@ template <typename T>
     return 0UL;
 }
 
+/*
+ * Number of records stored in each VVR/CVVR when saving, given either in records or in bytes.
+ * A default constructed chunk size is unset and defers to the file default.
+ */
+struct chunk_size_t
+{
+    std::size_t records = 0UL;
+    std::size_t bytes = 0UL;
+
+    [[nodiscard]] static chunk_size_t in_records(std::size_t count) noexcept
+    {
+        return { count, 0UL };
+    }
+    [[nodiscard]] static chunk_size_t in_bytes(std::size_t size) noexcept { return { 0UL, size }; }
+
+    [[nodiscard]] bool is_set() const noexcept { return records != 0UL or bytes != 0UL; }
+
+    [[nodiscard]] std::size_t records_per_chunk(std::size_t record_size) const noexcept
+    {
+        if (records != 0UL)
+            return records;
+        return std::max(std::size_t { 1 }, bytes / std::max(std::size_t { 1 }, record_size));
+    }
+
+    inline bool operator==(const chunk_size_t& other) const
+    {
+        return other.records == records and other.bytes == bytes;
+    }
+    inline bool operator!=(const chunk_size_t& other) const { return !(*this == other); }
+};
+
+/*
+ * Records left out of the file on save, readers get them back as the pad value which is set to
+ * FILLVAL when the variable has a usable one.
+ */
+struct sparse_records_t
+{
+    // skips records whose values all equal the FILLVAL attribute
+    bool fill_values = false;
+    // skips flagged records whatever their values, indexed by record number
+    std::vector<bool> mask;
+    // shorter runs of skipped records are written anyway, each gap costs a VXR entry
+    std::size_t min_run = 16;
+    // skipped records read back as the previous written one instead of the pad value
+    bool previous = false;
+    // one value written as pad instead of FILLVAL, set when loading a sparse variable
+    std::optional<no_init_vector<char>> pad_value = std::nullopt;
+
+    [[nodiscard]] bool is_set() const noexcept { return fill_values or std::size(mask) != 0; }
+
+    inline bool operator==(const sparse_records_t& other) const
+    {
+        return other.fill_values == fill_values and other.mask == mask
+            and other.min_run == min_run and other.previous == previous
+            and other.pad_value == pad_value;
+    }
+    inline bool operator!=(const sparse_records_t& other) const { return !(*this == other); }
+};
+
 struct Variable
 {
     using var_data_t = data_t;
@@ -80,7 +141,7 @@ struct Variable
             : p_name { name }
             , p_number { number }
             , p_data { std::move(data) }
-            , p_shape { shape }
+            , p_shape { std::move(shape) }
             , p_majority { majority }
             , p_is_nrv { is_nrv }
             , p_compression { compression_type }
@@ -98,7 +159,7 @@ struct Variable
             : p_name { name }
             , p_number { number }
             , p_data { std::move(data) }
-            , p_shape { shape }
+            , p_shape { std::move(shape) }
             , p_majority { majority }
             , p_is_nrv { is_nrv }
             , p_compression { compression_type }
@@ -149,11 +210,13 @@ struct Variable
         return 0;
     }
 
+    // the sparse records mask indexes the previous values and is dropped with them
     void set_data(const data_t& data, const shape_t& shape)
     {
         p_data = data;
         p_shape = shape;
         check_shape();
+        drop_sparse_records_mask();
     }
 
     void set_data(data_t&& data, shape_t&& shape)
@@ -161,6 +224,7 @@ struct Variable
         p_data = std::move(data);
         p_shape = std::move(shape);
         check_shape();
+        drop_sparse_records_mask();
     }
 
     [[nodiscard]] std::size_t bytes() const noexcept
@@ -186,12 +250,49 @@ struct Variable
     [[nodiscard]] cdf_majority majority() const noexcept { return p_majority; }
     [[nodiscard]] cdf_compression_type compression_type() const noexcept { return p_compression; }
     void set_compression_type(cdf_compression_type ct) noexcept { p_compression = ct; }
+    // unset means the file compression level is used
+    [[nodiscard]] std::optional<int> compression_level() const noexcept
+    {
+        return p_compression_level;
+    }
+    void set_compression_level(std::optional<int> level) noexcept { p_compression_level = level; }
+    [[nodiscard]] chunk_size_t chunk_size() const noexcept { return p_chunk_size; }
+    void set_chunk_size(chunk_size_t chunk_size) noexcept { p_chunk_size = chunk_size; }
+    [[nodiscard]] const sparse_records_t& sparse_records() const
+    {
+        if (p_sparse_records_mask_loader)
+        {
+            p_sparse_records.mask = p_sparse_records_mask_loader();
+            p_sparse_records_mask_loader = nullptr;
+        }
+        return p_sparse_records;
+    }
+    void set_sparse_records(sparse_records_t sparse_records)
+    {
+        p_sparse_records = std::move(sparse_records);
+        p_sparse_records_mask_loader = nullptr;
+    }
+    // the mask of a loaded sparse variable is only read from the file when first needed
+    void set_lazy_sparse_records(
+        sparse_records_t sparse_records, std::function<std::vector<bool>(void)>&& mask_loader)
+    {
+        p_sparse_records = std::move(sparse_records);
+        p_sparse_records_mask_loader = std::move(mask_loader);
+    }
 
     [[nodiscard]] inline bool values_loaded() const noexcept
     {
         return not std::holds_alternative<lazy_data>(p_data);
     }
 
+    // source file values of a variable that was never loaded, see lazy_data::raw()
+    [[nodiscard]] inline std::optional<raw_data> raw_values() const
+    {
+        if (values_loaded())
+            return std::nullopt;
+        return std::get<lazy_data>(p_data).raw();
+    }
+
     inline void load_values() const
     {
         if (not values_loaded())
@@ -250,6 +351,12 @@ private:
         return std::get<var_data_t>(p_data);
     }
 
+    void drop_sparse_records_mask() noexcept
+    {
+        p_sparse_records.mask.clear();
+        p_sparse_records_mask_loader = nullptr;
+    }
+
     void check_shape() const
     {
 
@@ -267,6 +374,10 @@ private:
     cdf_majority p_majority;
     bool p_is_nrv;
     cdf_compression_type p_compression;
+    std::optional<int> p_compression_level = std::nullopt;
+    chunk_size_t p_chunk_size {};
+    mutable sparse_records_t p_sparse_records {};
+    mutable std::function<std::vector<bool>(void)> p_sparse_records_mask_loader {};
 };
 
 template <typename... Ts>
@@ -16,7 +16,7 @@ Indices and tables
 
 import numpy as np
 #from ._pycdfpp import *
-from ._pycdfpp import DataType, CompressionType, Majority, Variable, Attribute, CDF, tt2000_t, epoch, epoch16, save
+from ._pycdfpp import DataType, CompressionType, ChunkSize, CompressionObjective, Majority, Variable, Attribute, CDF, tt2000_t, epoch, epoch16, save, resolve_compression
 from datetime import datetime
 from . import _pycdfpp
 from typing import ByteString, Mapping, List, Any
@@ -30,7 +30,7 @@ if sys.platform == 'win32' and sys.version_info[0] == 3 and sys.version_info[1]
     os.add_dll_directory(__here__)
 
 __all__ = ['tt2000_t', 'epoch', 'epoch16', 'load', 'save', 'CDF', 'Variable',
-           'Attribute', 'to_datetime64', 'to_datetime', 'DataType', 'CompressionType', 'Majority']
+           'Attribute', 'to_datetime64', 'to_datetime', 'DataType', 'CompressionType', 'ChunkSize', 'CompressionObjective', 'Majority', 'resolve_compression']
 
 
 _NUMPY_TO_CDF_TYPE_ = (
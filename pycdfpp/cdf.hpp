@@ -40,6 +40,20 @@ using namespace cdf;
 namespace py = pybind11;
 namespace docstrings
 {
+constexpr auto _CompressionObjective = R"delimiter(
+Speed/size trade-off used to resolve automatic compression.
+
+Attributes
+----------
+min_saving: float
+    minimum fraction of the size a codec must save to be used (default 0.1)
+min_throughput: float
+    minimum compression speed in bytes per second (default 0, no constraint)
+saving_tolerance: float
+    the fastest codec whose saving is within this tolerance of the best one is picked (default 0.05)
+
+)delimiter";
+
 constexpr auto _CDF = R"delimiter(
 A CDF file object.
 
@@ -56,7 +70,15 @@ distribution_version: int
 lazy_loaded: bool
     file lazy loading state
 compression: CompressionType
-    file compression type
+    file compression type, auto_compression picks one codec for the whole file on save
+compression_level: int
+    gzip compression level used for the file and for variables which don't set their own
+compression_objective: CompressionObjective
+    speed/size trade-off used to resolve variables with auto_compression
+chunk_size: ChunkSize
+    default chunk size of variables which don't set their own
+layout: Layout
+    record ordering used on save, metadata_first puts all the metadata ahead of the values
 
 Methods
 -------
@@ -72,6 +94,12 @@ add_variable
 template <typename T>
 void def_cdf_wrapper(T& mod)
 {
+    py::class_<compression_objective>(mod, "CompressionObjective", docstrings::_CompressionObjective)
+        .def(py::init<>())
+        .def_readwrite("min_saving", &compression_objective::min_saving)
+        .def_readwrite("min_throughput", &compression_objective::min_throughput)
+        .def_readwrite("saving_tolerance", &compression_objective::saving_tolerance);
+
     py::class_<CDF>(mod, "CDF", docstrings::_CDF)
         .def(py::init<>())
         .def(py::self == py::self)
@@ -85,6 +113,19 @@ void def_cdf_wrapper(T& mod)
         .def_property(
             "compression", [](const CDF& cdf) { return cdf.compression; },
             [](CDF& cdf, cdf_compression_type ct) { cdf.compression = ct; })
+        .def_property(
+            "compression_level", [](const CDF& cdf) { return cdf.compression_level; },
+            [](CDF& cdf, int level) { cdf.compression_level = level; })
+        .def_property(
+            "compression_objective", [](const CDF& cdf) { return cdf.compression_objective; },
+            [](CDF& cdf, const compression_objective& objective)
+            { cdf.compression_objective = objective; })
+        .def_property(
+            "chunk_size", [](const CDF& cdf) { return cdf.chunk_size; },
+            [](CDF& cdf, chunk_size_t chunk_size) { cdf.chunk_size = chunk_size; })
+        .def_property(
+            "layout", [](const CDF& cdf) { return cdf.layout; },
+            [](CDF& cdf, cdf_layout layout) { cdf.layout = layout; })
         .def("__repr__", __repr__<CDF>)
         .def(
             "__getitem__", [](CDF& cd, const std::string& key) -> Variable& { return cd[key]; },
@@ -193,6 +234,23 @@ struct cdf_bytes
 template <typename T>
 void def_cdf_saving_functions(T& mod)
 {
+    py::class_<io::compression_decision>(mod, "CompressionDecision")
+        .def_readonly("variable", &io::compression_decision::variable)
+        .def_readonly("compression", &io::compression_decision::type)
+        .def_readonly("ratio", &io::compression_decision::ratio)
+        .def_readonly("throughput", &io::compression_decision::throughput)
+        .def("__repr__",
+            [](const io::compression_decision& decision)
+            {
+                return fmt::format("{}: {} (ratio: {:.2f}, throughput: {:.1f} MB/s)",
+                    decision.variable, cdf_compression_type_str(decision.type), decision.ratio,
+                    decision.throughput / 1e6);
+            });
+
+    mod.def(
+        "resolve_compression", [](CDF& cdf) { return io::resolve_compression(cdf); },
+        py::arg("cdf"),
+        "Resolves variables with auto_compression to a codec and returns the decisions.");
 
     mod.def(
         "save",
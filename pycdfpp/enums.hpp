@@ -36,12 +36,17 @@ void def_enums_wrappers(T& mod)
         .value("column", cdf_majority::column);
 
     py::enum_<cdf_compression_type>(mod, "CompressionType")
+        .value("auto_compression", cdf_compression_type::auto_compression)
         .value("no_compression", cdf_compression_type::no_compression)
         .value("gzip_compression", cdf_compression_type::gzip_compression)
         .value("rle_compression", cdf_compression_type::rle_compression)
         .value("ahuff_compression", cdf_compression_type::ahuff_compression)
         .value("huff_compression", cdf_compression_type::huff_compression);
 
+    py::enum_<cdf_layout>(mod, "Layout")
+        .value("interleaved", cdf_layout::interleaved)
+        .value("metadata_first", cdf_layout::metadata_first);
+
     py::enum_<CDF_Types>(mod, "DataType")
         .value("CDF_BYTE", CDF_Types::CDF_BYTE)
         .value("CDF_CHAR", CDF_Types::CDF_CHAR)
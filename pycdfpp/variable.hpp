@@ -44,6 +44,34 @@ using namespace cdf;
 
 namespace docstrings
 {
+constexpr auto _ChunkSize = R"(
+Number of records stored in each values record when saving, either given in records or in bytes.
+
+Attributes
+----------
+records: int
+    records per values record, takes precedence over bytes when non zero
+bytes: int
+    approximate size in bytes of each values record
+
+)";
+
+constexpr auto _SparseRecords = R"(
+Records left out of the file when saving, they read back as the pad value which is set to FILLVAL when the variable has one.
+
+Attributes
+----------
+fill_values: bool
+    skips records whose values all equal the FILLVAL attribute
+mask: List[bool]
+    skips flagged records whatever their values, indexed by record number
+min_run: int
+    shorter runs of skipped records are written anyway
+previous: bool
+    skipped records read back as the previous written record instead of the pad value
+
+)";
+
 constexpr auto _Variable = R"(
 A CDF Variable (either R or Z variable)
 
@@ -63,6 +91,12 @@ values_loaded: bool
     True if values are availbale in memory, this is usefull with lazy loading to know if values are already loaded.
 compression: CompressionType
     variable compression type (supported values are no_compression, rle_compression, gzip_compression)
+compression_level: Optional[int]
+    gzip compression level (1 fastest to 9 with zlib or 12 with libdeflate), when unset the file compression_level is used
+chunk_size: ChunkSize
+    number of records written per values record on save, when unset the file chunk_size is used
+sparse_records: SparseRecords
+    records left out of the file on save
 values: numpy.array
     returns variable values as a numpy.array of the corresponding dtype and shape, note that no copies are involved, the returned array is just a view on variable data.
 values_encoded: numpy.array
@@ -214,6 +248,37 @@ void set_values(Variable& var, const py::buffer& buffer, CDF_Types data_type)
 template <typename T>
 void def_variable_wrapper(T& mod)
 {
+    py::class_<chunk_size_t>(mod, "ChunkSize", docstrings::_ChunkSize)
+        .def(py::init<>())
+        .def(py::self == py::self)
+        .def(py::self != py::self)
+        .def_readwrite("records", &chunk_size_t::records)
+        .def_readwrite("bytes", &chunk_size_t::bytes)
+        .def_static("in_records", &chunk_size_t::in_records, py::arg("count"))
+        .def_static("in_bytes", &chunk_size_t::in_bytes, py::arg("size"))
+        .def("__repr__",
+            [](const chunk_size_t& chunk_size)
+            {
+                return fmt::format(
+                    "ChunkSize(records={}, bytes={})", chunk_size.records, chunk_size.bytes);
+            });
+
+    py::class_<sparse_records_t>(mod, "SparseRecords", docstrings::_SparseRecords)
+        .def(py::init<>())
+        .def(py::self == py::self)
+        .def(py::self != py::self)
+        .def_readwrite("fill_values", &sparse_records_t::fill_values)
+        .def_readwrite("mask", &sparse_records_t::mask)
+        .def_readwrite("min_run", &sparse_records_t::min_run)
+        .def_readwrite("previous", &sparse_records_t::previous)
+        .def("__repr__",
+            [](const sparse_records_t& sparse_records)
+            {
+                return fmt::format("SparseRecords(fill_values={}, mask={} records, min_run={})",
+                    sparse_records.fill_values, std::size(sparse_records.mask),
+                    sparse_records.min_run);
+            });
+
     py::class_<Variable>(mod, "Variable", py::buffer_protocol(), docstrings::_Variable)
         .def("__repr__", __repr__<Variable>)
         .def(py::self == py::self)
@@ -237,6 +302,11 @@ void def_variable_wrapper(T& mod)
         .def_property_readonly("is_nrv", &Variable::is_nrv)
         .def_property_readonly("values_loaded", &Variable::values_loaded)
         .def_property("compression", &Variable::compression_type, &Variable::set_compression_type)
+        .def_property("compression_level", &Variable::compression_level,
+            &Variable::set_compression_level)
+        .def_property("chunk_size", &Variable::chunk_size, &Variable::set_chunk_size)
+        .def_property(
+            "sparse_records", &Variable::sparse_records, &Variable::set_sparse_records)
         .def_buffer([](Variable& var) -> py::buffer_info { return make_buffer(var); })
         .def_property_readonly("values", make_values_view<false>, py::keep_alive<0, 1>())
         .def_property_readonly("values_encoded", make_values_view<true>, py::keep_alive<0, 1>())
@@ -0,0 +1,458 @@
+#include <algorithm>
+#include <cstdint>
+#include <cstdio>
+#include <filesystem>
+#include <random>
+#include <string>
+
+#if __has_include(<catch2/catch_all.hpp>)
+#include <catch2/catch_all.hpp>
+#include <catch2/catch_test_macros.hpp>
+#else
+#include <catch.hpp>
+#endif
+
+#include "cdfpp/cdf-file.hpp"
+#include "cdfpp/cdf-io/cdf-io.hpp"
+#include "cdfpp/variable.hpp"
+
+#include "tests_config.hpp"
+
+std::string temporary_path()
+{
+    static std::mt19937_64 generator { std::random_device {}() };
+    const auto name = "cdfpp-editing-" + std::to_string(generator()) + ".cdf";
+    return (std::filesystem::temp_directory_path() / name).string();
+}
+
+std::string copy_resource(const std::string& name)
+{
+    auto path = temporary_path();
+    std::filesystem::copy_file(std::string(DATA_PATH) + "/" + name, path);
+    return path;
+}
+
+no_init_vector<double> counter(std::size_t size, double start)
+{
+    no_init_vector<double> values(size);
+    std::generate(std::begin(values), std::end(values), [v = start]() mutable { return v++; });
+    return values;
+}
+
+SCENARIO("Updating values in place", "[CDF]")
+{
+    for (const auto* resource : { "a_cdf.cdf", "a_col_major_cdf.cdf" })
+    {
+        GIVEN(std::string { "a copy of " } + resource)
+        {
+            const auto path = copy_resource(resource);
+            const auto reference = cdf::io::load(path, false, false);
+            REQUIRE(reference);
+            const auto file_size = std::filesystem::file_size(path);
+            WHEN("updating a range of records of a multidimensional variable")
+            {
+                // var3d has 4 records of 3x2 values
+                REQUIRE(cdf::io::update_values(path, "var3d",
+                    data_t { counter(12, 1000.), CDF_Types::CDF_DOUBLE }, 1));
+                THEN("only those records change")
+                {
+                    REQUIRE(std::filesystem::file_size(path) == file_size);
+                    auto updated = cdf::io::load(path);
+                    REQUIRE(updated);
+                    const auto& values = updated->variables["var3d"].get<double>();
+                    const auto& before = reference->variables["var3d"].get<double>();
+                    REQUIRE(std::equal(std::cbegin(values), std::cbegin(values) + 6,
+                        std::cbegin(before)));
+                    REQUIRE(std::equal(std::cbegin(values) + 6, std::cbegin(values) + 18,
+                        std::cbegin(counter(12, 1000.))));
+                    REQUIRE(std::equal(std::cbegin(values) + 18, std::cend(values),
+                        std::cbegin(before) + 18));
+                    REQUIRE(updated->variables["var"] == reference->variables["var"]);
+                }
+            }
+            WHEN("updating a whole variable")
+            {
+                REQUIRE(cdf::io::update_values(
+                    path, "var", data_t { counter(101, -50.), CDF_Types::CDF_DOUBLE }));
+                THEN("the new values are loaded back")
+                {
+                    auto updated = cdf::io::load(path);
+                    REQUIRE(updated);
+                    REQUIRE(updated->variables["var"].get<double>() == counter(101, -50.));
+                    REQUIRE(updated->variables["var3d"] == reference->variables["var3d"]);
+                }
+            }
+            WHEN("sending invalid updates")
+            {
+                THEN("they are rejected without touching the file")
+                {
+                    REQUIRE_THROWS_AS(cdf::io::update_values(path, "missing",
+                                          data_t { counter(1, 0.), CDF_Types::CDF_DOUBLE }),
+                        std::invalid_argument);
+                    REQUIRE_THROWS_AS(cdf::io::update_values(path, "var",
+                                          data_t { no_init_vector<float>(101), CDF_Types::CDF_FLOAT }),
+                        std::invalid_argument);
+                    REQUIRE_THROWS_AS(cdf::io::update_values(path, "var3d",
+                                          data_t { counter(5, 0.), CDF_Types::CDF_DOUBLE }),
+                        std::invalid_argument);
+                    REQUIRE_THROWS_AS(cdf::io::update_values(path, "var",
+                                          data_t { counter(2, 0.), CDF_Types::CDF_DOUBLE }, 100),
+                        std::out_of_range);
+                    auto unchanged = cdf::io::load(path);
+                    REQUIRE(unchanged);
+                    REQUIRE(*unchanged == *reference);
+                }
+            }
+            std::remove(path.c_str());
+        }
+    }
+    GIVEN("a compressed file")
+    {
+        const auto path = copy_resource("a_compressed_cdf.cdf");
+        THEN("it can't be updated in place")
+        {
+            REQUIRE_FALSE(cdf::io::update_values(
+                path, "var", data_t { counter(101, 0.), CDF_Types::CDF_DOUBLE }));
+        }
+        std::remove(path.c_str());
+    }
+}
+
+SCENARIO("Appending records to an existing file", "[CDF]")
+{
+    for (const auto* resource : { "a_cdf.cdf", "a_col_major_cdf.cdf" })
+    {
+        GIVEN(std::string { "a copy of " } + resource)
+        {
+            const auto path = copy_resource(resource);
+            const auto reference = cdf::io::load(path, false, false);
+            REQUIRE(reference);
+            WHEN("appending many small batches to a multidimensional variable")
+            {
+                // fills the records preallocated by the CDF library then chains new VXRs
+                for (auto batch = 0UL; batch < 40UL; batch++)
+                {
+                    REQUIRE(cdf::io::append_records(path, "var3d",
+                        data_t { counter(48, 1000. + static_cast<double>(batch * 48)),
+                            CDF_Types::CDF_DOUBLE }));
+                }
+                THEN("the new records follow the existing ones")
+                {
+                    auto updated = cdf::io::load(path);
+                    REQUIRE(updated);
+                    const auto& var3d = updated->variables["var3d"];
+                    REQUIRE(var3d.shape() == decltype(var3d.shape()) { 324, 3, 2 });
+                    const auto& values = var3d.get<double>();
+                    const auto& before = reference->variables["var3d"].get<double>();
+                    REQUIRE(
+                        std::equal(std::cbegin(before), std::cend(before), std::cbegin(values)));
+                    REQUIRE(std::equal(std::cbegin(values) + 24, std::cend(values),
+                        std::cbegin(counter(1920, 1000.))));
+                    REQUIRE(updated->variables["var"] == reference->variables["var"]);
+                }
+            }
+            WHEN("appending to a variable without records")
+            {
+                REQUIRE(cdf::io::append_records(path, "empty_var_recvary_string",
+                    data_t { no_init_vector<char>(32, 'a'), CDF_Types::CDF_CHAR }));
+                THEN("its first records are written")
+                {
+                    auto updated = cdf::io::load(path);
+                    REQUIRE(updated);
+                    const auto& variable = updated->variables["empty_var_recvary_string"];
+                    REQUIRE(variable.shape() == decltype(variable.shape()) { 2, 16 });
+                    REQUIRE(variable.get<char>() == no_init_vector<char>(32, 'a'));
+                }
+            }
+            WHEN("sending invalid appends")
+            {
+                THEN("they are rejected without touching the file")
+                {
+                    REQUIRE_THROWS_AS(cdf::io::append_records(path, "missing",
+                                          data_t { counter(1, 0.), CDF_Types::CDF_DOUBLE }),
+                        std::invalid_argument);
+                    REQUIRE_THROWS_AS(cdf::io::append_records(path, "var3d",
+                                          data_t { counter(5, 0.), CDF_Types::CDF_DOUBLE }),
+                        std::invalid_argument);
+                    REQUIRE_THROWS_AS(cdf::io::append_records(path, "var_string",
+                                          data_t { no_init_vector<char>(16), CDF_Types::CDF_CHAR }),
+                        std::invalid_argument);
+                    auto unchanged = cdf::io::load(path);
+                    REQUIRE(unchanged);
+                    REQUIRE(*unchanged == *reference);
+                }
+            }
+            std::remove(path.c_str());
+        }
+    }
+    GIVEN("a copy of a file with compressed variables")
+    {
+        const auto path = copy_resource("a_cdf_with_compressed_vars.cdf");
+        const auto reference = cdf::io::load(path, false, false);
+        REQUIRE(reference);
+        WHEN("appending records to a compressed variable")
+        {
+            REQUIRE(cdf::io::append_records(
+                path, "var", data_t { counter(50, 500.), CDF_Types::CDF_DOUBLE }));
+            THEN("they are compressed the same way")
+            {
+                auto updated = cdf::io::load(path);
+                REQUIRE(updated);
+                const auto& values = updated->variables["var"].get<double>();
+                const auto& before = reference->variables["var"].get<double>();
+                REQUIRE(std::size(values) == std::size(before) + 50);
+                REQUIRE(std::equal(std::cbegin(before), std::cend(before), std::cbegin(values)));
+                REQUIRE(std::equal(std::cbegin(values) + std::size(before), std::cend(values),
+                    std::cbegin(counter(50, 500.))));
+            }
+        }
+        std::remove(path.c_str());
+    }
+}
+
+data_t chars(const std::string& text)
+{
+    return data_t { no_init_vector<char>(std::cbegin(text), std::cend(text)), CDF_Types::CDF_CHAR };
+}
+
+SCENARIO("Editing metadata in place", "[CDF]")
+{
+    for (const auto* resource : { "a_cdf.cdf", "a_col_major_cdf.cdf" })
+    {
+        GIVEN(std::string { "a copy of " } + resource)
+        {
+            const auto path = copy_resource(resource);
+            const auto reference = cdf::io::load(path, false, false);
+            REQUIRE(reference);
+            const auto file_size = std::filesystem::file_size(path);
+            const data_t new_float { no_init_vector<float> { 42.f }, CDF_Types::CDF_FLOAT };
+            const data_t new_double { no_init_vector<double> { 1., 2. }, CDF_Types::CDF_DOUBLE };
+            WHEN("renaming a variable and an attribute and updating a same size value")
+            {
+                {
+                    cdf::io::metadata_editor editor { path };
+                    editor.rename_variable("var", "renamed");
+                    editor.rename_attribute("attr_int", "attr_int_renamed");
+                    editor.set_attribute("attr_float", 1, new_float);
+                    REQUIRE(editor.good());
+                    REQUIRE(editor.close());
+                    REQUIRE_FALSE(editor.is_open());
+                }
+                THEN("nothing is appended to the file")
+                {
+                    REQUIRE(std::filesystem::file_size(path) == file_size);
+                    auto edited = cdf::io::load(path);
+                    REQUIRE(edited);
+                    REQUIRE(edited->variables.count("var") == 0);
+                    REQUIRE(edited->variables["renamed"].get<double>()
+                        == reference->variables["var"].get<double>());
+                    REQUIRE(edited->variables["renamed"].attributes["var_attr"][0]
+                        == reference->variables["var"].attributes["var_attr"][0]);
+                    REQUIRE(edited->attributes.count("attr_int") == 0);
+                    REQUIRE(edited->attributes["attr_int_renamed"][0]
+                        == reference->attributes["attr_int"][0]);
+                    REQUIRE(edited->attributes["attr_float"][0]
+                        == reference->attributes["attr_float"][0]);
+                    REQUIRE(edited->attributes["attr_float"][1] == new_float);
+                }
+            }
+            WHEN("deleting a variable")
+            {
+                {
+                    cdf::io::metadata_editor editor { path };
+                    editor.delete_variable("epoch");
+                }
+                THEN("the other variables keep their values and attributes")
+                {
+                    auto edited = cdf::io::load(path);
+                    REQUIRE(edited);
+                    REQUIRE(edited->variables.count("epoch") == 0);
+                    REQUIRE(std::size(edited->variables) == std::size(reference->variables) - 1);
+                    for (const auto& [name, variable] : edited->variables)
+                    {
+                        REQUIRE(variable == reference->variables[name]);
+                    }
+                }
+            }
+            WHEN("growing values and adding attributes")
+            {
+                {
+                    cdf::io::metadata_editor editor { path };
+                    editor.set_attribute("attr", 0, chars("a much longer value than before"));
+                    editor.set_attribute("new_global", 0, new_double);
+                    editor.set_variable_attribute("var3d", "attr1", chars("added"));
+                    editor.set_variable_attribute("var", "new_var_attr", new_float);
+                }
+                THEN("new records are appended and linked")
+                {
+                    REQUIRE(std::filesystem::file_size(path) > file_size);
+                    auto edited = cdf::io::load(path);
+                    REQUIRE(edited);
+                    REQUIRE(edited->attributes["attr"][0]
+                        == chars("a much longer value than before"));
+                    REQUIRE(edited->attributes["new_global"][0] == new_double);
+                    REQUIRE(edited->variables["var3d"].attributes["attr1"][0] == chars("added"));
+                    REQUIRE(edited->variables["var3d"].attributes["var3d_attr_multi"][0]
+                        == reference->variables["var3d"].attributes["var3d_attr_multi"][0]);
+                    REQUIRE(edited->variables["var"].attributes["new_var_attr"][0] == new_float);
+                    REQUIRE(edited->variables["var2d"].attributes["attr1"][0]
+                        == reference->variables["var2d"].attributes["attr1"][0]);
+                    REQUIRE(edited->variables["var"] == reference->variables["var"]);
+                }
+            }
+            WHEN("sending invalid edits")
+            {
+                cdf::io::metadata_editor editor { path };
+                THEN("they are rejected")
+                {
+                    REQUIRE_THROWS_AS(
+                        editor.rename_variable("missing", "other"), std::invalid_argument);
+                    REQUIRE_THROWS_AS(
+                        editor.rename_variable("var", "var3d"), std::invalid_argument);
+                    REQUIRE_THROWS_AS(editor.rename_variable("var", std::string(300, 'x')),
+                        std::invalid_argument);
+                    REQUIRE_THROWS_AS(
+                        editor.set_variable_attribute("var", "attr", new_float),
+                        std::invalid_argument);
+                }
+            }
+            std::remove(path.c_str());
+        }
+    }
+    GIVEN("a compressed file")
+    {
+        const auto path = copy_resource("a_compressed_cdf.cdf");
+        THEN("its metadata can't be edited in place")
+        {
+            REQUIRE_THROWS_AS(cdf::io::metadata_editor { path }, std::runtime_error);
+        }
+        std::remove(path.c_str());
+    }
+}
+
+SCENARIO("Optimizing the layout of a fragmented file", "[CDF]")
+{
+    GIVEN("a file where appends interleaved the values records of two variables")
+    {
+        const auto path = temporary_path();
+        {
+            CDF cdf_obj;
+            for (const auto* name : { "a", "b" })
+                cdf_obj.variables.emplace(name,
+                    Variable { name, 0, data_t { counter(5, 0.), CDF_Types::CDF_DOUBLE }, { 5 } });
+            REQUIRE(cdf::io::save(cdf_obj, path));
+        }
+        for (auto batch = 1UL; batch < 20UL; batch++)
+        {
+            for (const auto* name : { "a", "b" })
+                REQUIRE(cdf::io::append_records(path, name,
+                    data_t { counter(5, static_cast<double>(batch * 5)), CDF_Types::CDF_DOUBLE }));
+        }
+        const auto reference = cdf::io::load(path);
+        REQUIRE(reference);
+        REQUIRE(reference->variables["a"].raw_values()->blocks.size() == 20);
+        const auto output = temporary_path();
+        WHEN("optimizing it as is")
+        {
+            REQUIRE(cdf::io::optimize(path, output));
+            THEN("values records are copied next to each other")
+            {
+                auto optimized = cdf::io::load(output);
+                REQUIRE(optimized);
+                for (const auto* name : { "a", "b" })
+                {
+                    const auto raw = optimized->variables[name].raw_values();
+                    REQUIRE(raw);
+                    REQUIRE(std::size(raw->blocks) == 20);
+                    // VVR header: RecordSize (8 bytes) and RecordType (4 bytes)
+                    for (auto i = 1UL; i < std::size(raw->blocks); i++)
+                        REQUIRE(raw->blocks[i].data
+                            == raw->blocks[i - 1].data + raw->blocks[i - 1].size + 12);
+                }
+                REQUIRE(*optimized == *reference);
+            }
+        }
+        WHEN("coalescing its values records")
+        {
+            cdf::io::optimize_options options;
+            options.coalesce = cdf::chunk_size_t::in_records(1000);
+            REQUIRE(cdf::io::optimize(path, output, options));
+            THEN("each variable is stored in a single values record")
+            {
+                auto optimized = cdf::io::load(output);
+                REQUIRE(optimized);
+                REQUIRE(std::size(optimized->variables["a"].raw_values()->blocks) == 1);
+                REQUIRE(std::size(optimized->variables["b"].raw_values()->blocks) == 1);
+                REQUIRE(optimized->variables["a"].get<double>() == counter(100, 0.));
+                REQUIRE(*optimized == *reference);
+            }
+        }
+        WHEN("writing over its input")
+        {
+            THEN("it is refused") { REQUIRE_FALSE(cdf::io::optimize(path, path)); }
+        }
+        WHEN("writing over its input through another path")
+        {
+            const auto input = std::filesystem::path { path };
+            const auto aliased = (input.parent_path() / "." / input.filename()).string();
+            const auto link = temporary_path();
+            std::filesystem::create_symlink(input, link);
+            THEN("it is refused and the input is left untouched")
+            {
+                REQUIRE_FALSE(cdf::io::optimize(path, aliased));
+                REQUIRE_FALSE(cdf::io::optimize(path, link));
+                REQUIRE_FALSE(cdf::io::optimize(link, path));
+                const auto input_again = cdf::io::load(path);
+                REQUIRE(input_again);
+                REQUIRE(*input_again == *reference);
+            }
+            std::remove(link.c_str());
+        }
+        std::remove(output.c_str());
+        std::remove(path.c_str());
+    }
+}
+
+SCENARIO("Optimizing a file with sparse records", "[CDF]")
+{
+    GIVEN("a file where a variable leaves out its last 50 records")
+    {
+        const auto path = temporary_path();
+        {
+            CDF cdf_obj;
+            cdf_obj.variables.emplace("sparse",
+                Variable { "sparse", 0, data_t { counter(100, 0.), CDF_Types::CDF_DOUBLE },
+                    { 100 } });
+            cdf::sparse_records_t sparse_records;
+            sparse_records.previous = true;
+            sparse_records.mask.resize(100);
+            std::fill(std::begin(sparse_records.mask) + 50, std::end(sparse_records.mask), true);
+            cdf_obj.variables["sparse"].set_sparse_records(sparse_records);
+            REQUIRE(cdf::io::save(cdf_obj, path));
+        }
+        const auto reference = cdf::io::load(path);
+        REQUIRE(reference);
+        const auto output = temporary_path();
+        WHEN("coalescing its values records")
+        {
+            cdf::io::optimize_options options;
+            options.coalesce = cdf::chunk_size_t::in_records(1000);
+            REQUIRE(cdf::io::optimize(path, output, options));
+            THEN("the missing records are still left out")
+            {
+                auto optimized = cdf::io::load(output);
+                REQUIRE(optimized);
+                const auto& sparse_records = optimized->variables["sparse"].sparse_records();
+                REQUIRE(sparse_records.previous);
+                REQUIRE(std::size(sparse_records.mask) == 100);
+                REQUIRE(std::count(
+                            std::cbegin(sparse_records.mask), std::cend(sparse_records.mask), true)
+                    == 50);
+                REQUIRE(std::filesystem::file_size(output) <= std::filesystem::file_size(path));
+                REQUIRE(*optimized == *reference);
+            }
+        }
+        std::remove(output.c_str());
+        std::remove(path.c_str());
+    }
+}
@@ -4,8 +4,11 @@
 #else
 #include <catch.hpp>
 #endif
+#include "cdfpp/cdf-data.hpp"
 #include "cdfpp/cdf-io/endianness.hpp"
+#include <algorithm>
 #include <cstdint>
+#include <vector>
 
 
 TEST_CASE("", "")
@@ -16,3 +19,85 @@ TEST_CASE("", "")
     REQUIRE(0x01020304 == decode<big_endian_t, uint32_t>("\1\2\3\4"));
     REQUIRE(0x0102030405060701 == decode<big_endian_t, uint64_t>("\1\2\3\4\5\6\7\1"));
 }
+
+template <typename T>
+void check_vector_decode(cdf::endianness::simd::instruction_set instruction_set)
+{
+    using namespace cdf::endianness;
+    // odd sizes and offsets exercise the scalar tail and unaligned accesses
+    for (std::size_t count : { 0UL, 1UL, 7UL, 16UL, 33UL, 250UL, 1031UL })
+    {
+        std::vector<T> storage(count + 1);
+        std::vector<T> expected(count);
+        for (auto i = 0UL; i < count; i++)
+        {
+            const auto value = static_cast<T>(0x0102030405060708ULL * (i + 1));
+            storage[i + 1] = value;
+            expected[i] = decode<big_endian_t, T>(reinterpret_cast<const char*>(&value));
+        }
+        auto kernel_output = storage;
+        auto* data = reinterpret_cast<char*>(kernel_output.data()) + sizeof(T);
+        const auto swapped = simd::byte_swap<sizeof(T)>(data, count, instruction_set);
+        REQUIRE(swapped <= count);
+        for (auto i = 0UL; i < swapped; i++)
+            REQUIRE(kernel_output[i + 1] == expected[i]);
+        decode_v<big_endian_t>(storage.data() + 1, count);
+        REQUIRE(std::equal(std::cbegin(expected), std::cend(expected), std::cbegin(storage) + 1));
+    }
+}
+
+TEST_CASE("Vectorized byte swap matches the scalar one", "")
+{
+    using cdf::endianness::simd::instruction_set;
+    for (auto instruction_set : { instruction_set::scalar, instruction_set::ssse3,
+             instruction_set::avx2, instruction_set::avx512 })
+    {
+        check_vector_decode<uint16_t>(instruction_set);
+        check_vector_decode<uint32_t>(instruction_set);
+        check_vector_decode<uint64_t>(instruction_set);
+    }
+}
+
+TEST_CASE("Buffers above the parallel threshold are decoded by chunks", "")
+{
+    using namespace cdf::endianness;
+    // not a multiple of the chunk size so the last chunk is a partial one
+    const auto count = cdf::io::parallel::min_parallel_bytes / sizeof(uint32_t) + 12345;
+    std::vector<uint32_t> values(count);
+    for (auto i = 0UL; i < count; i++)
+        values[i] = bswap32(static_cast<uint32_t>(i));
+    decode_v<big_endian_t>(values.data(), count);
+    auto mismatches = 0UL;
+    for (auto i = 0UL; i < count; i++)
+        mismatches += values[i] != static_cast<uint32_t>(i);
+    REQUIRE(mismatches == 0UL);
+}
+
+TEST_CASE("Huge latin1 buffers are converted to utf8 by chunks", "")
+{
+    const auto size = cdf::io::parallel::min_parallel_bytes + 777;
+    std::vector<char> latin1(size);
+    std::size_t expected_size = 0;
+    for (auto i = 0UL; i < size; i++)
+    {
+        // sparse accents so chunk outputs have different sizes
+        latin1[i] = static_cast<char>((i % 7 == 0) ? 0xe0 + i % 16 : 'a' + i % 26);
+        expected_size += (i % 7 == 0) ? 2 : 1;
+    }
+    const auto utf8 = cdf::iso_8859_1_to_utf8<char>(latin1.data(), size);
+    REQUIRE(std::size(utf8) == expected_size);
+    for (auto i = 0UL; i < size; i += 1001)
+    {
+        // every accent before i took one extra byte
+        const auto position = i + (i + 6) / 7;
+        if (i % 7 == 0)
+        {
+            REQUIRE(static_cast<uint8_t>(utf8[position]) == 0xc3);
+            REQUIRE(static_cast<uint8_t>(utf8[position + 1]) == 0xa0 + i % 16);
+        }
+        else
+        {
+            REQUIRE(utf8[position] == static_cast<char>('a' + i % 26));
+        }
+    }
+}
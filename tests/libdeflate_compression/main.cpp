@@ -8,7 +8,9 @@
 #ifdef CDFpp_USE_LIBDEFLATE
 #include "cdfpp/cdf-io/libdeflate.hpp"
 #endif
+#include <algorithm>
 #include <cstdint>
+#include <limits>
 
 #ifdef CDFpp_USE_LIBDEFLATE
 no_init_vector<char> build_ref()
@@ -27,6 +29,49 @@ TEST_CASE("IDEMPOTENCY check", "")
     cdf::io::libdeflate::gzinflate(w2, w.data(), std::size(ref));
     REQUIRE(ref == w);
 }
+
+TEST_CASE("Codec contexts are reused across blocks", "")
+{
+    uint32_t state = 42;
+    for (auto block_size : { 4096UL, 10000UL, 65536UL, 128UL, 65536UL })
+    {
+        no_init_vector<char> ref(block_size);
+        // incompressible payload, the compressed block is larger than the input
+        std::generate(std::begin(ref), std::end(ref),
+            [&state]()
+            {
+                state = state * 1664525u + 1013904223u;
+                return static_cast<char>(state >> 24);
+            });
+        no_init_vector<char> w(block_size);
+        auto compressed = cdf::io::libdeflate::gzdeflate(ref);
+        REQUIRE(std::size(compressed) > 0);
+        REQUIRE(cdf::io::libdeflate::gzinflate(compressed, w.data(), block_size) == block_size);
+        REQUIRE(ref == w);
+    }
+}
+
+TEST_CASE("Compression levels", "")
+{
+    no_init_vector<char> ref(1 << 16);
+    for (auto i = 0UL; i < std::size(ref); i++)
+        ref[i] = static_cast<char>((i * i / 7) % 23);
+    std::size_t previous_size = std::numeric_limits<std::size_t>::max();
+    // switching level back and forth on the same thread must not leak into later blocks
+    for (int level : { 1, 12, 1, 6, 12, 20 })
+    {
+        no_init_vector<char> w(std::size(ref));
+        auto compressed = cdf::io::libdeflate::gzdeflate(ref, level);
+        REQUIRE(cdf::io::libdeflate::gzinflate(compressed, w.data(), std::size(ref)) == std::size(ref));
+        REQUIRE(ref == w);
+        REQUIRE(compressed == cdf::io::libdeflate::gzdeflate(ref, level));
+        if (level == 12 or level == 20)
+        {
+            REQUIRE(std::size(compressed) <= previous_size);
+        }
+        previous_size = std::size(compressed);
+    }
+}
 #else
 TEST_CASE("Skip check", "")
 {}
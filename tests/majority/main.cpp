@@ -6,6 +6,7 @@
 #endif
 #include "cdfpp/cdf-io/majority-swap.hpp"
 #include "vector"
+#include <numeric>
 
 
 SCENARIO("Swapping from col to row major", "[CDF]")
@@ -37,3 +38,73 @@ SCENARIO("Swapping from col to row major", "[CDF]")
         }
     }
 }
+
+SCENARIO("Swapping a huge variable from col to row major", "[CDF]")
+{
+    GIVEN("a column major variable bigger than the parallel threshold")
+    {
+        const std::size_t records
+            = cdf::io::parallel::min_parallel_bytes / (sizeof(double) * 4 * 8) + 3;
+        std::vector<double> input(records * 4 * 8);
+        for (auto record = 0UL; record < records; record++)
+            for (auto i = 0UL; i < 4; i++)
+                for (auto j = 0UL; j < 8; j++)
+                    input[record * 32 + i * 8 + j] = static_cast<double>(record * 32 + j * 4 + i);
+        WHEN("Swapping to row major")
+        {
+            cdf::majority::swap(input, std::array<std::size_t, 3> { records, 4, 8 });
+            THEN("every record should be row major")
+            {
+                auto mismatches = 0UL;
+                for (auto index = 0UL; index < std::size(input); index++)
+                    mismatches += input[index] != static_cast<double>(index);
+                REQUIRE(mismatches == 0UL);
+            }
+        }
+    }
+}
+
+// the flat access pattern swap every kernel is checked against
+template <typename T>
+std::vector<T> reference_swap(const std::vector<T>& input, const std::vector<std::size_t>& shape)
+{
+    const std::vector<std::size_t> record_shape(std::cbegin(shape) + 1, std::cend(shape));
+    const auto pattern = cdf::_private::generate_access_pattern(record_shape);
+    std::vector<T> output(std::size(input));
+    for (auto record = 0UL; record < shape[0]; record++)
+        for (const auto& swap_pair : pattern)
+            output[record * std::size(pattern) + swap_pair.src]
+                = input[record * std::size(pattern) + swap_pair.dest];
+    return output;
+}
+
+template <typename T>
+void check_swap_against_reference(const std::vector<std::size_t>& shape)
+{
+    const auto size = std::accumulate(
+        std::cbegin(shape), std::cend(shape), std::size_t { 1 }, std::multiplies<std::size_t>());
+    std::vector<T> input(size);
+    for (auto i = 0UL; i < size; i++)
+        input[i] = static_cast<T>(i % 251);
+    const auto expected = reference_swap(input, shape);
+    cdf::majority::swap(input, shape);
+    REQUIRE(input == expected);
+}
+
+TEST_CASE("Tiled majority swap matches the flat access pattern one", "[CDF]")
+{
+    // small records use the cached pattern, bigger ones are tiled, with edges smaller than both
+    // the tiles and the SIMD blocks, from 2D to 5D records
+    const std::vector<std::vector<std::size_t>> shapes { { 3, 5, 7 }, { 2, 1, 9 }, { 2, 9, 1 },
+        { 3, 1, 100 }, { 3, 100, 1 }, { 4, 32, 33 }, { 2, 70, 45 }, { 3, 4, 5, 6 },
+        { 2, 32, 32, 16 }, { 2, 3, 4, 5, 6 }, { 1, 2, 1, 3, 1, 4 }, { 2, 3, 4, 5, 6, 7 } };
+    for (const auto& shape : shapes)
+    {
+        check_swap_against_reference<uint8_t>(shape);
+        check_swap_against_reference<uint16_t>(shape);
+        check_swap_against_reference<float>(shape);
+        check_swap_against_reference<int32_t>(shape);
+        check_swap_against_reference<double>(shape);
+        check_swap_against_reference<int64_t>(shape);
+    }
+}
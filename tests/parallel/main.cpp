@@ -0,0 +1,105 @@
+#if __has_include(<catch2/catch_all.hpp>)
+#include <catch2/catch_all.hpp>
+#include <catch2/catch_test_macros.hpp>
+#else
+#include <catch.hpp>
+#endif
+#include "cdfpp/cdf-io/parallel.hpp"
+#include <atomic>
+#include <cstddef>
+#include <mutex>
+#include <set>
+#include <stdexcept>
+#include <thread>
+#if __has_include(<sys/wait.h>)
+#include <sys/wait.h>
+#include <unistd.h>
+#endif
+
+
+TEST_CASE("Parallel loops reuse the same threads and run nested loops inline", "")
+{
+    using namespace cdf::io::parallel;
+    std::mutex mutex;
+    std::set<std::thread::id> threads;
+    std::atomic<std::size_t> inner_tasks { 0UL };
+    std::atomic<std::size_t> moved_inner_tasks { 0UL };
+    for (auto call = 0; call < 10; call++)
+    {
+        parallel_for(64,
+            [&](std::size_t)
+            {
+                const auto outer_thread = std::this_thread::get_id();
+                parallel_for(8,
+                    [&](std::size_t)
+                    {
+                        moved_inner_tasks += std::this_thread::get_id() != outer_thread;
+                        inner_tasks++;
+                    });
+                std::lock_guard<std::mutex> lock { mutex };
+                threads.insert(outer_thread);
+            });
+    }
+    REQUIRE(inner_tasks == 10UL * 64UL * 8UL);
+    REQUIRE(moved_inner_tasks == 0UL);
+    // the pool threads and the calling one, never new threads per call
+    REQUIRE(std::size(threads) <= _internal::worker_pool::instance().size() + 1);
+    REQUIRE_THROWS_AS(parallel_for(100,
+                          [](std::size_t i)
+                          {
+                              if (i == 42)
+                                  throw std::runtime_error { "task failed" };
+                          }),
+        std::runtime_error);
+}
+
+#if __has_include(<sys/wait.h>)
+TEST_CASE("Parallel loops still run in a forked child", "")
+{
+    using namespace cdf::io::parallel;
+    std::atomic<std::size_t> tasks { 0UL };
+    parallel_for(64, [&](std::size_t) { tasks++; });
+    REQUIRE(tasks == 64UL);
+    const auto pid = ::fork();
+    REQUIRE(pid != -1);
+    if (pid == 0)
+    {
+        // a hanging child is killed instead of blocking the test
+        ::alarm(30);
+        parallel_for(64, [&](std::size_t) { tasks++; });
+        ::_exit(tasks == 128UL ? 0 : 1);
+    }
+    int status = 0;
+    REQUIRE(::waitpid(pid, &status, 0) == pid);
+    REQUIRE(WIFEXITED(status));
+    REQUIRE(WEXITSTATUS(status) == 0);
+}
+#endif
+
+TEST_CASE("Parallel loops don't wait for a pool busy with another loop", "")
+{
+    using namespace cdf::io::parallel;
+    const auto pool_size = _internal::worker_pool::instance().size();
+    std::atomic<std::size_t> blocked_tasks { 0UL };
+    std::atomic<bool> release { false };
+    // every pool thread and the calling one end up in a task that waits for release
+    std::thread busy_caller {
+        [&]()
+        {
+            parallel_for(pool_size + 1,
+                [&](std::size_t)
+                {
+                    blocked_tasks++;
+                    while (not release)
+                        std::this_thread::yield();
+                });
+        }
+    };
+    while (blocked_tasks != pool_size + 1)
+        std::this_thread::yield();
+    std::atomic<std::size_t> tasks { 0UL };
+    parallel_for(100, [&](std::size_t) { tasks++; });
+    REQUIRE(tasks == 100UL);
+    release = true;
+    busy_caller.join();
+}
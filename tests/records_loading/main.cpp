@@ -144,4 +144,28 @@ SCENARIO("record loading", "[CDF]")
             static_assert(count_members<decltype(s)> == 5);
         }
     }
+    GIVEN("a record with a table view field")
+    {
+        struct record_table_view_field
+        {
+            char a;
+            table_view_field<char, 0> b;
+            char c;
+
+            std::size_t size(const table_view_field<char, 0>&) const
+            {
+                return static_cast<std::size_t>(this->a);
+            }
+        };
+        THEN("its payload is a view into the buffer")
+        {
+            record_table_view_field s;
+            std::array<char, 5> buffer { 0x3, 'a', 'b', 'c', 0x2A };
+            cdf::io::load_record(s, buffer.data(), 0);
+            REQUIRE(s.a == 3);
+            REQUIRE(s.b.values == "abc");
+            REQUIRE(s.b.values.data() == buffer.data() + 1);
+            REQUIRE(s.c == 42);
+        }
+    }
 }
@@ -15,6 +15,7 @@
 #endif
 
 
+#include "cdfpp/cdf-io/saving/link_records.hpp"
 #include "cdfpp/cdf-io/saving/records-saving.hpp"
 #include "cdfpp/cdf-io/special-fields.hpp"
 
@@ -120,3 +121,44 @@ SCENARIO("record loading", "[CDF]")
         }
     }
 }
+
+SCENARIO("linking records past 2GB", "[CDF]")
+{
+    using namespace cdf::io;
+    GIVEN("two variables whose records are laid out past the 2GB boundary")
+    {
+        constexpr std::size_t base = std::size_t { 3 } << 30;
+        saving_context svg_ctx;
+        for (auto number = 0; number < 2; number++)
+        {
+            auto& vc = svg_ctx.body.variables.emplace_back();
+            vc.number = number;
+            vc.vdr.offset = base + number * 100000;
+            for (auto i = 0UL; i < 2; i++)
+            {
+                auto& vxr = vc.vxrs.emplace_back(cdf_VXR_t<v3x_tag> { {}, 0, 1, 1, {}, {}, {} });
+                vxr.record.Offset.values.resize(1);
+                vxr.offset = vc.vdr.offset + 1000 + i * 10000;
+                auto& vvr = vc.values_records.emplace_back(record_wrapper<cdf_VVR_t<v3x_tag>> {});
+                std::get<record_wrapper<cdf_VVR_t<v3x_tag>>>(vvr).offset = vxr.offset + 5000;
+            }
+        }
+        WHEN("linking them")
+        {
+            saving::link_records(svg_ctx);
+            THEN("no offset is truncated")
+            {
+                const auto& first = svg_ctx.body.variables[0];
+                const auto& second = svg_ctx.body.variables[1];
+                REQUIRE(svg_ctx.body.gdr.record.zVDRhead == base);
+                REQUIRE(first.vdr.record.VDRnext == second.vdr.offset);
+                REQUIRE(first.vdr.record.VXRhead == first.vxrs[0].offset);
+                REQUIRE(first.vxrs[0].record.VXRnext == first.vxrs[1].offset);
+                REQUIRE(first.vxrs[1].record.VXRnext == 0);
+                REQUIRE(second.vxrs[0].record.VXRnext == second.vxrs[1].offset);
+                REQUIRE(second.vxrs[1].record.Offset.values[0] == second.vxrs[1].offset + 5000);
+                REQUIRE(second.vdr.record.VDRnext == 0);
+            }
+        }
+    }
+}
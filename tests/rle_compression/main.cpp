@@ -5,6 +5,7 @@
 #include <catch.hpp>
 #endif
 #include "cdfpp/cdf-io/rle.hpp"
+#include <algorithm>
 #include <cstdint>
 
 
@@ -32,3 +33,62 @@ TEST_CASE("IDEMPOTENCY check", "")
     cdf::io::rle::inflate(w2, w.data(), 9);
     REQUIRE(ref == w);
 }
+
+TEST_CASE("long zero runs are split", "")
+{
+    no_init_vector<char> ref(600, 0);
+    ref.push_back(7);
+    REQUIRE(no_init_vector<char> { 0, -1, 0, -1, 0, 87, 7 } == cdf::io::rle::deflate(ref));
+    no_init_vector<char> w(std::size(ref));
+    REQUIRE(cdf::io::rle::inflate(cdf::io::rle::deflate(ref), w.data(), std::size(w))
+        == std::size(ref));
+    REQUIRE(ref == w);
+}
+
+TEST_CASE("round trip on mixed payloads", "")
+{
+    uint32_t state = 1;
+    no_init_vector<char> ref(100000);
+    std::generate(std::begin(ref), std::end(ref),
+        [&state, i = 0UL]() mutable
+        {
+            state = state * 1664525u + 1013904223u;
+            // alternate between sparse, dense and zero only areas of varying sizes
+            const auto area = (i++ / 1000) % 3;
+            if (area == 2)
+                return char { 0 };
+            const auto v = static_cast<char>(state >> 24);
+            return (area == 0 and (state & 0x300) != 0) ? char { 0 } : v;
+        });
+    const auto compressed = cdf::io::rle::deflate(ref);
+    no_init_vector<char> w(std::size(ref));
+    REQUIRE(cdf::io::rle::inflate(compressed, w.data(), std::size(w)) == std::size(ref));
+    REQUIRE(ref == w);
+}
+
+TEST_CASE("streaming deflate matches one shot deflate", "")
+{
+    no_init_vector<char> ref(200000, 0);
+    for (auto i = 0UL; i < std::size(ref); i++)
+        if ((i / 1500) % 2 == 0 and (i % 7) != 0)
+            ref[i] = static_cast<char>(i % 97);
+    // uneven chunks so that zero runs and literals get split across calls
+    for (auto chunk : { 1UL, 13UL, 4096UL, 70001UL })
+    {
+        no_init_vector<char> streamed;
+        auto sink = [&streamed](const char* data, std::size_t size)
+        { streamed.insert(std::end(streamed), data, data + size); };
+        cdf::io::rle::deflate_stream stream;
+        for (auto offset = 0UL; offset < std::size(ref); offset += chunk)
+            stream.write(ref.data() + offset, std::min(chunk, std::size(ref) - offset), sink);
+        stream.finish(sink);
+        REQUIRE(streamed == cdf::io::rle::deflate(ref));
+    }
+}
+
+TEST_CASE("inflate never writes past the output", "")
+{
+    no_init_vector<char> w(4);
+    REQUIRE(cdf::io::rle::inflate(no_init_vector<char> { 1, 2, 0, 10 }, w.data(), 4) == 0);
+    REQUIRE(cdf::io::rle::inflate(no_init_vector<char> { 1, 2, 0 }, w.data(), 4) == 0);
+}
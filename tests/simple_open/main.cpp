@@ -2,6 +2,7 @@
 #include <cstdint>
 #include <optional>
 #include <string>
+#include <thread>
 #include <tuple>
 #include <unordered_map>
 #include <vector>
@@ -301,6 +302,54 @@ SCENARIO("Loading cdf files", "[CDF]")
                 CHECK_CDF_FILE(
                     cd, version, cdf::cdf_majority::row, cdf::cdf_compression_type::no_compression);
             }
+            THEN("Attribute values are only decoded on first access")
+            {
+                auto& attr = cd.attributes["attr_float"];
+                REQUIRE_FALSE(attr.values_loaded());
+                REQUIRE(std::size(attr) == 2);
+                REQUIRE_FALSE(attr.values_loaded());
+                REQUIRE(compare_attribute_values(attr, no_init_vector<float> { 1.f, 2.f, 3.f },
+                    no_init_vector<float> { 4.f, 5.f, 6.f }));
+                REQUIRE(attr.values_loaded());
+            }
+            THEN("Small values are allocated from the file arena")
+            {
+                REQUIRE(cd_opt->arena != nullptr);
+                auto& values = cd_opt->attributes["attr_float"][0].get<float>();
+                const auto& arena = cd_opt->arena;
+                REQUIRE(values.get_allocator().arena() == arena);
+                REQUIRE(arena->owns(values.data()));
+                REQUIRE(cd_opt->variables["var"].shape().get_allocator().arena() == arena);
+                REQUIRE(arena->owns(cd_opt->variables["var"].shape().data()));
+                auto copy = values;
+                REQUIRE(copy.get_allocator().arena() == nullptr);
+                REQUIRE(copy == values);
+                // growing is a reallocation, it goes to the heap
+                values.push_back(7.f);
+                REQUIRE_FALSE(arena->owns(values.data()));
+                REQUIRE(values.get_allocator().arena() == arena);
+            }
+            THEN("Values copied or moved out of the file outlive it")
+            {
+                auto lazy = cdf::io::load(path);
+                REQUIRE(lazy);
+                auto copied_var = lazy->variables["var"];
+                auto copied_attr = lazy->attributes["attr_float"];
+                REQUIRE_FALSE(copied_var.values_loaded());
+                REQUIRE_FALSE(copied_attr.values_loaded());
+                lazy->variables["epoch"].load_values();
+                auto moved_var = std::move(lazy->variables["epoch"]);
+                auto moved_values = std::move(lazy->attributes["attr_int"][0].get<int8_t>());
+                lazy.reset();
+                REQUIRE(check_variable(
+                    copied_var, { 101 }, cos_gen<double>(3.141592653589793 * 2. / 100.)));
+                REQUIRE(compare_attribute_values(copied_attr,
+                    no_init_vector<float> { 1.f, 2.f, 3.f },
+                    no_init_vector<float> { 4.f, 5.f, 6.f }));
+                REQUIRE(check_time_variable<cdf::epoch>(moved_var, { 101 }));
+                REQUIRE(moved_values
+                    == no_init_vector<int8_t> { int8_t { 1 }, int8_t { 2 }, int8_t { 3 } });
+            }
             THEN("All expected attributes are loaded")
             {
                 CHECK_ATTRIBUTES(cd);
@@ -439,6 +488,13 @@ SCENARIO("Loading cdf files", "[CDF]")
             {
                 CHECK_VARIABLES(cd);
             }
+            THEN("Lazily loaded variables are read from the inflated image")
+            {
+                auto lazy_cd_opt = cdf::io::load(path, false, true);
+                REQUIRE(lazy_cd_opt != std::nullopt);
+                auto lazy_cd = *lazy_cd_opt;
+                CHECK_VARIABLES(lazy_cd);
+            }
         }
         WHEN("file exists and is a compressed cdf file (RLE)")
         {
@@ -509,5 +565,103 @@ SCENARIO("Loading cdf files", "[CDF]")
                 CHECK_VARIABLES(cd);
             }
         }
+        WHEN("file exists and has a sparse records variable")
+        {
+            auto path = std::string(DATA_PATH) + "/testutf8.cdf";
+            REQUIRE(file_exists(path));
+            auto cd_opt = cdf::io::load(path);
+            REQUIRE(cd_opt != std::nullopt);
+            THEN("missing records read as the pad value")
+            {
+                const auto& temp = cd_opt->variables["Temp"];
+                REQUIRE(temp.shape() == decltype(temp.shape()) { 13, 3 });
+                const auto& values = temp.get<float>();
+                REQUIRE(values[0] == 55.5f);
+                REQUIRE(values[2] == 66.6f);
+                REQUIRE(values[15] == 666.66f);
+                REQUIRE(values[30] == 96.5f);
+                REQUIRE(values[38] == 220.7f);
+                for (auto i : { 3, 14, 18, 29 })
+                    REQUIRE(values[i] == -1e30f);
+            }
+        }
+    }
+}
+
+
+SCENARIO("Allocating small values from a file arena", "[CDF]")
+{
+    GIVEN("an arena shared by a few threads")
+    {
+        monotonic_arena arena;
+        constexpr std::size_t threads_count = 4;
+        constexpr std::size_t allocations = 5000;
+        std::vector<std::vector<char*>> blocks(threads_count);
+        std::vector<std::thread> threads;
+        for (auto t = 0UL; t < threads_count; t++)
+            threads.emplace_back(
+                [&arena, &blocks, t]()
+                {
+                    for (auto i = 0UL; i < allocations; i++)
+                    {
+                        auto block = static_cast<char*>(arena.allocate(48));
+                        std::fill(block, block + 48, static_cast<char>(t));
+                        blocks[t].push_back(block);
+                    }
+                });
+        for (auto& thread : threads)
+            thread.join();
+        THEN("blocks never overlap")
+        {
+            auto corrupted = 0UL;
+            for (auto t = 0UL; t < threads_count; t++)
+                for (const auto block : blocks[t])
+                    corrupted += std::count(block, block + 48, static_cast<char>(t)) != 48;
+            REQUIRE(corrupted == 0UL);
+            REQUIRE(arena.chunks_count() >= threads_count * allocations * 48 / (1 << 18));
+        }
+        WHEN("the last allocation is given back")
+        {
+            auto first = arena.allocate(100);
+            arena.deallocate(first, 100);
+            THEN("its memory is reused") { REQUIRE(arena.allocate(64) == first); }
+        }
+    }
+}
+
+#ifdef USE_MMAP
+SCENARIO("Anonymous mappings backing inflated images", "[CDF]")
+{
+    GIVEN("a released anonymous mapping")
+    {
+        cdf::io::buffers::anonymous_mapping first(100000);
+        REQUIRE(first.size() == 100000);
+        REQUIRE(first.capacity() >= 100000);
+        std::fill(first.data(), first.data() + first.size(), 'x');
+        const auto* ptr = first.data();
+        first.release();
+        REQUIRE(first.data() == nullptr);
+        WHEN("an image of a similar size is requested")
+        {
+            cdf::io::buffers::anonymous_mapping second(90000);
+            THEN("the released mapping is reused")
+            {
+                REQUIRE(second.data() == ptr);
+                REQUIRE(second.size() == 90000);
+                std::fill(second.data(), second.data() + second.size(), 'y');
+                REQUIRE(second.data()[89999] == 'y');
+            }
+        }
+        WHEN("a much larger image is requested")
+        {
+            cdf::io::buffers::anonymous_mapping second(10000000);
+            THEN("a new mapping is created")
+            {
+                REQUIRE(second.data() != nullptr);
+                REQUIRE(second.data() != ptr);
+                REQUIRE(second.capacity() % (1 << 21) == 0);
+            }
+        }
     }
 }
+#endif
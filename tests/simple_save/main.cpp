@@ -1,5 +1,7 @@
 #include <algorithm>
 #include <cstdint>
+#include <fstream>
+#include <iterator>
 #include <optional>
 #include <string>
 #include <tuple>
@@ -93,3 +95,479 @@ SCENARIO("Saving a cdf file", "[CDF]")
         REQUIRE(cdf_obj->variables.count("var1"));
     }
 }
+
+SCENARIO("Saving variables without values in memory", "[CDF]")
+{
+    CDF cdf_obj;
+    // empty vectors have no storage, their data pointer is null
+    cdf_obj.variables.emplace("empty",
+        Variable { "empty", 0, data_t { no_init_vector<double> {}, CDF_Types::CDF_DOUBLE },
+            { 0 } });
+    cdf_obj.variables.emplace("empty nrv",
+        Variable { "empty nrv", 1, data_t { no_init_vector<char> {}, CDF_Types::CDF_CHAR }, { 0 },
+            cdf_majority::row, true });
+    const auto saved = cdf::io::save(cdf_obj);
+    REQUIRE(std::size(saved) != 0);
+    auto reloaded = cdf::io::load(saved.data(), std::size(saved));
+    REQUIRE(reloaded);
+    REQUIRE(reloaded->variables["empty"].shape()[0] == 0);
+    REQUIRE(std::size(reloaded->variables["empty"].get<double>()) == 0);
+}
+
+SCENARIO("Saving many compressed variables", "[CDF]")
+{
+    CDF cdf_obj;
+    for (auto i = 0; i < 8; i++)
+    {
+        auto name = "var" + std::to_string(i);
+        cdf_obj.variables.emplace(name,
+            Variable { name, 0,
+                data_t { cos_gen<double> { 0.01 * (i + 1) }(10000), CDF_Types::CDF_DOUBLE },
+                { 10000 } });
+        cdf_obj.variables[name].set_compression_type((i % 2)
+                ? cdf_compression_type::rle_compression
+                : cdf_compression_type::gzip_compression);
+        if (i % 4 == 0)
+            cdf_obj.variables[name].set_compression_level(1);
+    }
+    cdf_obj.compression_level = 9;
+    const auto first = cdf::io::save(cdf_obj);
+    const auto second = cdf::io::save(cdf_obj);
+    REQUIRE(std::size(first) > 0);
+    REQUIRE(first == second);
+    auto reloaded = cdf::io::load(first.data(), std::size(first));
+    REQUIRE(reloaded);
+    for (const auto& [name, variable] : cdf_obj.variables)
+    {
+        REQUIRE(reloaded->variables.count(name));
+        REQUIRE(reloaded->variables[name].compression_type() == variable.compression_type());
+        const auto& values = reloaded->variables[name].get<double>();
+        REQUIRE(values == variable.get<double>());
+    }
+}
+
+SCENARIO("Saving variables in chunks", "[CDF]")
+{
+    CDF cdf_obj;
+    cdf_obj.chunk_size = cdf::chunk_size_t::in_bytes(80);
+    cdf_obj.variables.emplace("default_chunks",
+        Variable { "default_chunks", 0,
+            data_t { cos_gen<double> { 0.01 }(10000), CDF_Types::CDF_DOUBLE }, { 10000 } });
+    cdf_obj.variables.emplace("chained_vxrs",
+        Variable { "chained_vxrs", 1,
+            data_t { cos_gen<float> { 0.02 }(3 * 10000), CDF_Types::CDF_FLOAT }, { 10000, 3 } });
+    cdf_obj.variables["chained_vxrs"].set_chunk_size(cdf::chunk_size_t::in_records(3));
+    for (auto compression : { cdf_compression_type::no_compression,
+             cdf_compression_type::gzip_compression, cdf_compression_type::rle_compression })
+    {
+        for (auto& [name, variable] : cdf_obj.variables)
+            variable.set_compression_type(compression);
+        const auto saved = cdf::io::save(cdf_obj);
+        auto reloaded = cdf::io::load(saved.data(), std::size(saved));
+        REQUIRE(reloaded);
+        const auto& default_chunks = reloaded->variables["default_chunks"].get<double>();
+        REQUIRE(default_chunks == cdf_obj.variables["default_chunks"].get<double>());
+        const auto& chained_vxrs = reloaded->variables["chained_vxrs"].get<float>();
+        REQUIRE(chained_vxrs == cdf_obj.variables["chained_vxrs"].get<float>());
+        REQUIRE(reloaded->variables["chained_vxrs"].shape()
+            == cdf_obj.variables["chained_vxrs"].shape());
+    }
+}
+
+SCENARIO("Automatic compression", "[CDF]")
+{
+    CDF cdf_obj;
+    no_init_vector<double> noise(20000);
+    uint32_t state = 7;
+    // random mantissas, as incompressible as measurement noise
+    std::generate(std::begin(noise), std::end(noise),
+        [&state]()
+        {
+            state = state * 1664525u + 1013904223u;
+            const uint32_t high = state;
+            state = state * 1664525u + 1013904223u;
+            return 1. + static_cast<double>((uint64_t { high } << 20) ^ state) * 0x1p-52;
+        });
+    no_init_vector<int32_t> ramp(20000);
+    for (auto i = 0UL; i < std::size(ramp); i++)
+        ramp[i] = static_cast<int32_t>(i % 100);
+    cdf_obj.variables.emplace("noise",
+        Variable { "noise", 0, data_t { std::move(noise), CDF_Types::CDF_DOUBLE }, { 20000 } });
+    cdf_obj.variables.emplace("flags",
+        Variable { "flags", 1, data_t { zeros<int8_t> {}(20000), CDF_Types::CDF_INT1 },
+            { 20000 } });
+    cdf_obj.variables.emplace("ramp",
+        Variable { "ramp", 2, data_t { std::move(ramp), CDF_Types::CDF_INT4 }, { 20000 } });
+    for (auto& [name, variable] : cdf_obj.variables)
+        variable.set_compression_type(cdf_compression_type::auto_compression);
+
+    WHEN("saving without resolving first")
+    {
+        const auto saved = cdf::io::save(cdf_obj);
+        auto reloaded = cdf::io::load(saved.data(), std::size(saved));
+        REQUIRE(reloaded);
+        THEN("each variable gets a concrete codec")
+        {
+            REQUIRE(reloaded->variables["noise"].compression_type()
+                == cdf_compression_type::no_compression);
+            REQUIRE(reloaded->variables["flags"].compression_type()
+                == cdf_compression_type::rle_compression);
+            REQUIRE(reloaded->variables["ramp"].compression_type()
+                == cdf_compression_type::gzip_compression);
+            const auto& ramp_values = reloaded->variables["ramp"].get<int32_t>();
+            REQUIRE(ramp_values == cdf_obj.variables["ramp"].get<int32_t>());
+        }
+        THEN("the choices are reported by the saving context, variables are left untouched")
+        {
+            const auto svg_ctx = cdf::io::saving::build_saving_context(cdf_obj);
+            REQUIRE(std::size(svg_ctx.compression_decisions) == 3);
+            for (const auto& decision : svg_ctx.compression_decisions)
+            {
+                REQUIRE(cdf_obj.variables[decision.variable].compression_type()
+                    == cdf_compression_type::auto_compression);
+                REQUIRE(decision.type == reloaded->variables[decision.variable].compression_type());
+            }
+        }
+    }
+    WHEN("setting the whole file to automatic compression")
+    {
+        cdf_obj.compression = cdf_compression_type::auto_compression;
+        const auto saved = cdf::io::save(cdf_obj);
+        THEN("one codec is picked for the file")
+        {
+            auto reloaded = cdf::io::load(saved.data(), std::size(saved));
+            REQUIRE(reloaded);
+            REQUIRE(reloaded->compression != cdf_compression_type::auto_compression);
+            REQUIRE(reloaded->compression == cdf::io::choose_compression(cdf_obj).type);
+            REQUIRE(reloaded->variables["ramp"].get<int32_t>()
+                == cdf_obj.variables["ramp"].get<int32_t>());
+        }
+        THEN("resolving it explicitly reports the file decision")
+        {
+            const auto decisions = cdf::io::resolve_compression(cdf_obj);
+            REQUIRE(std::size(decisions) == 4);
+            REQUIRE(decisions.front().variable.empty());
+            REQUIRE(cdf_obj.compression == decisions.front().type);
+        }
+    }
+    WHEN("resolving the compression explicitly")
+    {
+        const auto decisions = cdf::io::resolve_compression(cdf_obj);
+        THEN("decisions are reported and applied")
+        {
+            REQUIRE(std::size(decisions) == 3);
+            for (const auto& decision : decisions)
+            {
+                REQUIRE(cdf_obj.variables[decision.variable].compression_type() == decision.type);
+                REQUIRE(decision.ratio >= 1.);
+            }
+            REQUIRE(cdf_obj.variables["flags"].compression_type()
+                == cdf_compression_type::rle_compression);
+        }
+    }
+    WHEN("requiring a large saving")
+    {
+        cdf_obj.compression_objective.min_saving = 0.999;
+        std::ignore = cdf::io::resolve_compression(cdf_obj);
+        THEN("only the constant flags get compressed")
+        {
+            REQUIRE(cdf_obj.variables["ramp"].compression_type()
+                == cdf_compression_type::no_compression);
+        }
+    }
+}
+
+SCENARIO("Saving whole file compressed cdf files", "[CDF]")
+{
+    CDF cdf_obj;
+    cdf_obj.attributes.emplace("some global attr",
+        cdf::Attribute { "some global attr",
+            { data_t { no_init_vector<double> { 1., 2., 3. }, CDF_Types::CDF_DOUBLE } } });
+    // large enough to bypass the staging buffer of the compressing writer
+    cdf_obj.variables.emplace("big",
+        Variable { "big", 0, data_t { cos_gen<double> { 0.001 }(100000), CDF_Types::CDF_DOUBLE },
+            { 100000 } });
+    cdf_obj.variables.emplace("small",
+        Variable { "small", 1, data_t { zeros<float> {}(10), CDF_Types::CDF_FLOAT }, { 10 } });
+    for (auto compression :
+        { cdf_compression_type::gzip_compression, cdf_compression_type::rle_compression })
+    {
+        cdf_obj.compression = compression;
+        auto cdf_path = std::string { std::tmpnam(nullptr) };
+        REQUIRE(cdf::io::save(cdf_obj, cdf_path));
+        const auto in_memory = cdf::io::save(cdf_obj);
+        REQUIRE(std::size(in_memory) > 0);
+        for (auto reloaded : { cdf::io::load(cdf_path),
+                 cdf::io::load(in_memory.data(), std::size(in_memory)) })
+        {
+            REQUIRE(reloaded);
+            REQUIRE(reloaded->compression == compression);
+            REQUIRE(reloaded->attributes.count("some global attr"));
+            REQUIRE(reloaded->variables["big"].get<double>()
+                == cdf_obj.variables["big"].get<double>());
+            REQUIRE(reloaded->variables["small"].get<float>()
+                == cdf_obj.variables["small"].get<float>());
+        }
+        std::remove(cdf_path.c_str());
+    }
+}
+
+SCENARIO("Saving to a file matches saving in memory", "[CDF]")
+{
+    CDF cdf_obj;
+    cdf_obj.attributes.emplace("some global attr",
+        cdf::Attribute { "some global attr",
+            { data_t { cos_gen<double> { 0.1 }(5000), CDF_Types::CDF_DOUBLE } } });
+    // values larger than the copy threshold of the vectored writer are referenced in place
+    cdf_obj.variables.emplace("big",
+        Variable { "big", 0, data_t { cos_gen<double> { 0.001 }(200000), CDF_Types::CDF_DOUBLE },
+            { 200000 } });
+    cdf_obj.variables.emplace("compressed",
+        Variable { "compressed", 1,
+            data_t { cos_gen<double> { 0.01 }(100000), CDF_Types::CDF_DOUBLE }, { 100000 } });
+    cdf_obj.variables["compressed"].set_compression_type(cdf_compression_type::rle_compression);
+    cdf_obj.variables.emplace("chunked",
+        Variable { "chunked", 2, data_t { ones<float> {}(30000), CDF_Types::CDF_FLOAT },
+            { 10000, 3 } });
+    cdf_obj.variables["chunked"].set_chunk_size(cdf::chunk_size_t::in_records(7));
+    auto cdf_path = std::string { std::tmpnam(nullptr) };
+    REQUIRE(cdf::io::save(cdf_obj, cdf_path));
+    const auto in_memory = cdf::io::save(cdf_obj);
+    std::ifstream file { cdf_path, std::ios::binary };
+    const std::vector<char> from_file {
+        std::istreambuf_iterator<char> { file }, std::istreambuf_iterator<char> {}
+    };
+    REQUIRE(std::size(from_file) == std::size(in_memory));
+    REQUIRE(std::equal(std::cbegin(from_file), std::cend(from_file), std::cbegin(in_memory)));
+    std::remove(cdf_path.c_str());
+#ifdef __linux__
+    // every write fails with ENOSPC
+    REQUIRE_FALSE(cdf::io::save(cdf_obj, "/dev/full"));
+    cdf_obj.compression = cdf_compression_type::gzip_compression;
+    REQUIRE_FALSE(cdf::io::save(cdf_obj, "/dev/full"));
+#endif
+}
+
+SCENARIO("Re-saving a lazily loaded file", "[CDF]")
+{
+    CDF cdf_obj;
+    cdf_obj.attributes.emplace("some global attr",
+        cdf::Attribute { "some global attr",
+            { data_t { no_init_vector<double> { 1., 2., 3. }, CDF_Types::CDF_DOUBLE } } });
+    cdf_obj.variables.emplace("plain",
+        Variable { "plain", 0, data_t { cos_gen<double> { 0.001 }(20000), CDF_Types::CDF_DOUBLE },
+            { 20000 } });
+    cdf_obj.variables.emplace("compressed",
+        Variable { "compressed", 1,
+            data_t { cos_gen<float> { 0.01f }(30000), CDF_Types::CDF_FLOAT }, { 10000, 3 } });
+    cdf_obj.variables["compressed"].set_compression_type(cdf_compression_type::gzip_compression);
+    cdf_obj.variables["compressed"].set_chunk_size(cdf::chunk_size_t::in_records(1000));
+    const auto source_path = std::string { std::tmpnam(nullptr) };
+    REQUIRE(cdf::io::save(cdf_obj, source_path));
+    auto lazy = cdf::io::load(source_path);
+    REQUIRE(lazy);
+    WHEN("only editing attributes")
+    {
+        lazy->attributes.erase(lazy->attributes.find("some global attr"));
+        lazy->attributes.emplace("edited",
+            cdf::Attribute { "edited",
+                { data_t { no_init_vector<char> { 'o', 'k' }, CDF_Types::CDF_CHAR } } });
+        THEN("values records are copied without being loaded")
+        {
+            const auto raw = lazy->variables["compressed"].raw_values();
+            REQUIRE(raw);
+            REQUIRE(std::size(raw->blocks) == 10);
+            const auto saved = cdf::io::save(*lazy);
+            REQUIRE_FALSE(lazy->variables["plain"].values_loaded());
+            REQUIRE_FALSE(lazy->variables["compressed"].values_loaded());
+            auto reloaded = cdf::io::load(saved.data(), std::size(saved));
+            REQUIRE(reloaded);
+            REQUIRE(reloaded->attributes.count("edited"));
+            REQUIRE_FALSE(reloaded->attributes.count("some global attr"));
+            REQUIRE(reloaded->variables["plain"] == cdf_obj.variables["plain"]);
+            REQUIRE(reloaded->variables["compressed"] == cdf_obj.variables["compressed"]);
+        }
+    }
+    WHEN("changing the gzip level or the chunk size of a variable")
+    {
+        lazy->variables["compressed"].set_compression_level(9);
+        lazy->variables["plain"].set_chunk_size(cdf::chunk_size_t::in_records(4000));
+        THEN("both are encoded again with the new settings")
+        {
+            const auto saved = cdf::io::save(*lazy);
+            REQUIRE(lazy->variables["compressed"].values_loaded());
+            REQUIRE(lazy->variables["plain"].values_loaded());
+            auto reloaded = cdf::io::load(saved.data(), std::size(saved));
+            REQUIRE(reloaded);
+            REQUIRE(reloaded->variables["plain"] == cdf_obj.variables["plain"]);
+            REQUIRE(reloaded->variables["compressed"] == cdf_obj.variables["compressed"]);
+            auto lazy_reloaded = cdf::io::load(saved.data(), std::size(saved), false, true);
+            REQUIRE(std::size(lazy_reloaded->variables["plain"].raw_values()->blocks) == 5);
+        }
+    }
+    WHEN("setting the chunk size the source was written with")
+    {
+        lazy->chunk_size = cdf::chunk_size_t::in_records(1000);
+        THEN("the compressed variable is still copied as is")
+        {
+            const auto saved = cdf::io::save(*lazy);
+            REQUIRE_FALSE(lazy->variables["compressed"].values_loaded());
+            REQUIRE(lazy->variables["plain"].values_loaded());
+        }
+    }
+    WHEN("changing the compression of a variable")
+    {
+        lazy->variables["compressed"].set_compression_type(cdf_compression_type::rle_compression);
+        THEN("it is decoded and compressed again")
+        {
+            const auto saved = cdf::io::save(*lazy);
+            REQUIRE(lazy->variables["compressed"].values_loaded());
+            REQUIRE_FALSE(lazy->variables["plain"].values_loaded());
+            auto reloaded = cdf::io::load(saved.data(), std::size(saved));
+            REQUIRE(reloaded);
+            REQUIRE(reloaded->variables["compressed"].compression_type()
+                == cdf_compression_type::rle_compression);
+            REQUIRE(reloaded->variables["compressed"].get<float>()
+                == cdf_obj.variables["compressed"].get<float>());
+        }
+    }
+    std::remove(source_path.c_str());
+}
+
+SCENARIO("Saving with all the metadata first", "[CDF]")
+{
+    CDF cdf_obj;
+    cdf_obj.attributes.emplace("some global attr",
+        cdf::Attribute { "some global attr",
+            { data_t { no_init_vector<double> { 1., 2., 3. }, CDF_Types::CDF_DOUBLE } } });
+    cdf_obj.variables.emplace("big",
+        Variable { "big", 0, data_t { cos_gen<double> { 0.001 }(200000), CDF_Types::CDF_DOUBLE },
+            { 200000 } });
+    cdf_obj.variables["big"].attributes.emplace("var attr",
+        cdf::Attribute { "var attr",
+            { data_t { no_init_vector<char> { 'o', 'k' }, CDF_Types::CDF_CHAR } } });
+    cdf_obj.variables.emplace("compressed",
+        Variable { "compressed", 1,
+            data_t { cos_gen<float> { 0.01f }(30000), CDF_Types::CDF_FLOAT }, { 10000, 3 } });
+    cdf_obj.variables["compressed"].set_compression_type(cdf_compression_type::gzip_compression);
+    cdf_obj.variables["compressed"].set_chunk_size(cdf::chunk_size_t::in_records(1000));
+    cdf_obj.layout = cdf::cdf_layout::metadata_first;
+
+    const auto svg_ctx = cdf::io::saving::build_saving_context(cdf_obj);
+    std::size_t first_values_record = svg_ctx.body.gdr.record.eof;
+    std::size_t last_descriptor = svg_ctx.body.gdr.offset;
+    for (const auto& variable_ctx : svg_ctx.body.variables)
+    {
+        for (const auto& values_record : variable_ctx.values_records)
+            first_values_record = std::min(first_values_record,
+                visit(values_record, [](const auto& record) { return record.offset; }));
+        last_descriptor = std::max(last_descriptor, variable_ctx.vdr.offset);
+        for (const auto& vxr : variable_ctx.vxrs)
+            last_descriptor = std::max(last_descriptor, vxr.offset);
+    }
+    for (const auto& [name, attribute_ctx] : svg_ctx.body.variable_attributes)
+        for (const auto& aedr : attribute_ctx.aedrs)
+            last_descriptor = std::max(last_descriptor, aedr.offset);
+    REQUIRE(last_descriptor < first_values_record);
+
+    const auto in_memory = cdf::io::save(cdf_obj);
+    auto reloaded = cdf::io::load(in_memory.data(), std::size(in_memory));
+    REQUIRE(reloaded);
+    REQUIRE(*reloaded == cdf_obj);
+
+    auto cdf_path = std::string { std::tmpnam(nullptr) };
+    REQUIRE(cdf::io::save(cdf_obj, cdf_path));
+    std::ifstream file { cdf_path, std::ios::binary };
+    const std::vector<char> from_file {
+        std::istreambuf_iterator<char> { file }, std::istreambuf_iterator<char> {}
+    };
+    REQUIRE(std::size(from_file) == std::size(in_memory));
+    REQUIRE(std::equal(std::cbegin(from_file), std::cend(from_file), std::cbegin(in_memory)));
+    std::remove(cdf_path.c_str());
+
+    cdf_obj.compression = cdf_compression_type::gzip_compression;
+    const auto compressed = cdf::io::save(cdf_obj);
+    auto reloaded_compressed = cdf::io::load(compressed.data(), std::size(compressed));
+    REQUIRE(reloaded_compressed);
+    REQUIRE(*reloaded_compressed == *reloaded);
+}
+
+SCENARIO("Saving sparse records", "[CDF]")
+{
+    constexpr double fill = -1e31;
+    no_init_vector<double> values = cos_gen<double> { 0.01 }(3000);
+    // 1000 records of 3 values, runs of fill values from record 100 to 499 and 700 to 709
+    std::fill(std::begin(values) + 300, std::begin(values) + 1500, fill);
+    std::fill(std::begin(values) + 2100, std::begin(values) + 2130, fill);
+    CDF cdf_obj;
+    cdf_obj.variables.emplace("sparse",
+        Variable { "sparse", 0, data_t { values, CDF_Types::CDF_DOUBLE }, { 1000, 3 } });
+    cdf_obj.variables["sparse"].attributes.emplace("FILLVAL",
+        cdf::Attribute { "FILLVAL",
+            { data_t { no_init_vector<double> { fill }, CDF_Types::CDF_DOUBLE } } });
+    cdf_obj.variables.emplace("masked",
+        Variable { "masked", 1, data_t { ones<float> {}(1000), CDF_Types::CDF_FLOAT }, { 1000 } });
+    const auto dense = cdf::io::save(cdf_obj);
+    cdf::sparse_records_t sparse_records;
+    sparse_records.fill_values = true;
+    sparse_records.mask.resize(1000);
+    std::fill(std::begin(sparse_records.mask) + 900, std::end(sparse_records.mask), true);
+    cdf_obj.variables["sparse"].set_sparse_records(sparse_records);
+    sparse_records.fill_values = false;
+    cdf_obj.variables["masked"].set_sparse_records(sparse_records);
+
+    no_init_vector<double> expected = values;
+    std::fill(std::begin(expected) + 2700, std::end(expected), fill);
+    no_init_vector<float> expected_masked = ones<float> {}(1000);
+    // the CDF library default pad value, there is no FILLVAL to use
+    std::fill(std::begin(expected_masked) + 900, std::end(expected_masked), -1e30f);
+
+    const auto svg_ctx = cdf::io::saving::build_saving_context(cdf_obj);
+    const auto& vxr = svg_ctx.body.variables[0].vxrs.front().record;
+    REQUIRE(svg_ctx.body.variables[0].vdr.record.SRecords == 1);
+    REQUIRE(vxr.First.values == decltype(vxr.First.values) { 0, 500 });
+    REQUIRE(vxr.Last.values == decltype(vxr.Last.values) { 99, 899 });
+
+    for (auto compression :
+        { cdf_compression_type::no_compression, cdf_compression_type::gzip_compression })
+    {
+        for (auto& [name, variable] : cdf_obj.variables)
+            variable.set_compression_type(compression);
+        const auto saved = cdf::io::save(cdf_obj);
+        // 500 records of 3 doubles and 100 floats are left out
+        if (compression == cdf_compression_type::no_compression)
+            REQUIRE(std::size(dense) - std::size(saved) >= 12000);
+        auto reloaded = cdf::io::load(saved.data(), std::size(saved));
+        REQUIRE(reloaded);
+        REQUIRE(reloaded->variables["sparse"].shape() == cdf_obj.variables["sparse"].shape());
+        REQUIRE(reloaded->variables["sparse"].get<double>() == expected);
+        REQUIRE(reloaded->variables["masked"].get<float>() == expected_masked);
+        // the missing records are reported so saving again leaves them out too
+        const auto& reloaded_sparse = reloaded->variables["sparse"].sparse_records();
+        REQUIRE(std::size(reloaded_sparse.mask) == 1000);
+        REQUIRE(std::count(std::cbegin(reloaded_sparse.mask), std::cend(reloaded_sparse.mask), true)
+            == 500);
+        REQUIRE(reloaded_sparse.mask[100]);
+        REQUIRE_FALSE(reloaded_sparse.mask[99]);
+        REQUIRE(reloaded_sparse.pad_value);
+        REQUIRE(std::size(*reloaded_sparse.pad_value) == sizeof(double));
+        REQUIRE(reinterpret_cast<const double*>(reloaded_sparse.pad_value->data())[0] == fill);
+        const auto saved_again = cdf::io::save(*reloaded);
+        REQUIRE(std::size(saved_again) == std::size(saved));
+        const auto path = std::string { std::tmpnam(nullptr) };
+        REQUIRE(cdf::io::save(cdf_obj, path));
+        auto from_file = cdf::io::load(path);
+        REQUIRE(from_file);
+        REQUIRE(*from_file == *reloaded);
+        std::remove(path.c_str());
+        // values set afterwards are written whole, the loaded mask indexed the previous ones
+        auto& masked = reloaded->variables["masked"];
+        const no_init_vector<float> replaced(1000, 2.f);
+        masked.set_data(data_t { replaced, CDF_Types::CDF_FLOAT }, { 1000 });
+        REQUIRE(std::size(masked.sparse_records().mask) == 0);
+        const auto saved_replaced = cdf::io::save(*reloaded);
+        auto reloaded_replaced = cdf::io::load(saved_replaced.data(), std::size(saved_replaced));
+        REQUIRE(reloaded_replaced);
+        REQUIRE(reloaded_replaced->variables["masked"].get<float>() == replaced);
+    }
+}
@@ -0,0 +1,126 @@
+#include <cmath>
+#include <cstdint>
+#include <cstdio>
+#include <string>
+
+#if __has_include(<catch2/catch_all.hpp>)
+#include <catch2/catch_all.hpp>
+#include <catch2/catch_test_macros.hpp>
+#else
+#include <catch.hpp>
+#endif
+
+#include "cdfpp/attribute.hpp"
+#include "cdfpp/cdf-file.hpp"
+#include "cdfpp/cdf-io/cdf-io.hpp"
+#include "cdfpp/variable.hpp"
+
+no_init_vector<double> ramp(std::size_t first, std::size_t count)
+{
+    no_init_vector<double> values(count);
+    for (auto i = 0UL; i < count; i++)
+        values[i] = std::cos(static_cast<double>(first + i) / 100.);
+    return values;
+}
+
+CDF make_declaration()
+{
+    CDF cdf_obj;
+    cdf_obj.attributes.emplace("mission",
+        cdf::Attribute { "mission",
+            { data_t { no_init_vector<char> { 'P', 'S', 'P' }, CDF_Types::CDF_CHAR } } });
+    cdf_obj.variables.emplace("scalar",
+        Variable { "scalar", 0, data_t { no_init_vector<double> {}, CDF_Types::CDF_DOUBLE },
+            { 0 } });
+    cdf_obj.variables.emplace("vector",
+        Variable { "vector", 1, data_t { no_init_vector<double> {}, CDF_Types::CDF_DOUBLE },
+            { 0, 3 } });
+    cdf_obj.variables["vector"].set_compression_type(cdf_compression_type::gzip_compression);
+    cdf_obj.variables["vector"].attributes.emplace("UNITS",
+        cdf::Attribute { "UNITS",
+            { data_t { no_init_vector<char> { 'n', 'T' }, CDF_Types::CDF_CHAR } } });
+    cdf_obj.variables.emplace("labels",
+        Variable { "labels", 2,
+            data_t { no_init_vector<char> { 'x', 'y', 'z' }, CDF_Types::CDF_CHAR }, { 1, 3 },
+            cdf_majority::row, true });
+    return cdf_obj;
+}
+
+SCENARIO("Streaming records to a CDF file", "[CDF]")
+{
+    const auto cdf_path = std::string { std::tmpnam(nullptr) };
+    GIVEN("a stream writer with declared variables")
+    {
+        cdf::io::stream_writer writer { cdf_path, make_declaration() };
+        THEN("the file is readable before any record is appended")
+        {
+            auto cdf_obj = cdf::io::load(cdf_path);
+            REQUIRE(cdf_obj);
+            REQUIRE(cdf_obj->attributes.count("mission"));
+            REQUIRE(cdf_obj->variables["scalar"].shape()[0] == 0);
+            REQUIRE(cdf_obj->variables["labels"].get<char>()
+                == no_init_vector<char> { 'x', 'y', 'z' });
+            // no empty VXR is written for variables without records
+            const auto declaration = make_declaration();
+            const auto svg_ctx = cdf::io::saving::build_saving_context(declaration);
+            for (const auto& var_ctx : svg_ctx.body.variables)
+            {
+                const bool has_records = var_ctx.variable->name() == "labels";
+                REQUIRE(std::empty(var_ctx.vxrs) != has_records);
+                REQUIRE((var_ctx.vdr.record.VXRhead == 0) != has_records);
+            }
+        }
+        WHEN("appending more batches than a VXR can index")
+        {
+            // one record per batch is the worst case, a values record per batch
+            const std::size_t batches = cdf::io::saving::max_vxr_entries + 10;
+            for (auto i = 0UL; i < batches; i++)
+            {
+                writer.append("scalar", data_t { ramp(i, 1), CDF_Types::CDF_DOUBLE });
+                writer.append("vector", data_t { ramp(3 * i, 3), CDF_Types::CDF_DOUBLE });
+                if (i == 100)
+                {
+                    writer.flush();
+                    auto cdf_obj = cdf::io::load(cdf_path);
+                    REQUIRE(cdf_obj);
+                    REQUIRE(cdf_obj->variables["scalar"].get<double>() == ramp(0, 101));
+                    REQUIRE(cdf_obj->variables["vector"].get<double>() == ramp(0, 3 * 101));
+                }
+            }
+            writer.append("scalar", data_t { ramp(batches, 1000), CDF_Types::CDF_DOUBLE });
+            writer.close();
+            THEN("every record can be read back")
+            {
+                REQUIRE(writer.records("scalar") == batches + 1000);
+                auto cdf_obj = cdf::io::load(cdf_path);
+                REQUIRE(cdf_obj);
+                REQUIRE(cdf_obj->variables["scalar"].get<double>() == ramp(0, batches + 1000));
+                REQUIRE(cdf_obj->variables["vector"].shape()
+                    == typename Variable::shape_t { static_cast<uint32_t>(batches), 3 });
+                REQUIRE(cdf_obj->variables["vector"].get<double>() == ramp(0, 3 * batches));
+                REQUIRE(cdf_obj->variables["vector"].compression_type()
+                    == cdf_compression_type::gzip_compression);
+                REQUIRE(cdf_obj->variables["vector"].attributes.count("UNITS"));
+            }
+        }
+        WHEN("appending invalid batches")
+        {
+            THEN("they are rejected")
+            {
+                REQUIRE_THROWS_AS(
+                    writer.append("missing", data_t { ramp(0, 1), CDF_Types::CDF_DOUBLE }),
+                    std::invalid_argument);
+                REQUIRE_THROWS_AS(
+                    writer.append("vector", data_t { ramp(0, 2), CDF_Types::CDF_DOUBLE }),
+                    std::invalid_argument);
+                REQUIRE_THROWS_AS(writer.append("scalar",
+                                      data_t { no_init_vector<float> { 1.f }, CDF_Types::CDF_FLOAT }),
+                    std::invalid_argument);
+                REQUIRE_THROWS_AS(writer.append("labels",
+                                      data_t { no_init_vector<char> { 'a' }, CDF_Types::CDF_CHAR }),
+                    std::invalid_argument);
+            }
+        }
+    }
+    std::remove(cdf_path.c_str());
+}
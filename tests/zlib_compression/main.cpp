@@ -8,7 +8,9 @@
 #ifndef CDFpp_USE_LIBDEFLATE
 #include "cdfpp/cdf-io/zlib.hpp"
 #endif
+#include <algorithm>
 #include <cstdint>
+#include <limits>
 
 
 #ifndef CDFpp_USE_LIBDEFLATE
@@ -28,6 +30,71 @@ TEST_CASE("IDEMPOTENCY check", "")
     cdf::io::zlib::gzinflate(w2, w.data(), std::size(ref));
     REQUIRE(ref == w);
 }
+
+TEST_CASE("Codec contexts are reused across blocks", "")
+{
+    uint32_t state = 42;
+    for (auto block_size : { 4096UL, 10000UL, 65536UL, 128UL, 65536UL })
+    {
+        no_init_vector<char> ref(block_size);
+        // incompressible payload, the compressed block is larger than the input
+        std::generate(std::begin(ref), std::end(ref),
+            [&state]()
+            {
+                state = state * 1664525u + 1013904223u;
+                return static_cast<char>(state >> 24);
+            });
+        no_init_vector<char> w(block_size);
+        auto compressed = cdf::io::zlib::gzdeflate(ref);
+        REQUIRE(std::size(compressed) > 0);
+        REQUIRE(cdf::io::zlib::gzinflate(compressed, w.data(), block_size) == block_size);
+        REQUIRE(ref == w);
+    }
+}
+
+TEST_CASE("Compression levels", "")
+{
+    no_init_vector<char> ref(1 << 16);
+    for (auto i = 0UL; i < std::size(ref); i++)
+        ref[i] = static_cast<char>((i * i / 7) % 23);
+    std::size_t previous_size = std::numeric_limits<std::size_t>::max();
+    // switching level back and forth on the same thread must not leak into later blocks
+    for (int level : { 1, 9, 1, 6, 9, 20 })
+    {
+        no_init_vector<char> w(std::size(ref));
+        auto compressed = cdf::io::zlib::gzdeflate(ref, level);
+        REQUIRE(cdf::io::zlib::gzinflate(compressed, w.data(), std::size(ref)) == std::size(ref));
+        REQUIRE(ref == w);
+        REQUIRE(compressed == cdf::io::zlib::gzdeflate(ref, level));
+        if (level == 9 or level == 20)
+        {
+            REQUIRE(std::size(compressed) <= previous_size);
+        }
+        previous_size = std::size(compressed);
+    }
+}
+
+TEST_CASE("Streaming compression", "")
+{
+    no_init_vector<char> ref(1 << 20);
+    for (auto i = 0UL; i < std::size(ref); i++)
+        ref[i] = static_cast<char>((i * i / 7) % 23);
+    no_init_vector<char> compressed;
+    std::size_t sink_calls = 0;
+    auto sink = [&](const char* data, std::size_t size)
+    {
+        compressed.insert(std::end(compressed), data, data + size);
+        sink_calls++;
+    };
+    cdf::io::zlib::gzdeflate_stream stream { 6 };
+    for (auto offset = 0UL; offset < std::size(ref); offset += 10000)
+        stream.write(ref.data() + offset, std::min(10000UL, std::size(ref) - offset), sink);
+    stream.finish(sink);
+    REQUIRE(sink_calls != 0);
+    no_init_vector<char> w(std::size(ref));
+    REQUIRE(cdf::io::zlib::gzinflate(compressed, w.data(), std::size(ref)) == std::size(ref));
+    REQUIRE(ref == w);
+}
 #else
 TEST_CASE("Skip check", "")
 {}
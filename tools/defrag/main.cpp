@@ -0,0 +1,50 @@
+#include "cdfpp/cdf-io/cdf-io.hpp"
+#include <cstdlib>
+#include <iostream>
+#include <string>
+
+/*
+ * cdfpp-defrag rewrites a CDF file with its metadata first and the values of each variable
+ * stored contiguously, see cdf::io::optimize.
+ */
+
+int usage(const char* name)
+{
+    std::cerr << "usage: " << name
+              << " [--coalesce-records N | --coalesce-bytes N] [--no-validate] input output\n";
+    return 2;
+}
+
+int main(int argc, char** argv)
+{
+    cdf::io::optimize_options options;
+    std::string paths[2];
+    int path_count = 0;
+    for (int i = 1; i < argc; i++)
+    {
+        const std::string arg { argv[i] };
+        if (arg == "--no-validate")
+            options.validate = false;
+        else if ((arg == "--coalesce-records" or arg == "--coalesce-bytes") and i + 1 < argc)
+        {
+            const auto value = std::strtoull(argv[++i], nullptr, 10);
+            if (value == 0)
+                return usage(argv[0]);
+            options.coalesce = (arg == "--coalesce-records")
+                ? cdf::chunk_size_t::in_records(value)
+                : cdf::chunk_size_t::in_bytes(value);
+        }
+        else if (path_count < 2 and arg.rfind("--", 0) != 0)
+            paths[path_count++] = arg;
+        else
+            return usage(argv[0]);
+    }
+    if (path_count != 2)
+        return usage(argv[0]);
+    if (not cdf::io::optimize(paths[0], paths[1], options))
+    {
+        std::cerr << "failed to optimize " << paths[0] << "\n";
+        return 1;
+    }
+    return 0;
+}